@@ -0,0 +1,201 @@
+#include <dmx.h>
+
+// Measures the public API under contention: 1 to 8 tasks call Read, ReadAll,
+// Write, WriteAll or BeginFrame/WriteAll/Commit in a loop while the receive
+// task (UART2) and the send task (UART1) are running. For each case it prints
+// one JSON line (or CSV with OUTPUT_CSV) with the throughput, the latency
+// percentiles of one call and the commit to wire latency of the output.
+// test/bench_contention.cpp runs the same cases on Linux (host build).
+// Wire the output to the input (through the transceivers) to load both tasks.
+// Last, it prints the cycles DMXTransform::Apply takes on a 512 slots frame.
+
+//#define OUTPUT_CSV
+
+#define RUN_MS        2000          // duration of one case
+#define MAX_TASKS     8
+#define SAMPLES       1024          // latency samples kept per task (uniform reservoir over all the calls)
+
+enum Op { OP_READ, OP_READALL, OP_WRITE, OP_WRITEALL, OP_COMMIT, OP_COUNT };
+const char * opNames[OP_COUNT] = { "Read", "ReadAll", "Write", "WriteAll", "Commit" };
+
+DMXConfig outputConfig()
+{
+  DMXConfig config;
+  config.uart_num = UART_NUM_1;
+  config.tx_pin = 25;
+  config.rx_pin = UART_PIN_NO_CHANGE;
+  return config;
+}
+
+DMX input;
+DMX output(outputConfig());
+
+struct Worker
+{
+  Op op;
+  uint32_t calls;
+  uint32_t count;                   // samples stored
+  uint32_t random;                  // xorshift state of the reservoir
+  uint32_t samples[SAMPLES];        // cycles per call
+};
+
+Worker workers[MAX_TASKS];
+volatile bool running = false;
+SemaphoreHandle_t done;
+
+void worker(void * arg)
+{
+  Worker * w = (Worker *) arg;
+  uint8_t data[512];
+  uint16_t i = 0;
+
+  while(!running) vTaskDelay(1);
+
+  while(running)
+  {
+    uint32_t start = ESP.getCycleCount();
+    switch(w->op)
+    {
+      case OP_READ:     data[0] = input.Read((i % 512) + 1); break;
+      case OP_READALL:  input.ReadAll(data, 1, 512); break;
+      case OP_WRITE:    output.Write((i % 512) + 1, i); break;
+      case OP_WRITEALL: output.WriteAll(data, 1, 512); break;
+      default:
+        output.BeginFrame();
+        output.WriteAll(data, 1, 512);
+        output.Commit();
+        break;
+    }
+    uint32_t cycles = ESP.getCycleCount() - start;
+
+    // reservoir sampling: call n replaces a random sample with probability SAMPLES / (n + 1),
+    // so the samples are drawn uniformly from the whole run
+    if(w->count < SAMPLES) {
+      w->samples[w->count++] = cycles;
+    } else {
+      w->random ^= w->random << 13;
+      w->random ^= w->random >> 17;
+      w->random ^= w->random << 5;
+      uint32_t j = w->random % (w->calls + 1);
+      if(j < SAMPLES) w->samples[j] = cycles;
+    }
+    w->calls++;
+    i++;
+
+    // let the idle task and the lower priority tasks run
+    if((i & 1023) == 0) vTaskDelay(1);
+  }
+
+  xSemaphoreGive(done);
+  vTaskDelete(NULL);
+}
+
+int compare(const void * a, const void * b)
+{
+  uint32_t x = *(const uint32_t *) a;
+  uint32_t y = *(const uint32_t *) b;
+  return (x > y) - (x < y);
+}
+
+void runCase(Op op, int tasks)
+{
+  static uint32_t all[MAX_TASKS * SAMPLES];
+  uint32_t calls = 0;
+  uint32_t n = 0;
+
+  for(int t = 0; t < tasks; t++)
+  {
+    workers[t].op = op;
+    workers[t].calls = 0;
+    workers[t].count = 0;
+    workers[t].random = 2463534242UL + t;
+    xTaskCreatePinnedToCore(worker, "bench", 2048 + 512, &workers[t], 1, NULL, t & 1);
+  }
+
+  running = true;
+  delay(RUN_MS);
+  running = false;
+  for(int t = 0; t < tasks; t++) xSemaphoreTake(done, portMAX_DELAY);
+
+  for(int t = 0; t < tasks; t++)
+  {
+    calls += workers[t].calls;
+    memcpy(all + n, workers[t].samples, workers[t].count * sizeof(uint32_t));
+    n += workers[t].count;
+  }
+  qsort(all, n, sizeof(uint32_t), compare);
+
+  float ns = 1000.0f / getCpuFrequencyMhz();
+  DMXTxLatency latency = output.GetTxLatency();
+
+#ifdef OUTPUT_CSV
+  Serial.printf("%s,%d,%u,%.0f,%.0f,%.0f,%.0f,%.0f,%u,%u,%u\n",
+                opNames[op], tasks, calls, calls * 1000.0f / RUN_MS,
+                all[n / 2] * ns, all[n * 9 / 10] * ns, all[n * 99 / 100] * ns, all[n - 1] * ns,
+                latency.avg_us, latency.max_us, input.GetRxCounters().frames);
+#else
+  Serial.printf("{\"op\":\"%s\",\"tasks\":%d,\"calls\":%u,\"calls_per_s\":%.0f,"
+                "\"p50_ns\":%.0f,\"p90_ns\":%.0f,\"p99_ns\":%.0f,\"max_ns\":%.0f,"
+                "\"tx_latency_avg_us\":%u,\"tx_latency_max_us\":%u,\"rx_frames\":%u}\n",
+                opNames[op], tasks, calls, calls * 1000.0f / RUN_MS,
+                all[n / 2] * ns, all[n * 9 / 10] * ns, all[n * 99 / 100] * ns, all[n - 1] * ns,
+                latency.avg_us, latency.max_us, input.GetRxCounters().frames);
+#endif
+}
+
+void benchTransform()
+{
+  static uint8_t gamma[256];
+  static uint16_t gamma16[256];
+  static DMXTransform curves;
+  uint8_t frame[513];
+  uint32_t best = UINT32_MAX;
+
+  DMXTransform::Gamma(gamma, 2.2f);
+  DMXTransform::Gamma16(gamma16, 2.2f);
+  curves.SetCurve(1, 512, gamma);
+  for(uint16_t ch = 1; ch < 64; ch += 2) curves.SetCurve16(ch, gamma16);
+  for(int i = 0; i < 513; i++) frame[i] = i;
+
+  for(int i = 0; i < 1000; i++)
+  {
+    uint32_t start = ESP.getCycleCount();
+    curves.Apply(frame, 1, 512);
+    uint32_t cycles = ESP.getCycleCount() - start;
+    if(cycles < best) best = cycles;
+  }
+
+#ifdef OUTPUT_CSV
+  Serial.printf("transform,%u\n", best);
+#else
+  Serial.printf("{\"op\":\"Transform\",\"slots\":512,\"wide\":32,\"cycles\":%u}\n", best);
+#endif
+}
+
+void setup() {
+  Serial.begin(115200);
+  done = xSemaphoreCreateCounting(MAX_TASKS, 0);
+
+  input.Initialize(DMX_DIR_INPUT);
+  output.Initialize(DMX_DIR_OUTPUT);
+  delay(500);
+
+#ifdef OUTPUT_CSV
+  Serial.println("op,tasks,calls,calls_per_s,p50_ns,p90_ns,p99_ns,max_ns,tx_latency_avg_us,tx_latency_max_us,rx_frames");
+#endif
+
+  for(int op = 0; op < OP_COUNT; op++)
+  {
+    for(int tasks = 1; tasks <= MAX_TASKS; tasks *= 2)
+    {
+      runCase((Op) op, tasks);
+    }
+  }
+  benchTransform();
+  Serial.println("done");
+}
+
+void loop()
+{
+  delay(1000);
+}
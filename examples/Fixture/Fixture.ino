@@ -0,0 +1,66 @@
+#include <dmx.h>
+#include <dmx_fixture.h>
+
+// Decodes a moving head patched at address 101 from the received universe,
+// and compares the time taken by the profile (one snapshot) with one Read()
+// per channel.
+
+struct Spot
+{
+  uint16_t pan;
+  uint16_t tilt;
+  uint8_t dimmer;
+  DMXRGB color;
+};
+
+typedef DMXFixture<Spot,
+    DMXAttr16<Spot, 0, &Spot::pan>,
+    DMXAttr16<Spot, 2, &Spot::tilt>,
+    DMXAttr8<Spot, 4, &Spot::dimmer>,
+    DMXAttrRGB<Spot, 5, &Spot::color> > SpotProfile;
+
+#define SPOT_ADDRESS  101
+#define ITERATIONS    10000
+
+int readcycle = 0;
+
+DMX dmx;
+
+void setup() {
+  Serial.begin(115200);
+  dmx.Initialize(DMX_DIR_INPUT);
+}
+
+void loop()
+{
+  if(millis() - readcycle > 1000)
+  {
+    readcycle = millis();
+
+    Spot spot;
+    uint32_t start = micros();
+    for(int i = 0; i < ITERATIONS; i++)
+    {
+      SpotProfile::Read(dmx, SPOT_ADDRESS, spot);
+    }
+    uint32_t profile_us = micros() - start;
+
+    // same attributes, one Read() per channel
+    start = micros();
+    for(int i = 0; i < ITERATIONS; i++)
+    {
+      spot.pan = (dmx.Read(SPOT_ADDRESS) << 8) | dmx.Read(SPOT_ADDRESS + 1);
+      spot.tilt = (dmx.Read(SPOT_ADDRESS + 2) << 8) | dmx.Read(SPOT_ADDRESS + 3);
+      spot.dimmer = dmx.Read(SPOT_ADDRESS + 4);
+      spot.color.r = dmx.Read(SPOT_ADDRESS + 5);
+      spot.color.g = dmx.Read(SPOT_ADDRESS + 6);
+      spot.color.b = dmx.Read(SPOT_ADDRESS + 7);
+    }
+    uint32_t read_us = micros() - start;
+
+    Serial.printf("pan %u tilt %u dimmer %u rgb %u/%u/%u\n",
+                  spot.pan, spot.tilt, spot.dimmer, spot.color.r, spot.color.g, spot.color.b);
+    Serial.printf("profile: %.3f us, Read per channel: %.3f us\n",
+                  (float) profile_us / ITERATIONS, (float) read_us / ITERATIONS);
+  }
+}
@@ -0,0 +1,51 @@
+#include <dmx.h>
+
+// Receives one universe on UART2 and sends two universes on UART1 and UART0.
+// The received channels 1 to 24 are copied to both outputs.
+// Note: UART0 is also used by Serial, only use it when the console is not needed.
+
+int readcycle = 0;
+
+DMXConfig inputConfig()
+{
+  DMXConfig config;               // UART2, rx on GPIO 27
+  config.task_priority = 2;
+  return config;
+}
+
+DMXConfig outputConfig(uart_port_t uart, int tx_pin, BaseType_t core)
+{
+  DMXConfig config;
+  config.uart_num = uart;
+  config.tx_pin = tx_pin;
+  config.rx_pin = UART_PIN_NO_CHANGE;
+  config.task_core = core;
+  return config;
+}
+
+DMX input(inputConfig());
+DMX outputA(outputConfig(UART_NUM_1, 25, 1));
+DMX outputB(outputConfig(UART_NUM_0, 1, 0));
+
+void setup() {
+  input.Initialize(DMX_DIR_INPUT, 1, 24);
+  outputA.Initialize(DMX_DIR_OUTPUT);
+  outputB.Initialize(DMX_DIR_OUTPUT);
+}
+
+void loop()
+{
+  uint8_t channels[24];
+
+  if(millis() - readcycle > 25)
+  {
+    readcycle = millis();
+
+    if(input.IsHealthy())
+    {
+      input.ReadAll(channels, 1, sizeof(channels));
+      outputA.WriteAll(channels, 1, sizeof(channels));
+      outputB.WriteAll(channels, 1, sizeof(channels));
+    }
+  }
+}
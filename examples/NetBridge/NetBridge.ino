@@ -0,0 +1,41 @@
+#include <WiFi.h>
+#include <dmx.h>
+#include <dmx_bridge.h>
+
+// Sends sACN universe 1 received over WiFi on the DMX output.
+
+const char * ssid = "my-network";
+const char * password = "my-password";
+
+int readcycle = 0;
+
+DMX dmx;
+DMXNetBridge bridge(dmx);
+
+void setup() {
+  Serial.begin(115200);
+
+  WiFi.begin(ssid, password);
+  while(WiFi.status() != WL_CONNECTED)
+  {
+    delay(100);
+  }
+  // no power save, it delays the packets by up to 100ms
+  WiFi.setSleep(false);
+
+  dmx.Initialize(DMX_DIR_OUTPUT);
+  bridge.Begin(DMX_NET_SACN, 1);
+}
+
+void loop()
+{
+  if(millis() - readcycle > 1000)
+  {
+    readcycle = millis();
+
+    DMXTxLatency latency = dmx.GetTxLatency();
+    Serial.printf("frames %u - out of order %u - latency %u / %u / %u us\n",
+                  bridge.GetStats().frames, bridge.GetStats().out_of_order,
+                  latency.min_us, latency.avg_us, latency.max_us);
+  }
+}
@@ -2,9 +2,11 @@
 
 int readcycle = 0;
 
+DMX dmx;
+
 void setup() {
   Serial.begin(115200);
-  DMX::Initialize(DMX_DIR_INPUT);
+  dmx.Initialize(DMX_DIR_INPUT);
 }
 
 void loop()
@@ -15,7 +17,7 @@ void loop()
 
     Serial.print(readcycle);
       
-    if(DMX::IsHealthy())
+    if(dmx.IsHealthy())
     {
       Serial.print(": ok - ");
     }
@@ -23,10 +25,10 @@ void loop()
     {
       Serial.print(": fail - ");
     }
-    Serial.print(DMX::Read(1));
+    Serial.print(dmx.Read(1));
     Serial.print(" - ");
-    Serial.print(DMX::Read(110));
+    Serial.print(dmx.Read(110));
     Serial.print(" - ");
-    Serial.println(DMX::Read(256));
+    Serial.println(dmx.Read(256));
   }
 }
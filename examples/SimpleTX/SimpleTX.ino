@@ -3,12 +3,14 @@
 int readcycle = 0;
 uint8_t send_value = 0;
 
+DMX dmx;
+
 void setup() {
   Serial.begin(115200);
 
-  DMX::Initialize(DMX_DIR_OUTPUT);
+  dmx.Initialize(DMX_DIR_OUTPUT);
 
-  DMX::Write(8, 69);
+  dmx.Write(8, 69);
 }
 
 void loop()
@@ -19,6 +21,6 @@ void loop()
 
     Serial.print(send_value);
 
-    DMX::Write(10, send_value++);
+    dmx.Write(10, send_value++);
   }
 }
@@ -0,0 +1,38 @@
+#include <dmx.h>
+#include <dmx_usbpro.h>
+
+// Turns the board into an Enttec DMX USB Pro compatible interface: the frames
+// sent by the PC go out on UART1 and the frames received on UART2 go back to
+// the PC. Through a USB-UART bridge the PC must open the port at the same
+// baud rate (a native USB port ignores it).
+
+#define BAUDRATE      1000000       // 44 frames per second both ways need ~460 kbaud
+
+DMXConfig outputConfig()
+{
+  DMXConfig config;
+  config.uart_num = UART_NUM_1;
+  config.tx_pin = 25;
+  config.rx_pin = UART_PIN_NO_CHANGE;
+  return config;
+}
+
+DMX input;
+DMX output(outputConfig());
+DMXUsbPro widget(Serial, &output, &input);
+
+void setup() {
+  Serial.begin(BAUDRATE);
+  DMX::SetLog(nullptr);             // the tasks started by Initialize would print on the port of the widget
+
+  input.Initialize(DMX_DIR_INPUT);
+  output.Initialize(DMX_DIR_OUTPUT);
+  widget.SetSerialNumber(0x00000001);
+  widget.Begin();
+}
+
+void loop()
+{
+  // Serial belongs to the widget, nothing is printed
+  delay(1000);
+}
@@ -24,8 +24,13 @@
 #include <Arduino.h>
 #include "driver/gpio.h"
 #include "hal/uart_types.h"
+#include "hal/uart_ll.h"
+#include "soc/uart_periph.h"
+#include "esp_timer.h"
 #include <dmx.h>
 
+// Default hardware setup of a universe (see DMXConfig), each DMX instance can override it
+
 /*
 #define DMX_SERIAL_INPUT_PIN    GPIO_NUM_16 // pin for dmx rx
 #define DMX_SERIAL_OUTPUT_PIN   GPIO_NUM_17 // pin for dmx tx
@@ -41,65 +46,161 @@
 
 
 
-#define DMX_UART_NUM            UART_NUM_2  // dmx uart
+#define DMX_UART_NUM            UART_NUM_2  // default dmx uart
 
 #define HEALTHY_TIME            500         // timeout in ms 
 
 #define BUF_SIZE                513         //  buffer size for rx events (il y a 513 trames en DMX512)
 
-#define DMX_CORE                1           // select the core the rx/tx thread should run on
+#define DMX_CORE                1           // default core the rx/tx thread should run on
 
-//#define DMX_IGNORE_THREADSAFETY 0         // set to 1 to disable all threadsafe mechanisms
+#define DMX_BAUDRATE            250000      // 4us per bit
+
+#define DMX_BREAK_US            184         // default break length sent
+#define DMX_MAB_US              24          // default mark after break length sent
 
+#define DMX_MIN_FRAME_US        1204        // minimum break to break time (E1.11)
 
+#define DMX_RX_FIFO_SIZE        128         // uart hardware rx fifo
+#define DMX_MIN_RX_RING         (DMX_RX_FIFO_SIZE * 2)  // smallest rx ring accepted by the uart driver (larger than the fifo), outputs
+#define DMX_RX_FULL_THRESHOLD   120         // default fifo level read by the uart driver, 6 events per frame (break included), ~0.35ms of margin
+#define DMX_RX_ISR_FULL_THRESHOLD 96        // default fifo level in interrupt receive mode, 7 events per frame, ~1.4ms of margin
+#define DMX_RX_TIMEOUT          2           // default idle time (in slots) before the fifo is read, a frame ends in ~90us
+#define DMX_RX_MAX_TIMEOUT      126         // largest idle time accepted by the uart
 
-#define NBZEROFRAME_TRIGGER_BLACKOUT    12  // floor for black out detection , nb successive zeros frame.
+#define DMX_RX_INTR_MASK        (UART_INTR_RXFIFO_FULL | UART_INTR_RXFIFO_TOUT | UART_INTR_BRK_DET | \
+                                 UART_INTR_FRAM_ERR | UART_INTR_PARITY_ERR | UART_INTR_RXFIFO_OVF)
 
-QueueHandle_t DMX::dmx_rx_queue;
+#define DMX_NOTIFY_FRAME        0x01        // receive task notification bits, interrupt receive mode
+#define DMX_NOTIFY_ALT          0x02
 
-SemaphoreHandle_t DMX::sync_dmx;
+#define DMX_FRAME_EVEN          0x01        // frame events bits, set for the parity of the signal count
+#define DMX_FRAME_ODD           0x02
+
+//#define DMX_IGNORE_THREADSAFETY 0         // set to 1 to disable all threadsafe mechanisms
 
-DMXState DMX::dmx_state = DMX_IDLE;
 
 
-uint16_t DMX::_StartDMXAddr = 1;
-uint16_t DMX::_NbChannels = 512;
-uint8_t* DMX::dmx_data = nullptr;
-uint8_t* DMX::tmp_dmx_data = nullptr;
 
-uint16_t DMX::current_rx_addr = 0;
+Print * volatile DMX::log = &Serial;
 
-// Filter on Zéros DMX Frame
-bool DMX::isAllZero = true;
-uint8_t DMX::CptAllZeroFrame = 0;
+DMXConfig::DMXConfig() :
+    uart_num(DMX_UART_NUM),
+    rx_pin(DMX_SERIAL_INPUT_PIN),
+    tx_pin(DMX_SERIAL_OUTPUT_PIN),
+#ifndef DMXHW_DONT_USE_DIR
+    dir_pin(DMX_SERIAL_IO_PIN),
+#else
+    dir_pin(-1),
+#endif
+    task_priority(1),
+    task_core(DMX_CORE),
+    rx_isr(false),
+    rx_full_threshold(0),
+    rx_timeout(DMX_RX_TIMEOUT)
+{
+}
 
-long DMX::last_dmx_packet = 0;
+DMXStorage::DMXStorage() :
+    slots(512),
+    frames(nullptr),
+    stack(nullptr),
+    task(nullptr),
+    mutex(nullptr),
+    events(nullptr)
+{
+}
 
-DMX::DMX()
+DMX::DMX(const DMXConfig & config, const DMXStorage & storage) :
+    config(config),
+    storage(storage),
+    rx_ring(0),
+    tx_ring(0),
+    task(NULL),
+    direction(DMX_DIR_INPUT),
+    dmx_rx_queue(NULL),
+    sync_dmx(NULL),
+    frame_open(false),
+    tx_dirty(false),
+    tx_break_bits(0),
+    tx_mab_bits(0),
+    tx_slots(512),
+    tx_min_period_us(DMX_MIN_FRAME_US),
+    tx_avg_period_us(0),
+    tx_transform(nullptr),
+    tx_wire(nullptr),
+    tx_loops(0),
+    rx_busy(0),
+    isr_busy(0),
+    frame_events(NULL),
+    signaled_seq(0),
+    signal_count(0),
+    rx_intr(NULL),
+    rx_woken(pdFALSE),
+    isr_frame(nullptr),
+    isr_dirty(nullptr),
+    isr_start(1),
+    isr_nb(0),
+    isr_seq(0),
+    isr_us(0),
+    isr_alt(nullptr),
+    isr_alt_head(0),
+    isr_alt_tail(0)
 {
-    dmx_data = nullptr;
-    tmp_dmx_data = nullptr;
-    isAllZero = true;
+    portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+    rx_mux = mux;
+    memset(&tx_latency, 0, sizeof(tx_latency));
+    SetTxTiming(DMX_BREAK_US, DMX_MAB_US);
 }
 
 DMX::~DMX()
 {
-    if(dmx_data != nullptr) {
-        free(dmx_data);
+    if(rx_intr != NULL) {
+        uart_ll_disable_intr_mask(UART_LL_GET_HW(config.uart_num), UART_LL_INTR_MASK);
+        esp_intr_free(rx_intr);
     }
 
-    if(tmp_dmx_data != nullptr) {
-        free(tmp_dmx_data);
+    if(task != NULL) {
+        vTaskDelete(task);
+        if(!isrMode()) {
+            uart_driver_delete(config.uart_num);
+        }
     }
+
+    if(sync_dmx != NULL) {
+        vSemaphoreDelete(sync_dmx);
+    }
+
+    if(frame_events != NULL) {
+        vEventGroupDelete(frame_events);
+    }
+
+    tx_frame.End();
+    if(storage.frames == nullptr) {
+        free(tx_wire);
+    }
+    free(isr_alt);
+
+    receiver.End();
 }
 
 
 void DMX::Initialize(DMXDirection direction, uint16_t StartAddr, uint16_t NbChannels)
 {
+    this->direction = direction;
+
+    // rx thresholds out of the uart range fall back to the defaults of the receive mode
+    if((config.rx_full_threshold == 0) || (config.rx_full_threshold >= DMX_RX_FIFO_SIZE)) {
+        config.rx_full_threshold = isrMode() ? DMX_RX_ISR_FULL_THRESHOLD : DMX_RX_FULL_THRESHOLD;
+    }
+    if((config.rx_timeout == 0) || (config.rx_timeout > DMX_RX_MAX_TIMEOUT)) {
+        config.rx_timeout = DMX_RX_TIMEOUT;
+    }
+
     // configure UART for DMX
     uart_config_t uart_config =
     {
-        .baud_rate = 250000,
+        .baud_rate = DMX_BAUDRATE,
         .data_bits = UART_DATA_8_BITS,
         .parity = UART_PARITY_DISABLE,
         .stop_bits = UART_STOP_BITS_2,
@@ -107,146 +208,286 @@ void DMX::Initialize(DMXDirection direction, uint16_t StartAddr, uint16_t NbChan
         .source_clk = UART_SCLK_REF_TICK                // Better source clock for ESP32 in my case
     };
 
-    uart_param_config(DMX_UART_NUM, &uart_config);
+    uart_param_config(config.uart_num, &uart_config);
 
     // Set pins for UART
-    if ( uart_set_pin(DMX_UART_NUM, DMX_SERIAL_OUTPUT_PIN, DMX_SERIAL_INPUT_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE)!= ESP_OK ) {
-        Serial.printf("DMX::Initialize : Error when assigning UART Pin (uart_set_pin). ESP_FAIL!\n");
-    }
-    // install queue
-    if ( uart_driver_install(DMX_UART_NUM, BUF_SIZE * 2, BUF_SIZE * 2, 20, &dmx_rx_queue, 0) != ESP_OK ) {
-        Serial.printf("DMX::Initialize : Error when installaing the UART Driver. ESP_FAIL!\n");
+    if ( uart_set_pin(config.uart_num, config.tx_pin, config.rx_pin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE)!= ESP_OK ) {
+        DMX_LOG("DMX::Initialize : Error when assigning UART Pin (uart_set_pin). ESP_FAIL!\n");
     }
+    // install queue, the interrupt receive mode reads the uart itself
+    if(!isrMode())
+    {
+        // no tx ring on inputs, outputs only keep the smallest rx ring and no tx ring when their memory is static
+        if(direction == DMX_DIR_OUTPUT) {
+            rx_ring = DMX_MIN_RX_RING;
+            tx_ring = (storage.frames != nullptr) ? 0 : BUF_SIZE * 2;
+        } else {
+            rx_ring = BUF_SIZE * 2;
+            tx_ring = 0;
+        }
+
+        if ( uart_driver_install(config.uart_num, rx_ring, tx_ring, 20, &dmx_rx_queue, 0) != ESP_OK ) {
+            DMX_LOG("DMX::Initialize : Error when installaing the UART Driver. ESP_FAIL!\n");
+        }
 
-    // Check if the queue has correctly created
-    if(&dmx_rx_queue == nullptr) {
-        Serial.printf("DMX::Initialize : Error when installaing the UART Driver. Queue pointure is NULL!\n");
+        // Check if the queue has correctly created
+        if(dmx_rx_queue == NULL) {
+            DMX_LOG("DMX::Initialize : Error when installaing the UART Driver. Queue pointure is NULL!\n");
+        }
+
+        // larger chunks, a frame comes in a few events
+        if(direction == DMX_DIR_INPUT) {
+            uart_set_rx_full_threshold(config.uart_num, config.rx_full_threshold);
+            uart_set_rx_timeout(config.uart_num, config.rx_timeout);
+        }
     }
 
-    // create mutex for syncronisation
-    sync_dmx = xSemaphoreCreateMutex();
+    // create mutex for syncronisation, one per universe
+    if(storage.mutex != nullptr) {
+        sync_dmx = xSemaphoreCreateMutexStatic(storage.mutex);
+    } else {
+        sync_dmx = xSemaphoreCreateMutex();
+    }
 
     // set gpio for direction
-
-#ifndef DMXHW_DONT_USE_DIR
-    gpio_pad_select_gpio(DMX_SERIAL_IO_PIN);
-    gpio_set_direction(DMX_SERIAL_IO_PIN, GPIO_MODE_OUTPUT);
-#endif
+    if(config.dir_pin >= 0) {
+        gpio_pad_select_gpio(config.dir_pin);
+        gpio_set_direction((gpio_num_t) config.dir_pin, GPIO_MODE_OUTPUT);
+    }
 
     // depending on parameter set gpio for direction change and start rx or tx thread
     if(direction == DMX_DIR_OUTPUT)
     {
 
-        // Default value for back compability to the orrignal librairie code
-        _StartDMXAddr = 1;
-        _NbChannels = 512;
-        createBuffer(false);
+        // all channels are sent, the fourth buffer holds the copy given to the last stages
+        if(!tx_frame.Begin(storage.slots + 1, storage.frames)) {
+            DMX_LOG("DMX::Initialize : Error when allocating the send buffers!\n");
+        }
+        if(storage.frames != nullptr) {
+            tx_wire = storage.frames + 3 * (storage.slots + 1);
+        } else {
+            tx_wire = (uint8_t *) malloc(storage.slots + 1);
+        }
+        if(tx_wire == nullptr) {
+            DMX_LOG("DMX::Initialize : Error when allocating the send buffers!\n");
+        }
+        if(tx_slots > storage.slots) {
+            tx_slots = storage.slots;
+        }
 
-#ifndef DMXHW_DONT_USE_DIR
-    gpio_set_level(DMX_SERIAL_IO_PIN, 1);
-#endif
-        
-        dmx_state = DMX_OUTPUT;
+        if(config.dir_pin >= 0) {
+            gpio_set_level((gpio_num_t) config.dir_pin, 1);
+        }
         
         // create send task
-        xTaskCreatePinnedToCore(DMX::uart_send_task, "uart_send_task", 1024, NULL, 1, NULL, DMX_CORE);
+        createTask(DMX::uart_send_task, "uart_send_task", DMX_TX_STACK_SIZE);
     }
     else
     {    
-        _StartDMXAddr = StartAddr;
-        _NbChannels = NbChannels;
-        createBuffer(true);
+        if(!receiver.Begin(storage.slots, storage.frames)) {
+            DMX_LOG("DMX::Initialize : Error when allocating the receive buffers!\n");
+        }
+        receiver.SetWindow(StartAddr, NbChannels);
 
-#ifndef DMXHW_DONT_USE_DIR
-    gpio_set_level(DMX_SERIAL_IO_PIN, 0);
-#endif    
+        // frame 0 (nothing received) is signaled
+        if(storage.events != nullptr) {
+            frame_events = xEventGroupCreateStatic(storage.events);
+        } else {
+            frame_events = xEventGroupCreate();
+        }
+        if(frame_events == NULL) {
+            DMX_LOG("DMX::Initialize : Error when creating the frame event group!\n");
+        } else {
+            xEventGroupSetBits(frame_events, DMX_FRAME_EVEN);
+        }
 
-        dmx_state = DMX_IDLE;
+        if(config.dir_pin >= 0) {
+            gpio_set_level((gpio_num_t) config.dir_pin, 0);
+        }
 
         // create receive task
-        xTaskCreatePinnedToCore(DMX::uart_event_task, "uart_event_task", 2048, NULL, 1, NULL, DMX_CORE);
+        if(isrMode()) {
+            // the callbacks run in the task, never in the interrupt
+            receiver.SetFrameCallback(DMX::isr_frame_callback, this);
+            receiver.SetAltStartCodeCallback(DMX::isr_alt_callback, this);
+
+            // each packet is copied into its own slot, the interrupt goes on capturing meanwhile
+            if(rx_alt_callback.GetCallback() != nullptr) {
+                isr_alt = (AltPacket *) malloc(DMX_ALT_RING * sizeof(AltPacket));
+                if(isr_alt == nullptr) {
+                    DMX_LOG("DMX::Initialize : Error when allocating the alternate start code packets!\n");
+                }
+            }
+            createTask(DMX::uart_isr_task, "uart_isr_task", DMX_RX_STACK_SIZE);
+        } else {
+            createTask(DMX::uart_event_task, "uart_event_task", DMX_RX_STACK_SIZE);
+        }
     }
 }
 
+void DMX::createTask(TaskFunction_t function, const char * name, uint32_t stack_size)
+{
+    bool created;
 
-void DMX::createBuffer(bool TmpBufferCreate) {
+    if((storage.stack != nullptr) && (storage.task != nullptr)) {
+        task = xTaskCreateStaticPinnedToCore(function, name, stack_size, this, config.task_priority, storage.stack, storage.task, config.task_core);
+        created = (task != NULL);
+    } else {
+        created = (xTaskCreatePinnedToCore(function, name, stack_size, this, config.task_priority, &task, config.task_core) == pdPASS);
+    }
 
-    // Manage deletion of the Tmp Buffeur if not any more needed 
-    if(not(TmpBufferCreate) && (tmp_dmx_data != nullptr)) {
-        free(tmp_dmx_data);
-        tmp_dmx_data = nullptr;
+    if(!created) {
+        task = NULL;
+        DMX_LOG("DMX::Initialize : Error when creating the %s task!\n", name);
     }
+}
 
-    // Check if buffer is already existing
-    if(dmx_data != nullptr) {
-        dmx_data = (uint8_t *) realloc(dmx_data, sizeof(uint8_t)*(_NbChannels+1));
-    } else {
-         dmx_data = (uint8_t *) malloc(sizeof(uint8_t)*(_NbChannels+1));
+size_t DMX::GetFootprint() const
+{
+    size_t bytes = sizeof(DMX) + rx_ring + tx_ring;
+
+    // what was allocated at Initialize
+    if(storage.frames == nullptr) bytes += FramesSize(direction, storage.slots);
+    if(storage.stack == nullptr) bytes += (direction == DMX_DIR_OUTPUT) ? DMX_TX_STACK_SIZE : DMX_RX_STACK_SIZE;
+    if(storage.task == nullptr) bytes += sizeof(StaticTask_t);
+    if(storage.mutex == nullptr) bytes += sizeof(StaticSemaphore_t);
+    if((direction == DMX_DIR_INPUT) && (storage.events == nullptr)) bytes += sizeof(StaticEventGroup_t);
+
+    // chunk buffer of the event task, packets handed over by the interrupt
+    if((direction == DMX_DIR_INPUT) && !isrMode()) bytes += BUF_SIZE;
+    if(isr_alt != nullptr) bytes += DMX_ALT_RING * sizeof(AltPacket);
+
+    return bytes;
+}
+
+
+bool DMX::AddWindow(DMXWindow & window)
+{
+    // several tasks may register their windows at the same time, the mutex exists once initialized
+#ifndef DMX_IGNORE_THREADSAFETY
+    if(sync_dmx != NULL) xSemaphoreTake(sync_dmx, portMAX_DELAY);
+#endif
+    bool added = receiver.AddWindow(window);
+#ifndef DMX_IGNORE_THREADSAFETY
+    if(sync_dmx != NULL) xSemaphoreGive(sync_dmx);
+#endif
+
+    if(!added) {
+        DMX_LOG("DMX::AddWindow : Error when adding the window, %d windows at most!\n", DMX_MAX_WINDOWS);
     }
+    return added;
+}
 
-    memset(dmx_data,0,sizeof(uint8_t)*(_NbChannels+1));
+void DMX::SetAltStartCodeCallback(DMXAltCallback callback, void * arg)
+{
+    // one setter at a time, the pair replaced now is reused by the next one
+#ifndef DMX_IGNORE_THREADSAFETY
+    if(sync_dmx != NULL) xSemaphoreTake(sync_dmx, portMAX_DELAY);
+#endif
+    if(isrMode()) {
+        rx_alt_callback.Set(callback, arg);
+    } else {
+        receiver.SetAltStartCodeCallback(callback, arg);
+    }
+    waitRxIdle();
+#ifndef DMX_IGNORE_THREADSAFETY
+    if(sync_dmx != NULL) xSemaphoreGive(sync_dmx);
+#endif
+}
 
-    // Manage the temporrary buffer if needed
-    if(TmpBufferCreate) {
-        if(tmp_dmx_data != nullptr) {
-            tmp_dmx_data = (uint8_t *) realloc(tmp_dmx_data, sizeof(uint8_t)*(_NbChannels+1));
+bool DMX::SetFrameCallback(DMXFrameCallback callback, void * arg)
+{
+    // one setter at a time: the check and the swap go together, the pair replaced now is reused by the next one
+#ifndef DMX_IGNORE_THREADSAFETY
+    if(sync_dmx != NULL) xSemaphoreTake(sync_dmx, portMAX_DELAY);
+#endif
+    // one callback per universe, a second user would silently replace the first one
+    DMXFrameCallback current = isrMode() ? rx_frame_callback.GetCallback() : receiver.GetFrameCallback();
+    bool set = (callback == nullptr) || (current == nullptr);
+    if(set) {
+        if(isrMode()) {
+            rx_frame_callback.Set(callback, arg);
         } else {
-            tmp_dmx_data = (uint8_t *) malloc(sizeof(uint8_t)*(_NbChannels+1));
+            receiver.SetFrameCallback(callback, arg);
         }
+        waitRxIdle();
     }
+#ifndef DMX_IGNORE_THREADSAFETY
+    if(sync_dmx != NULL) xSemaphoreGive(sync_dmx);
+#endif
 
+    if(!set) {
+        DMX_LOG("DMX::SetFrameCallback : Error, a frame callback is already set!\n");
+    }
+    return set;
 }
 
+bool DMX::SetSlotsCallback(DMXSlotsCallback callback, void * arg)
+{
+    // the interrupt never runs the callbacks itself
+    if(config.rx_isr) {
+        DMX_LOG("DMX::SetSlotsCallback : Error, not available in the interrupt receive mode!\n");
+        return false;
+    }
+
+    // one setter at a time, the pair replaced now is reused by the next one
+#ifndef DMX_IGNORE_THREADSAFETY
+    if(sync_dmx != NULL) xSemaphoreTake(sync_dmx, portMAX_DELAY);
+#endif
+    receiver.SetSlotsCallback(callback, arg);
+    waitRxIdle();
+#ifndef DMX_IGNORE_THREADSAFETY
+    if(sync_dmx != NULL) xSemaphoreGive(sync_dmx);
+#endif
+    return true;
+}
 
-//*****************************************************************************
-//** Update the listenning startAddress and NbChannel => with buffer realloc **
-//*****************************************************************************
 void DMX::SetDmxStartAdress(uint16_t StartAddr) {
 
     // if we are writting on the DMX Bus, all channels are needed
-    if(dmx_state == DMX_OUTPUT) return;
+    if(direction == DMX_DIR_OUTPUT) return;
 
-    if(StartAddr == _StartDMXAddr) return;
+    receiver.SetDmxStartAdress(StartAddr);
+}
 
-    if((StartAddr == 0) || (StartAddr > 512)) return;
+uint16_t DMX::GetDmxStartAdress() {
 
-    if(StartAddr+_NbChannels > 513) return;
-
-#ifndef DMX_IGNORE_THREADSAFETY
-    xSemaphoreTake(sync_dmx, portMAX_DELAY);
-#endif
-    _StartDMXAddr = StartAddr;
-#ifndef DMX_IGNORE_THREADSAFETY
-    xSemaphoreGive(sync_dmx);
-#endif
+    // outputs send the whole frame
+    if(direction == DMX_DIR_OUTPUT) return 1;
 
+    return receiver.GetDmxStartAdress();
 }
 
-void DMX::SetDmxNbChannels(uint16_t nb) {
+uint16_t DMX::GetDmxNbChannels() {
 
-    // if we are writting on the DMX Bus, all channels are needed
-    if(dmx_state == DMX_OUTPUT) return;
+    if(direction == DMX_DIR_OUTPUT) return storage.slots;
 
-    if(nb == _NbChannels) return;
+    return receiver.GetDmxNbChannels();
+}
 
-    if((nb == 0) || (nb > 512)) return;
+void DMX::SetDmxNbChannels(uint16_t nb) {
 
-    if(_StartDMXAddr+nb > 513) return;
+    // if we are writting on the DMX Bus, all channels are needed
+    if(direction == DMX_DIR_OUTPUT) return;
 
-#ifndef DMX_IGNORE_THREADSAFETY
-    xSemaphoreTake(sync_dmx, portMAX_DELAY);
-#endif
-    _NbChannels = nb;
-    createBuffer(true);
-#ifndef DMX_IGNORE_THREADSAFETY
-    xSemaphoreGive(sync_dmx);
-#endif
+    receiver.SetDmxNbChannels(nb);
 }
 
 uint8_t DMX::Read(uint16_t channel)
 {
+    // received frames are read lock free from the last published frame
+    if(direction == DMX_DIR_INPUT)
+    {
+        // restrict acces to dmx array to valid values
+        if(channel < 1 || channel > receiver.GetDmxNbChannels())
+        {
+            return 0;
+        }
+        return receiver.GetFrame().Get(channel);
+    }
+
     // restrict acces to dmx array to valid values
-    if(channel < 1 || channel > _NbChannels)
+    if(channel < 1 || channel > storage.slots)
     {
         return 0;
     }
@@ -255,33 +496,47 @@ uint8_t DMX::Read(uint16_t channel)
 #ifndef DMX_IGNORE_THREADSAFETY
     xSemaphoreTake(sync_dmx, portMAX_DELAY);
 #endif
-    uint8_t tmp_dmx = dmx_data[channel];
+    uint8_t tmp_dmx = tx_frame.Back()[channel];
 #ifndef DMX_IGNORE_THREADSAFETY
     xSemaphoreGive(sync_dmx);
 #endif
     return tmp_dmx;
 }
 
-void DMX::ReadAll(uint8_t * data, uint16_t start, size_t size)
+bool DMX::ReadAll(uint8_t * data, uint16_t start, size_t size)
 {
+    uint16_t nb = (direction == DMX_DIR_INPUT) ? receiver.GetDmxNbChannels() : storage.slots;
+
     // restrict acces to dmx array to valid values
-    if(start < 1 || start > _NbChannels || start + size > (_NbChannels+1))
+    if(start < 1 || start > nb || start + size > (size_t)(nb+1))
     {
-        return;
+        return false;
     }
+
+    // consistent snapshot of the last published frame, never blocks
+    if(direction == DMX_DIR_INPUT)
+    {
+        receiver.GetFrame().Snapshot(data, start, size);
+        return true;
+    }
+
 #ifndef DMX_IGNORE_THREADSAFETY
     xSemaphoreTake(sync_dmx, portMAX_DELAY);
 #endif
-    memcpy(data, (uint8_t *)dmx_data + start, size);
+    memcpy(data, tx_frame.Back() + start, size);
 #ifndef DMX_IGNORE_THREADSAFETY
     xSemaphoreGive(sync_dmx);
 #endif
+    return true;
 }
 
 void DMX::Write(uint16_t channel, uint8_t value)
 {
+    // inputs have no send buffers
+    if(direction != DMX_DIR_OUTPUT) return;
+
     // restrict acces to dmx array to valid values
-    if(channel < 1 || channel > 512)
+    if(channel < 1 || channel > storage.slots)
     {
         return;
     }
@@ -289,7 +544,8 @@ void DMX::Write(uint16_t channel, uint8_t value)
 #ifndef DMX_IGNORE_THREADSAFETY
     xSemaphoreTake(sync_dmx, portMAX_DELAY);
 #endif
-    dmx_data[channel] = value;
+    tx_frame.Back()[channel] = value;
+    tx_dirty = true;
 #ifndef DMX_IGNORE_THREADSAFETY
     xSemaphoreGive(sync_dmx);
 #endif
@@ -297,225 +553,656 @@ void DMX::Write(uint16_t channel, uint8_t value)
 
 void DMX::WriteAll(uint8_t * data, uint16_t start, size_t size)
 {
+    // inputs have no send buffers
+    if(direction != DMX_DIR_OUTPUT) return;
+
     // restrict acces to dmx array to valid values
-    if(start < 1 || start > 512 || start + size > 513)
+    if(start < 1 || start > storage.slots || start + size > (size_t)(storage.slots + 1))
     {
         return;
     }
 #ifndef DMX_IGNORE_THREADSAFETY
     xSemaphoreTake(sync_dmx, portMAX_DELAY);
 #endif
-    memcpy((uint8_t *)dmx_data + start, data, size);
+    memcpy(tx_frame.Back() + start, data, size);
+    tx_dirty = true;
 #ifndef DMX_IGNORE_THREADSAFETY
     xSemaphoreGive(sync_dmx);
 #endif
 }
 
-uint8_t DMX::IsHealthy()
+//*****************************************************************************
+//** Atomic frame update: writes between BeginFrame and Commit go out        **
+//** together, without BeginFrame the writes are committed at each frame     **
+//*****************************************************************************
+void DMX::BeginFrame()
 {
-    // get timestamp of last received packet
+    frame_open = true;
+}
+
+void DMX::Commit()
+{
+    Commit((uint32_t) esp_timer_get_time());
+}
+
+void DMX::Commit(uint32_t origin_us)
+{
+    if(direction != DMX_DIR_OUTPUT) return;
+
 #ifndef DMX_IGNORE_THREADSAFETY
     xSemaphoreTake(sync_dmx, portMAX_DELAY);
 #endif
-    long dmx_timeout = last_dmx_packet;
+    tx_frame.Commit(origin_us);
+    tx_dirty = false;
+    frame_open = false;
 #ifndef DMX_IGNORE_THREADSAFETY
     xSemaphoreGive(sync_dmx);
 #endif
+}
+
+void DMX::WriteFrame(const uint8_t * data, uint16_t start, size_t size, uint32_t origin_us)
+{
+    if(direction != DMX_DIR_OUTPUT) return;
+
+    // restrict acces to dmx array to valid values
+    if(start < 1 || start > storage.slots || start + size > (size_t)(storage.slots + 1))
+    {
+        return;
+    }
+#ifndef DMX_IGNORE_THREADSAFETY
+    xSemaphoreTake(sync_dmx, portMAX_DELAY);
+#endif
+    memcpy(tx_frame.Overwrite(start, size) + start, data, size);
+    tx_frame.Commit(origin_us);
+    tx_dirty = false;
+    frame_open = false;
+#ifndef DMX_IGNORE_THREADSAFETY
+    xSemaphoreGive(sync_dmx);
+#endif
+}
+
+uint8_t DMX::IsHealthy()
+{
+    // get timestamp of last received packet
+    uint32_t dmx_timeout = receiver.GetLastPacket();
     // Serial.printf("DMX_IsHealthy: %d\n",dmx_timeout);
     // check if elapsed time < defined timeout
-    if(xTaskGetTickCount() - dmx_timeout < HEALTHY_TIME)
+    if((uint32_t) esp_timer_get_time() - dmx_timeout < HEALTHY_TIME * 1000)
     {
         return 1;
     }
     return 0;
 }
 
+uint32_t DMX::GetFrameSequence()
+{
+    return receiver.GetFrame().Sequence();
+}
+
+DMXRxStats DMX::GetStats() const
+{
+    // the update takes a few us in the receive task or the interrupt: a caller that preempted it
+    // lets it finish instead of spinning on it
+    DMXRxStats stats;
+    while(!receiver.GetStats(stats))
+    {
+        vTaskDelay(1);
+    }
+    return stats;
+}
+
+//*****************************************************************************
+//** Frame wait: the bit flips at each signal, any number of tasks can wait **
+//** on the next one; the sequence may skip frames (interrupt mode), so the  **
+//** wait is on the signals, not on the parity of the sequence               **
+//*****************************************************************************
+bool DMX::WaitForFrame(TickType_t timeout, uint32_t * seq)
+{
+    if((direction != DMX_DIR_INPUT) || (frame_events == NULL))
+    {
+        return false;
+    }
+
+    uint32_t current = signaled_seq;
+    TickType_t start = xTaskGetTickCount();
+    for(;;)
+    {
+        // the sequence is stored before the count: a count read before the signal waits on its bit
+        uint32_t count = signal_count;
+        if(signaled_seq != current) break;
+
+        TickType_t left = timeout;
+        if(timeout != portMAX_DELAY) {
+            TickType_t elapsed = xTaskGetTickCount() - start;
+            if(elapsed >= timeout) return false;
+            left = timeout - elapsed;
+        }
+        EventBits_t next = (count & 1) ? DMX_FRAME_EVEN : DMX_FRAME_ODD;
+        EventBits_t bits = xEventGroupWaitBits(frame_events, next, pdFALSE, pdFALSE, left);
+        if(!(bits & next))
+        {
+            return false;
+        }
+    }
+
+    if(seq != nullptr) *seq = signaled_seq;
+    return true;
+}
+
+//*****************************************************************************
+//** The receive task is in an event between two increments of rx_busy, the **
+//** interrupt between two of isr_busy: a callback or curves swapped before **
+//** their start are not used any more once they are out, and an idle line **
+//** never blocks the caller                                                 **
+//*****************************************************************************
+void DMX::waitRxIdle()
+{
+    if(direction != DMX_DIR_INPUT) return;
+
+    // interrupt receive mode: the frames are committed by the interrupt, which never waits for a task
+    uint32_t busy = isr_busy.load();
+    if(busy & 1) {
+        while(isr_busy.load() == busy) {
+            vTaskDelay(1);
+        }
+    }
+
+    if((task == NULL) || (xTaskGetCurrentTaskHandle() == task)) return;
+
+    busy = rx_busy.load();
+    if(busy & 1) {
+        while(rx_busy.load() == busy) {
+            vTaskDelay(1);
+        }
+    }
+}
+
+void DMX::signalFrame(uint32_t seq)
+{
+    if((seq == signaled_seq) || (frame_events == NULL)) return;
+
+    signaled_seq = seq;
+    uint32_t count = signal_count + 1;
+    signal_count = count;
+    EventBits_t bit = (count & 1) ? DMX_FRAME_ODD : DMX_FRAME_EVEN;
+    xEventGroupClearBits(frame_events, bit ^ (DMX_FRAME_EVEN | DMX_FRAME_ODD));
+    xEventGroupSetBits(frame_events, bit);
+}
+
+uint32_t DMX::ReadChanged(DMXChangedCallback callback, void * arg, uint32_t last_seq)
+{
+    if(direction != DMX_DIR_INPUT)
+    {
+        return last_seq;
+    }
+    return receiver.ReadChanged(callback, arg, last_seq);
+}
+
 void DMX::uart_send_task(void*pvParameters)
+{
+    static_cast<DMX *>(pvParameters)->txLoop();
+}
+
+void DMX::uart_event_task(void *pvParameters)
+{
+    static_cast<DMX *>(pvParameters)->rxLoop();
+}
+
+void DMX::uart_isr_task(void *pvParameters)
+{
+    static_cast<DMX *>(pvParameters)->rxIsrLoop();
+}
+
+//*****************************************************************************
+//** Break and MAB are generated by the UART, expressed in bits at 250kbaud   **
+//*****************************************************************************
+void DMX::SetTxTiming(uint16_t break_us, uint16_t mab_us)
+{
+    // E1.11 transmitter limits
+    if(break_us < 92) break_us = 92;
+    if(mab_us < 12) mab_us = 12;
+
+    // rounded up to the next bit time, in the range accepted by the uart
+    uint32_t break_bits = ((uint32_t) break_us * (DMX_BAUDRATE / 1000) + 999) / 1000;
+    uint32_t mab_bits = ((uint32_t) mab_us * (DMX_BAUDRATE / 1000) + 999) / 1000;
+    tx_break_bits = (break_bits > 255) ? 255 : break_bits;
+    tx_mab_bits = (mab_bits > 1023) ? 1023 : mab_bits;
+}
+
+DMXTxTiming DMX::GetTxTiming()
+{
+    DMXTxTiming timing;
+    uint32_t baudrate = DMX_BAUDRATE;
+
+    // the real baudrate depends on the uart clock divider
+    if(direction == DMX_DIR_OUTPUT) {
+        uart_get_baudrate(config.uart_num, &baudrate);
+    }
+
+    timing.break_us = (uint16_t) ((tx_break_bits * 1000000UL) / baudrate);
+    timing.mab_us = (uint16_t) ((tx_mab_bits * 1000000UL) / baudrate);
+    return timing;
+}
+
+//*****************************************************************************
+//** Output frame length and refresh rate                                     **
+//*****************************************************************************
+void DMX::SetTxSlots(uint16_t nb)
+{
+    if((nb == 0) || (nb > storage.slots)) return;
+
+    // applied on the next frame
+    tx_slots = nb;
+}
+
+void DMX::SetTxRefreshRate(uint16_t hz)
+{
+    uint32_t period = (hz == 0) ? 0 : 1000000UL / hz;
+
+    // never faster than the minimum break to break time
+    tx_min_period_us = (period < DMX_MIN_FRAME_US) ? DMX_MIN_FRAME_US : period;
+}
+
+float DMX::GetTxFrameRate()
+{
+    uint32_t period = tx_avg_period_us;
+    if(period == 0) return 0;
+    return 1000000.0f / period;
+}
+
+void DMX::SetTransform(const DMXTransform * curves)
+{
+    if(direction == DMX_DIR_INPUT) {
+        receiver.SetTransform(curves);
+
+        // the frame being committed may still go through the previous curves
+        waitRxIdle();
+        return;
+    }
+
+    // applied by the send task on the copy of the frame it sends
+    tx_transform.store(curves, std::memory_order_release);
+
+    // the send task may still apply the previous curves: wait till it queued one more frame
+    if((direction != DMX_DIR_OUTPUT) || (task == NULL) || (xTaskGetCurrentTaskHandle() == task)) return;
+
+    uint32_t loops = tx_loops.load();
+    while(tx_loops.load() == loops) {
+        vTaskDelay(1);
+    }
+}
+
+void DMX::SetTxCallback(DMXTxCallback callback, void * arg)
+{
+    // from the callback the send task is not using any pair, there is nothing to wait for
+    if((direction != DMX_DIR_OUTPUT) || (task == NULL) || (xTaskGetCurrentTaskHandle() == task)) {
+        tx_callback.Set(callback, arg);
+        return;
+    }
+
+    // one setter at a time: the pair replaced now is reused by the next one
+    while(!tx_callback.TryLock()) {
+        vTaskDelay(1);
+    }
+    tx_callback.Set(callback, arg);
+
+    // the send task may still run the previous pair: wait till it queued one more frame
+    uint32_t loops = tx_loops.load();
+    while(tx_loops.load() == loops) {
+        vTaskDelay(1);
+    }
+    tx_callback.Unlock();
+}
+
+DMXTxLatency DMX::GetTxLatency()
+{
+    // 32 bits fields updated once per frame, an approximate copy is enough for monitoring
+    DMXTxLatency copy;
+    memcpy(&copy, &tx_latency, sizeof(copy));
+    return copy;
+}
+
+void DMX::txLoop()
 {
     uint8_t start_code = 0x00;
+    uint16_t mab_bits = tx_mab_bits;
+    uint32_t last_frame = 0;
+
+    // the uart sends the break after each frame, followed by tx_idle_num bits
+    // of mark (MAB) before the next frame: frame, break, MAB, frame...
+    uart_set_tx_idle_num(config.uart_num, mab_bits);
+
+    // first break, sent after a lone start code ignored by the receivers
+    uart_write_bytes_with_break(config.uart_num, (const char*) &start_code, 1, tx_break_bits);
+
     for(;;)
     {
-        // wait till uart is ready
-        uart_wait_tx_done(DMX_UART_NUM, 1000);
-        // set line to inverse, creates break signal
-        uart_set_line_inverse(DMX_UART_NUM, UART_SIGNAL_TXD_INV);
-        // wait break time
-        ets_delay_us(184);
-        // disable break signal
-        uart_set_line_inverse(DMX_UART_NUM,  0);
-        // wait mark after break
-        ets_delay_us(24);
-        // write start code
-        uart_write_bytes(DMX_UART_NUM, (const char*) &start_code, 1);
+        // sleep till the previous frame is out, no cpu is used meanwhile
+        uart_wait_tx_done(config.uart_num, portMAX_DELAY);
+
+        // keep the minimum spacing between frames, rounded up to the next tick
+        uint32_t elapsed = (uint32_t) esp_timer_get_time() - last_frame;
+        if(elapsed < tx_min_period_us) {
+            uint32_t tick_us = portTICK_PERIOD_MS * 1000;
+            vTaskDelay((tx_min_period_us - elapsed + tick_us - 1) / tick_us);
+        }
+
+        // achieved frame period, averaged over ~8 frames
+        uint32_t now = (uint32_t) esp_timer_get_time();
+        uint32_t period = now - last_frame;
+        last_frame = now;
+        if(tx_avg_period_us == 0) {
+            tx_avg_period_us = period;
+        } else {
+            tx_avg_period_us = tx_avg_period_us + ((int32_t) (period - tx_avg_period_us)) / 8;
+        }
+
+        if(mab_bits != tx_mab_bits) {
+            mab_bits = tx_mab_bits;
+            uart_set_tx_idle_num(config.uart_num, mab_bits);
+        }
+
+        // no frame open: commit the writes done since the last frame, unless a writer is busy
+        if(!frame_open && tx_dirty) {
 #ifndef DMX_IGNORE_THREADSAFETY
-        xSemaphoreTake(sync_dmx, portMAX_DELAY);
+            if(xSemaphoreTake(sync_dmx, 0) == pdTRUE) {
 #endif
-        // transmit the dmx data
-        uart_write_bytes(DMX_UART_NUM, (const char*) dmx_data+1, 512);
+                if(!frame_open && tx_dirty) {
+                    tx_frame.Commit((uint32_t) esp_timer_get_time());
+                    tx_dirty = false;
+                }
 #ifndef DMX_IGNORE_THREADSAFETY
-        xSemaphoreGive(sync_dmx);
+                xSemaphoreGive(sync_dmx);
+            }
 #endif
+        }
+
+        // queue the start code, the dmx data and the break for the next frame,
+        // the front buffer is owned by this task, no lock is held
+        bool fresh;
+        uint16_t slots = tx_slots;
+        tx_frame.Acquire(&fresh);
+        uint8_t * frame = tx_frame.Front();
+
+        // last stages (fades, then curves) on a copy: the front buffer keeps the written values,
+        // it is sent again when nothing is committed and becomes a back buffer later on
+        const DMXCallbackPair<DMXTxCallback>::Pair * stage = tx_callback.Get();
+        const DMXTransform * curves = tx_transform.load(std::memory_order_acquire);
+        if(((stage->callback != nullptr) || (curves != nullptr)) && (tx_wire != nullptr)) {
+            memcpy(tx_wire, frame, slots + 1);
+            frame = tx_wire;
+
+            if(stage->callback != nullptr) {
+                stage->callback(frame, slots, (uint32_t) esp_timer_get_time(), stage->arg);
+            }
+            if(curves != nullptr) {
+                curves->Apply(frame, 1, slots);
+            }
+        }
+
+        // the line is idle after the MAB, the first slot leaves as soon as it is queued
+        uint32_t sent = (uint32_t) esp_timer_get_time();
+        uart_write_bytes_with_break(config.uart_num, (const char*) frame, slots + 1, tx_break_bits);
+        tx_loops.fetch_add(1);
+
+        if(fresh) {
+            uint32_t latency = sent - tx_frame.FrontStamp();
+            tx_latency.last_us = latency;
+            if((tx_latency.frames == 0) || (latency < tx_latency.min_us)) tx_latency.min_us = latency;
+            if(latency > tx_latency.max_us) tx_latency.max_us = latency;
+            if(tx_latency.frames == 0) {
+                tx_latency.avg_us = latency;
+            } else {
+                tx_latency.avg_us += ((int32_t) (latency - tx_latency.avg_us)) / 16;
+            }
+            tx_latency.frames++;
+        }
     }
 }
 
-void DMX::uart_event_task(void *pvParameters)
+void DMX::rxLoop()
 {
     uart_event_t event;
     uint8_t* dtmp = (uint8_t*) malloc(BUF_SIZE);
-    size_t data_size = 0;
+    int len;
 
-    Serial.print("DMX::uart_event_task::Started\n");
+    DMX_LOG("DMX::uart_event_task::Started (UART%d)\n", config.uart_num);
 
     for(;;)
     {
         // wait for data in the dmx_queue
         if(xQueueReceive(dmx_rx_queue, (void * )&event, (portTickType)portMAX_DELAY))
         {
+            uint32_t now = (uint32_t) esp_timer_get_time();
+            rx_busy.fetch_add(1);
 
-            //Serial.printf("DMX::uart_event_task::xQueueReceive (code %d)\n",event.type);
+            receiver.OnEvent();
 
-            bzero(dtmp, BUF_SIZE);
             switch(event.type)
             {
                 case UART_DATA:
-                    // read the received data
-                    uart_read_bytes(DMX_UART_NUM, dtmp, event.size, portMAX_DELAY);
-
-                    //Serial.print("DMX_UART_DATA\n");
-
-                    // check if break detected
-                    if(dmx_state == DMX_BREAK)
-                    {
-                        // if not 0, then RDM or custom protocol
-                      if(dtmp[0] == 0)
-                        {
-                        dmx_state = DMX_DATA;
-                        
-                        // reset dmx adress to 0
-                        current_rx_addr = 0;
-#ifndef DMX_IGNORE_THREADSAFETY
-                        xSemaphoreTake(sync_dmx, portMAX_DELAY);
-#endif
-                        // store received timestamp
-                        last_dmx_packet = xTaskGetTickCount();
-#ifndef DMX_IGNORE_THREADSAFETY
-                        xSemaphoreGive(sync_dmx);
-#endif
-                       }
-                       else {
-                        dmx_state = DMX_IDLE;
-                       }
-                    }
-                    // check if in data receive mode
-                    if(dmx_state == DMX_DATA)
-                    {
-#ifndef DMX_IGNORE_THREADSAFETY
-                        xSemaphoreTake(sync_dmx, portMAX_DELAY);
-#endif
-
-                        // copy received bytes to dmx data array
-                        for(int i = 0; i < event.size; i++)
-                        {
-                            if(current_rx_addr < 513)
-                            {
-                                isAllZero = isAllZero && (dtmp[i] == 0);
-                                //tmp_dmx_data[current_rx_addr++] = dtmp[i];
-                                if((current_rx_addr >= _StartDMXAddr) && 
-                                   (current_rx_addr <  (_StartDMXAddr+_NbChannels)) ) {
-
-                                    tmp_dmx_data[current_rx_addr-_StartDMXAddr+1] = dtmp[i];
-                                }
-
-                                current_rx_addr++;
-                                //Serial.print(current_rx_addr);
-                                //Serial.print(" = ");
-
-                                if(current_rx_addr == 513)  {
-                                    dmx_state = DMX_DONE; 
-                                    //Serial.print("READ DMX_DONE\n");
-                                }
-                            } else {
-                                dmx_state = DMX_DONE;    
-                                //Serial.print("DMX_DONE\n");                            
-                            }
-                        }
-#ifndef DMX_IGNORE_THREADSAFETY
-                        xSemaphoreGive(sync_dmx);
-#endif
+                    // read the received data and feed the state machine, without waiting: an overflow may have read it already
+                    len = uart_read_bytes(config.uart_num, dtmp, (event.size < BUF_SIZE) ? event.size : BUF_SIZE, 0);
+                    if(len > 0) {
+                        receiver.OnData(dtmp, len, now);
                     }
                     break;
                 case UART_BREAK:
-                    // break detected
+                    // break detected, the frame received so far is committed by the state machine
+                    receiver.OnBreak(now);
                     // clear queue und flush received bytes  
-                    //Serial.print("DMX_RX::DMX_BREAK>"); 
-                    if((dmx_state == DMX_DONE) || (dmx_state == DMX_DATA))  { 
-                        uart_flush_input(DMX_UART_NUM);
-                        xQueueReset(dmx_rx_queue);
-                        //Serial.print("state = (DMX_DONE ou DMX_DATA) > Change a DMX_BREAK\n");
-                        dmx_state = DMX_BREAK;
-                        //Serial.print("Last Chan :");
-                       // Serial.println(current_rx_addr-1);
-
-                        if (!isAllZero) {
-
-                        
-#ifndef DMX_IGNORE_THREADSAFETY
-                            xSemaphoreTake(sync_dmx, portMAX_DELAY);
-#endif                        
-                            memcpy((uint8_t *)dmx_data, tmp_dmx_data, _NbChannels+1);
-#ifndef DMX_IGNORE_THREADSAFETY
-                            xSemaphoreGive(sync_dmx);                 
-#endif                        
-                            isAllZero = true;    
-                            CptAllZeroFrame = 0;   
-                        }
-                        else {
-                            
-                            CptAllZeroFrame++;
-
-                            if(CptAllZeroFrame >= NBZEROFRAME_TRIGGER_BLACKOUT) {
-#ifndef DMX_IGNORE_THREADSAFETY
-                                xSemaphoreTake(sync_dmx, portMAX_DELAY);
-#endif                                                        
-                                memset((uint8_t *)dmx_data, 0, _NbChannels+1);
-#ifndef DMX_IGNORE_THREADSAFETY
-                                xSemaphoreGive(sync_dmx);                 
-#endif  
-                                CptAllZeroFrame = 0; 
-                            } 
-                            else {
-                                if (CptAllZeroFrame == 1) Serial.print("DMX_RX::DMX_BREAK > state = (DMX_DONE/DATA) && Trame ALL Zero !\n"); 
-                            }
-
-
-                            isAllZero = true;
-                        }
-                       // Serial.print("UART_BREAK");
-                    }  else if (dmx_state == DMX_IDLE) {
-                        uart_flush_input(DMX_UART_NUM);
-                        xQueueReset(dmx_rx_queue);                        
-                        dmx_state = DMX_BREAK;    
-                        Serial.print("DMX_RX::DMX_BREAK > state = (DMX_IDLE) > Change a DMX_BREAK\n");                    
-                    } else {
-                        Serial.print("DMX_RX::DMX_BREAK > state = (xxxx) > Change a DMX_IDLE\n");
-                        uart_flush_input(DMX_UART_NUM);
-                        xQueueReset(dmx_rx_queue);
-                        dmx_state = DMX_IDLE;
-                    }
-
+                    uart_flush_input(config.uart_num);
+                    xQueueReset(dmx_rx_queue);
                     break;
-                case UART_FRAME_ERR:
-                case UART_PARITY_ERR:
                 case UART_BUFFER_FULL:
+                    // the ring is full, nothing is lost yet: reading it lets the driver go on
+                    drainRx(dtmp, now);
+                    break;
                 case UART_FIFO_OVF:
+                    // bytes lost after the ones buffered: keep those, the frame ends there and is committed at the next break
+                    drainRx(dtmp, now);
+                    receiver.OnOverflow(now);
+                    break;
+                case UART_FRAME_ERR:
+                case UART_PARITY_ERR:
                 default:
                     // error recevied, going to idle mode
-                    uart_flush_input(DMX_UART_NUM);
+                    uart_flush_input(config.uart_num);
                     xQueueReset(dmx_rx_queue);
-                    dmx_state = DMX_IDLE;
-                    Serial.print("DMX::uart_event_task::UART_ERROR");
+                    receiver.OnError();
+                    DMX_LOG("DMX::uart_event_task::UART_ERROR\n");
                     break;
             }
+
+            // a frame was committed by this event
+            signalFrame(receiver.GetFrame().Sequence());
+            rx_busy.fetch_add(1);
         }
     }
 }
+
+void DMX::drainRx(uint8_t * buffer, uint32_t now_us)
+{
+    size_t buffered = 0;
+    uart_get_buffered_data_len(config.uart_num, &buffered);
+
+    while(buffered > 0)
+    {
+        int len = uart_read_bytes(config.uart_num, buffer, (buffered < BUF_SIZE) ? buffered : BUF_SIZE, 0);
+        if(len <= 0) break;
+
+        receiver.OnData(buffer, len, now_us);
+        buffered = ((size_t) len < buffered) ? buffered - len : 0;
+    }
+}
+
+
+//*****************************************************************************
+//** Interrupt receive mode: the uart interrupt decodes the fifo straight    **
+//** into the receiver, the task is only woken up to run the callbacks       **
+//*****************************************************************************
+void DMX::rxIsrLoop()
+{
+    uart_dev_t * hw = UART_LL_GET_HW(config.uart_num);
+
+    DMX_LOG("DMX::uart_isr_task::Started (UART%d)\n", config.uart_num);
+
+    uart_ll_disable_intr_mask(hw, UART_LL_INTR_MASK);
+    uart_ll_clr_intsts_mask(hw, UART_LL_INTR_MASK);
+    uart_ll_rxfifo_rst(hw);
+    uart_ll_set_rxfifo_full_thr(hw, config.rx_full_threshold);
+    uart_ll_set_rx_tout(hw, config.rx_timeout);
+
+    // allocated from this task, the interrupt runs on the core of the task
+    if(esp_intr_alloc(uart_periph_signal[config.uart_num].irq, 0, DMX::uart_rx_isr, this, &rx_intr) != ESP_OK) {
+        DMX_LOG("DMX::uart_isr_task : Error when allocating the UART interrupt!\n");
+        rx_intr = NULL;
+    }
+    uart_ll_ena_intr_mask(hw, DMX_RX_INTR_MASK);
+
+    for(;;)
+    {
+        uint32_t events = 0;
+        xTaskNotifyWait(0, 0xFFFFFFFF, &events, portMAX_DELAY);
+        rx_busy.fetch_add(1);
+
+        // copy of the last frame, the interrupt may already publish the next one
+        portENTER_CRITICAL(&rx_mux);
+        const uint8_t * frame = isr_frame;
+        const uint32_t * dirty = isr_dirty;
+        uint16_t start = isr_start;
+        uint16_t nb = isr_nb;
+        uint32_t seq = isr_seq;
+        uint32_t now = isr_us;
+        portEXIT_CRITICAL(&rx_mux);
+
+        // every packet copied by the interrupt, in order, its slot is given back once the callback returned
+        if(events & DMX_NOTIFY_ALT) {
+            uint32_t tail = isr_alt_tail.load(std::memory_order_relaxed);
+            uint32_t head = isr_alt_head.load(std::memory_order_acquire);
+            const DMXCallbackPair<DMXAltCallback>::Pair * alt_callback = rx_alt_callback.Get();
+            for(; tail != head; tail++) {
+                const AltPacket & packet = isr_alt[tail % DMX_ALT_RING];
+                if(alt_callback->callback != nullptr) {
+                    alt_callback->callback(packet.data[0], packet.data, packet.size, alt_callback->arg);
+                }
+                isr_alt_tail.store(tail + 1, std::memory_order_release);
+            }
+        }
+
+        if(events & DMX_NOTIFY_FRAME) {
+            signalFrame(seq);
+
+            // a published buffer is only reused two frames later: a task that came later skips it
+            const DMXCallbackPair<DMXFrameCallback>::Pair * callback = rx_frame_callback.Get();
+            if(callback->callback != nullptr) {
+                if(((receiver.GetFrame().Sequence() - seq) & DMXFrameBuffer::SEQ_MASK) < 2) {
+                    callback->callback(frame, start, nb, dirty, seq, now, callback->arg);
+                } else {
+                    receiver.OnLateFrame();
+                }
+            }
+        }
+        rx_busy.fetch_add(1);
+    }
+}
+
+void DMX::uart_rx_isr(void * arg)
+{
+    static_cast<DMX *>(arg)->rxInterrupt();
+}
+
+void DMX::rxInterrupt()
+{
+    uart_dev_t * hw = UART_LL_GET_HW(config.uart_num);
+    uint8_t fifo[DMX_RX_FIFO_SIZE];
+    uint32_t status = uart_ll_get_intsts_mask(hw);
+    uint32_t now = (uint32_t) esp_timer_get_time();
+
+    isr_busy.fetch_add(1);
+    rx_woken = pdFALSE;
+    receiver.OnEvent();
+
+    // a break is also seen as a framing error
+    uint32_t errors = UART_INTR_PARITY_ERR;
+    if(!(status & UART_INTR_BRK_DET)) errors |= UART_INTR_FRAM_ERR;
+
+    if(status & errors)
+    {
+        // error recevied, going to idle mode
+        uart_ll_rxfifo_rst(hw);
+        receiver.OnError();
+    }
+    else if(status & UART_INTR_RXFIFO_OVF)
+    {
+        // the fifo holds the bytes received before the loss: keep them, the frame ends there
+        uint32_t len = uart_ll_get_rxfifo_len(hw);
+        if(len > DMX_RX_FIFO_SIZE) len = DMX_RX_FIFO_SIZE;
+        uart_ll_read_rxfifo(hw, fifo, len);
+        uart_ll_rxfifo_rst(hw);
+
+        receiver.OnData(fifo, len, now);
+        receiver.OnOverflow(now);
+    }
+    else if(status & (UART_INTR_RXFIFO_FULL | UART_INTR_RXFIFO_TOUT | UART_INTR_BRK_DET))
+    {
+        uint32_t len = uart_ll_get_rxfifo_len(hw);
+        if(len > DMX_RX_FIFO_SIZE) len = DMX_RX_FIFO_SIZE;
+        uart_ll_read_rxfifo(hw, fifo, len);
+
+        // the break itself is pushed into the fifo as a 0
+        if((status & UART_INTR_BRK_DET) && (len > 0) && (fifo[len - 1] == 0)) len--;
+
+        if(len > 0) {
+            receiver.OnData(fifo, len, now);
+        }
+    }
+
+    // the frame received so far is committed by the state machine
+    if(status & UART_INTR_BRK_DET) {
+        receiver.OnBreak(now);
+    }
+
+    uart_ll_clr_intsts_mask(hw, status);
+    isr_busy.fetch_add(1);
+
+    if(rx_woken == pdTRUE) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+// called by the receiver from the interrupt, the waiters and the callbacks are served by the receive task
+void DMX::isr_frame_callback(const uint8_t * frame, uint16_t start, uint16_t nb, const uint32_t * dirty, uint32_t seq, uint32_t now_us, void * arg)
+{
+    DMX * dmx = static_cast<DMX *>(arg);
+
+    portENTER_CRITICAL_ISR(&dmx->rx_mux);
+    dmx->isr_frame = frame;
+    dmx->isr_dirty = dirty;
+    dmx->isr_start = start;
+    dmx->isr_nb = nb;
+    dmx->isr_seq = seq;
+    dmx->isr_us = now_us;
+    portEXIT_CRITICAL_ISR(&dmx->rx_mux);
+
+    xTaskNotifyFromISR(dmx->task, DMX_NOTIFY_FRAME, eSetBits, &dmx->rx_woken);
+}
+
+void DMX::isr_alt_callback(uint8_t start_code, const uint8_t * data, uint16_t size, void * arg)
+{
+    DMX * dmx = static_cast<DMX *>(arg);
+    if((dmx->rx_alt_callback.GetCallback() == nullptr) || (dmx->isr_alt == nullptr)) return;
+
+    // the receiver reuses its capture buffer for the next packet: copied into a free slot of the ring
+    uint32_t head = dmx->isr_alt_head.load(std::memory_order_relaxed);
+    if(head - dmx->isr_alt_tail.load(std::memory_order_acquire) >= DMX_ALT_RING) {
+        dmx->receiver.OnAltDropped();
+        return;
+    }
+    AltPacket & packet = dmx->isr_alt[head % DMX_ALT_RING];
+    memcpy(packet.data, data, size);
+    packet.size = size;
+    dmx->isr_alt_head.store(head + 1, std::memory_order_release);
+
+    xTaskNotifyFromISR(dmx->task, DMX_NOTIFY_ALT, eSetBits, &dmx->rx_woken);
+}
@@ -27,66 +27,323 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
+#include "freertos/event_groups.h"
 #include "driver/uart.h"
+#include "esp_intr_alloc.h"
+
+#include "dmx_receiver.h"
 
 #ifndef DMX_h
 #define DMX_h
 
+class Print;
+
 
 enum DMXDirection { DMX_DIR_INPUT, DMX_DIR_OUTPUT };
-enum DMXState { DMX_IDLE, DMX_BREAK, DMX_DATA,DMX_DONE, DMX_OUTPUT };
 
+// Break and mark after break generated on output
+struct DMXTxTiming
+{
+    uint16_t break_us;
+    uint16_t mab_us;
+};
+
+// Time from a commit to its first slot on the wire (microseconds)
+struct DMXTxLatency
+{
+    uint32_t frames;                                        // committed frames sent
+    uint32_t last_us;
+    uint32_t min_us;
+    uint32_t avg_us;                                        // running average over ~16 frames
+    uint32_t max_us;
+};
+
+// called by the send task before each frame is sent: frame[0] is the start code, frame[1..nb] the slots
+// to send. frame is a copy made for this frame only, Read() and the next frames keep the written values
+typedef void (*DMXTxCallback)(uint8_t * frame, uint16_t nb, uint32_t now_us, void * arg);
+
+// Hardware setup of one universe, the default values are the historic ones (UART2, see dmx.cpp)
+struct DMXConfig
+{
+    DMXConfig();
+
+    uart_port_t uart_num;                                   // dmx uart
+    int rx_pin;                                             // pin for dmx rx
+    int tx_pin;                                             // pin for dmx tx
+    int dir_pin;                                            // pin for dmx rx/tx change, -1 when the direction is set by the hardware
+    UBaseType_t task_priority;                              // priority of the rx/tx task
+    BaseType_t task_core;                                   // core the rx/tx task should run on
+    bool rx_isr;                                            // input decoded in the uart interrupt, without uart driver nor event queue
+    uint8_t rx_full_threshold;                              // bytes in the uart fifo (1-127) that wake the reader up, 0 for the default of the receive mode
+    uint8_t rx_timeout;                                     // idle time on the line (in slots, 1-126) before a partly filled fifo is read
+};
+
+#define DMX_TX_STACK_SIZE       1024        // stack of the send task (bytes)
+#define DMX_RX_STACK_SIZE       2048        // stack of the receive task (bytes)
+#define DMX_ALT_RING            4           // alternate start code packets handed over by the interrupt at once
+
+// Memory of a universe given by the application (see DMXUniverse), the nullptr fields are allocated at Initialize
+struct DMXStorage
+{
+    DMXStorage();
+
+    uint16_t slots;                                         // largest listened window (input) or frame (output), 512 by default
+    uint8_t * frames;                                       // DMX::FramesSize(direction, slots) bytes, 32 bits aligned
+    StackType_t * stack;                                    // DMX_RX_STACK_SIZE or DMX_TX_STACK_SIZE bytes
+    StaticTask_t * task;
+    StaticSemaphore_t * mutex;
+    StaticEventGroup_t * events;                            // input only
+};
+
+// One DMX universe on one UART, up to three can run at the same time on an ESP32
 class DMX
 {
     public:
-        static void Initialize(DMXDirection direction, 
-                               uint16_t StartAddr=1, uint16_t NbChannels=512);    // initialize library
+        DMX(const DMXConfig & config = DMXConfig(), const DMXStorage & storage = DMXStorage());
+        ~DMX();
+
+        // bytes of frame buffers needed by a universe of slots channels, outputs have a fourth
+        // buffer for the copy sent when a tx callback or a transform is set
+        static constexpr size_t FramesSize(DMXDirection direction, uint16_t slots)
+        {
+            return (direction == DMX_DIR_INPUT) ? 3 * (size_t) DMXReceiver::FrameSize(slots) : 4 * (size_t) (slots + 1);
+        }
 
-        static void SetDmxStartAdress(uint16_t StartAddr);
-        static void SetDmxNbChannels(uint16_t nb);
+        void Initialize(DMXDirection direction, 
+                        uint16_t StartAddr=1, uint16_t NbChannels=512);    // initialize the universe
 
-        static uint8_t Read(uint16_t channel);              // returns the dmx value for the givven address (values from 1 to 512)
+        void SetDmxStartAdress(uint16_t StartAddr);
+        void SetDmxNbChannels(uint16_t nb);
 
-        static void ReadAll(uint8_t * data, uint16_t start, size_t size);   // copies the defined channels from the read buffer
+        uint8_t Read(uint16_t channel);                     // returns the dmx value for the givven address (values from 1 to 512)
 
-        static void Write(uint16_t channel, uint8_t value); // writes the dmx value to the buffer
+        bool ReadAll(uint8_t * data, uint16_t start, size_t size);   // copies the defined channels from the read buffer, false when out of it
+
+        uint16_t GetDmxStartAdress();                       // address of channel 1 of the read buffer: the listened window (input), 1 (output)
+        uint16_t GetDmxNbChannels();                        // channels of the read buffer
+
+        void Write(uint16_t channel, uint8_t value);        // writes the dmx value to the buffer
         
-        static void WriteAll(uint8_t * data, uint16_t start, size_t size);  // copies the defined channels into the write buffer
+        void WriteAll(uint8_t * data, uint16_t start, size_t size);  // copies the defined channels into the write buffer
+
+        void BeginFrame();                                  // following writes are only sent after Commit()
+        void Commit();                                      // sends all the writes done since BeginFrame() in the same frame
+        void Commit(uint32_t origin_us);                    // same, latency measured from origin_us (esp_timer time the data arrived)
+
+        // WriteAll() and Commit(origin_us) at once: the slots out of [start, start + size) come from the last frame,
+        // so each slot is copied a single time (see DMXNetBridge)
+        void WriteFrame(const uint8_t * data, uint16_t start, size_t size, uint32_t origin_us);
+
+        DMXTxLatency GetTxLatency();                        // latency from commit (or origin) to the wire
+
+        uint8_t IsHealthy();                                // returns true, when a valid DMX signal was received within the last 500ms
+
+        uint32_t GetFrameSequence();                        // number of frames received so far, changes each time a new frame is available
+
+        // blocks till a new frame is received (at most timeout ticks), seq gets its sequence number, false on timeout
+        bool WaitForFrame(TickType_t timeout = portMAX_DELAY, uint32_t * seq = nullptr);
+
+        // calls callback for each range of channels changed since the frame last_seq (everything when frames were missed),
+        // returns the sequence of the frame read, to be given back on the next call
+        uint32_t ReadChanged(DMXChangedCallback callback, void * arg = nullptr, uint32_t last_seq = 0);
+
+        void SetTxTiming(uint16_t break_us, uint16_t mab_us);   // break and MAB to send (default 184us / 24us)
+        DMXTxTiming GetTxTiming();                          // break and MAB really generated by the uart
+
+        void SetTxSlots(uint16_t nb);                       // number of slots sent per frame (default 512)
+        void SetTxRefreshRate(uint16_t hz);                 // maximum frames per second sent, 0 for as fast as possible
+        float GetTxFrameRate();                             // frames per second really sent
 
-        static uint8_t IsHealthy();                            // returns true, when a valid DMX signal was received within the last 500ms
+        // callback is called from the send task once per frame, right before it is sent (see DMXFader). The callback
+        // and its argument are swapped as one; returns once the send task is done with the previous ones, so they
+        // may be released afterwards. Called from the callback itself, no other task may set it at the same time
+        void SetTxCallback(DMXTxCallback callback, void * arg = nullptr);
+
+        // curves applied to each received frame at its commit, or to a copy of each frame right before it is sent
+        // (after the tx callback), nullptr for none. Set after Initialize; returns once the frame in progress is
+        // done with the previous transform, so it may be changed or released afterwards (see DMXTransform)
+        void SetTransform(const DMXTransform * curves);
+
+        const DMXConfig & GetConfig() const { return config; }
+
+        // diagnostics of the library (errors, task starts) are printed on log, Serial by default, nullptr for none.
+        // Serial carrying a protocol must be left alone: DMXUsbPro silences the log while it uses it
+        static void SetLog(Print * log) { DMX::log = log; }
+        static Print * GetLog() { return log; }
+
+        // RAM used by the universe: instance, frame buffers, task stack, FreeRTOS objects and uart rings
+        // (the internal objects of the uart driver and the interrupt handle excepted), valid after Initialize
+        size_t GetFootprint() const;
+
+        const DMXRxCounters & GetRxCounters() const { return receiver.GetCounters(); }  // counters of the receive state machine
+
+        // window filled and published with each received frame from the next break on, so a task reads its
+        // own channels without copying the universe (see DMXWindow), it stays registered as long as the universe
+        bool AddWindow(DMXWindow & window);
+
+        // packets with a non 0 start code (RDM, text, SIP...) are captured and given to callback from the receive task,
+        // set it before Initialize (the interrupt receive mode allocates DMX_ALT_RING packets for it then). The callback
+        // and its argument are swapped as one, returns once the receive task is out of the previous callback
+        void SetAltStartCodeCallback(DMXAltCallback callback, void * arg = nullptr);
+
+        // callback is called from the receive task after each received frame is published, set it before Initialize.
+        // There is a single one per universe (used by DMXMerger, DMXRecorder...): refused (false) while another one
+        // is set, nullptr removes it. The callback and its argument are swapped as one; returns once the receive
+        // task is out of the previous callback, so its argument may be released afterwards
+        bool SetFrameCallback(DMXFrameCallback callback, void * arg = nullptr);
+
+        // callback sees each chunk of the received frame as it arrives and each break (see DMXRepeater), it runs
+        // in the receive task and is refused in the interrupt receive mode. Swapped as one with its argument,
+        // returns once the receive task is out of the previous callback
+        bool SetSlotsCallback(DMXSlotsCallback callback, void * arg = nullptr);
+
+        // timing of the received signal (frame rate, period, slots, jitter), waits a tick at a time while the
+        // receive task updates it
+        DMXRxStats GetStats() const;
+        void ResetStats() { receiver.ResetStats(); }
         
     private:
-        DMX();                                              // hide constructor
-        ~DMX();                                             // hide destructor
+        DMX(const DMX &);                                   // not copyable, the tasks keep a pointer on the instance
+        DMX & operator=(const DMX &);
+
+        DMXConfig config;                                   // uart, pins and task settings of this universe
+        DMXStorage storage;                                 // memory given by the application
+        static Print * volatile log;                        // diagnostics output, shared by all the universes
+        size_t rx_ring;                                     // sizes of the uart driver rings
+        size_t tx_ring;
+
+        TaskHandle_t task;                                  // rx or tx task of this universe
 
-        static uint16_t _StartDMXAddr;                      // First adress liestend
-        static uint16_t _NbChannels;                        // Number of channels listened from the start address
+        DMXDirection direction;                             // direction given to Initialize
 
-        static QueueHandle_t  dmx_rx_queue;                  // queue for uart rx events
+        QueueHandle_t  dmx_rx_queue;                        // queue for uart rx events
         
-        static SemaphoreHandle_t sync_dmx;                  // semaphore for syncronising access to dmx array
+        SemaphoreHandle_t sync_dmx;                         // semaphore for syncronising the writers of the output dmx array
+
+        DMXTxBuffer tx_frame;                               // dmx data to send (output mode), written by the app, sent from a stable copy
+        volatile bool frame_open;                           // BeginFrame() called, no automatic commit
+        volatile bool tx_dirty;                             // writes not committed yet
+
+        volatile uint8_t tx_break_bits;                     // break length in bits, generated by the uart
+        volatile uint16_t tx_mab_bits;                      // mark after break in bits (uart tx idle)
+        volatile uint16_t tx_slots;                         // slots sent per frame
+        volatile uint32_t tx_min_period_us;                 // minimum time between two frames
+        volatile uint32_t tx_avg_period_us;                 // measured time between two frames
+        DMXTxLatency tx_latency;                            // written by the send task only
+        DMXCallbackPair<DMXTxCallback> tx_callback;         // last stage before the frame is sent
+        std::atomic<const DMXTransform *> tx_transform;     // curves on the frame sent
+        uint8_t * tx_wire;                                  // copy of the frame given to the tx callback and the transform
+        std::atomic<uint32_t> tx_loops;                     // frames queued by the send task
+
+        DMXReceiver receiver;                               // receive state machine and received frames (input mode)
 
-        static DMXState dmx_state;                           // status, in which recevied state we are
+        std::atomic<uint32_t> rx_busy;                      // odd while the receive task handles an event (callbacks, curves)
+        std::atomic<uint32_t> isr_busy;                     // odd while the interrupt runs (curves, interrupt receive mode)
 
-        static uint16_t current_rx_addr;                    // last received dmx channel
+        EventGroupHandle_t frame_events;                    // parity bit of the signal count, wakes up WaitForFrame()
+        volatile uint32_t signaled_seq;                     // sequence of the last signaled frame
+        volatile uint32_t signal_count;                     // frames signaled, one per signal whatever the sequence skipped
 
-        static long last_dmx_packet;                        // timestamp for the last received packet
+        // interrupt receive mode (config.rx_isr): the frames are published from the interrupt,
+        // the receive task only runs the callbacks
+        intr_handle_t rx_intr;
+        portMUX_TYPE rx_mux;                                // guards the event handed over by the interrupt
+        BaseType_t rx_woken;                                // a task was woken up by the interrupt
+        DMXCallbackPair<DMXFrameCallback> rx_frame_callback;
+        DMXCallbackPair<DMXAltCallback> rx_alt_callback;
+        const uint8_t * isr_frame;                          // last frame published by the interrupt
+        const uint32_t * isr_dirty;
+        uint16_t isr_start;
+        uint16_t isr_nb;
+        uint32_t isr_seq;
+        uint32_t isr_us;
+        struct AltPacket
+        {
+            uint16_t size;
+            uint8_t data[DMX_ALT_MAX_SIZE];
+        };
+        AltPacket * isr_alt;                                // DMX_ALT_RING packets copied by the interrupt, allocated at Initialize
+        std::atomic<uint32_t> isr_alt_head;                 // packets copied by the interrupt
+        std::atomic<uint32_t> isr_alt_tail;                 // packets given to the callback by the receive task
 
-        static uint8_t * dmx_data;                          // stores the validated dmx data
-        static uint8_t * tmp_dmx_data;                      // stores the received dmx data
 
+        static void uart_event_task(void *pvParameters);    // event task, pvParameters is the DMX instance
 
+        static void uart_send_task(void*pvParameters);      // transmit task, pvParameters is the DMX instance
 
-        // Filter on Zéros DMX Frame
-        static bool isAllZero;                              // indicate when a zéro frame is detected
-        static uint8_t CptAllZeroFrame;                     // store the number of successive zéro frame detected, if more than 12 ==> Blackout
+        static void uart_isr_task(void *pvParameters);      // receive task of the interrupt receive mode, pvParameters is the DMX instance
 
+        static void uart_rx_isr(void * arg);                // uart interrupt handler (interrupt receive mode), arg is the DMX instance
+        static void isr_frame_callback(const uint8_t * frame, uint16_t start, uint16_t nb, const uint32_t * dirty, uint32_t seq, uint32_t now_us, void * arg);
+        static void isr_alt_callback(uint8_t start_code, const uint8_t * data, uint16_t size, void * arg);
+
+        void signalFrame(uint32_t seq);                     // wakes up the tasks waiting for a frame
+        void waitRxIdle();                                  // returns once the receive task and the interrupt are out of what they were handling
+
+        void createTask(TaskFunction_t function, const char * name, uint32_t stack_size);
+
+        bool isrMode() const { return config.rx_isr && (direction == DMX_DIR_INPUT); }
+
+        void rxLoop();                                      // body of the event task
+        void rxIsrLoop();                                   // body of the receive task in interrupt receive mode
+        void rxInterrupt();                                 // decodes the uart fifo into the receiver
+        void txLoop();                                      // body of the transmit task
+
+        void drainRx(uint8_t * buffer, uint32_t now_us);    // feeds everything buffered by the uart driver to the receiver
+
+};
+
+// prints a diagnostic on the log of the library (see DMX::SetLog)
+#define DMX_LOG(...)    do { Print * dmx_log = DMX::GetLog(); if(dmx_log != nullptr) dmx_log->printf(__VA_ARGS__); } while(0)
+
+// Universe with its memory inside the object: frames for up to Slots channels, task stack
+// and FreeRTOS objects, none of them is allocated on the heap and a window change never allocates.
+// Inputs use the interrupt receive mode (no uart driver), only the interrupt handle of
+// esp_intr_alloc (and the DMX_ALT_RING packets of an alternate start code callback) comes from the heap. Outputs install a uart driver without tx ring, which still
+// allocates its smallest rx ring, its event queue and its own objects. A global instance lives in .bss:
+//
+//   DMXUniverse<DMX_DIR_INPUT, 64> dmx;                 // listens to up to 64 channels
+//   dmx.Initialize(101, 64);
+template<DMXDirection Direction, uint16_t Slots = 512>
+class DMXUniverse : public DMX
+{
+    public:
+        DMXUniverse(const DMXConfig & config = DMXConfig()) :
+            DMX(universeConfig(config), universeStorage(frames, stack, &tcb, &mutex, &events))
+        {
+        }
+
+        void Initialize(uint16_t StartAddr = 1, uint16_t NbChannels = Slots) { DMX::Initialize(Direction, StartAddr, NbChannels); }
+
+        size_t GetFootprint() const { return DMX::GetFootprint() - sizeof(DMX) + sizeof(*this); }
+
+    private:
+        static const uint32_t STACK_SIZE = (Direction == DMX_DIR_OUTPUT) ? DMX_TX_STACK_SIZE : DMX_RX_STACK_SIZE;
 
-        static void uart_event_task(void *pvParameters);    // event task
+        alignas(4) uint8_t frames[DMX::FramesSize(Direction, Slots)];
+        StackType_t stack[STACK_SIZE / sizeof(StackType_t)];
+        StaticTask_t tcb;
+        StaticSemaphore_t mutex;
+        StaticEventGroup_t events;
 
-        static void uart_send_task(void*pvParameters);      // transmit task
+        static DMXConfig universeConfig(DMXConfig config)
+        {
+            config.rx_isr = true;
+            return config;
+        }
 
-        static void createBuffer(bool TmpBufferCreate=false);    // Manage the allocation/reallocation of buffer
+        static DMXStorage universeStorage(uint8_t * frames, StackType_t * stack, StaticTask_t * tcb,
+                                          StaticSemaphore_t * mutex, StaticEventGroup_t * events)
+        {
+            DMXStorage storage;
+            storage.slots = Slots;
+            storage.frames = frames;
+            storage.stack = stack;
+            storage.task = tcb;
+            storage.mutex = mutex;
+            storage.events = events;
+            return storage;
+        }
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,289 @@
+/*
+ * This file is part of the ESP32-DMX distribution (https://github.com/luksal/ESP32-DMX).
+ * Copyright (c) 2021 Lukas Salomon.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+#include "lwip/sockets.h"
+#include "esp_timer.h"
+#include "dmx_bridge.h"
+
+// E1.31 data packet layout (offsets in bytes)
+#define SACN_ACN_ID             4           // "ASC-E1.17\0\0\0"
+#define SACN_ROOT_VECTOR        18          // VECTOR_ROOT_E131_DATA (4)
+#define SACN_FRAMING_VECTOR     40          // VECTOR_E131_DATA_PACKET (2)
+#define SACN_SEQUENCE           111
+#define SACN_OPTIONS            112         // bit 6: stream terminated, bit 7: preview
+#define SACN_UNIVERSE           113
+#define SACN_DMP_VECTOR         117         // VECTOR_DMP_SET_PROPERTY (2)
+#define SACN_VALUE_COUNT        123         // start code + slots
+#define SACN_START_CODE         125
+#define SACN_HEADER_SIZE        126
+
+#define SACN_OPT_PREVIEW        0x80
+#define SACN_OPT_TERMINATED     0x40
+
+// ArtDmx packet layout
+#define ARTNET_OPCODE           8           // 0x5000, little endian
+#define ARTNET_SEQUENCE         12          // 0 disables the sequence check
+#define ARTNET_SUBUNI           14
+#define ARTNET_NET              15
+#define ARTNET_LENGTH           16          // big endian
+#define ARTNET_HEADER_SIZE      18
+
+#define ARTNET_OP_DMX           0x5000
+
+static const uint8_t SACN_ID[12] = { 'A', 'S', 'C', '-', 'E', '1', '.', '1', '7', 0, 0, 0 };
+static const uint8_t ARTNET_ID[8] = { 'A', 'r', 't', '-', 'N', 'e', 't', 0 };
+
+DMXNetBridge::DMXNetBridge(DMX & output) :
+    output(output),
+    protocol(DMX_NET_SACN),
+    universe(1),
+    sock(-1),
+    packet(nullptr),
+    task(NULL),
+    running(false),
+    has_sequence(false),
+    last_sequence(0),
+    last_packet_us(0)
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+DMXNetBridge::~DMXNetBridge()
+{
+    End();
+}
+
+bool DMXNetBridge::Begin(DMXNetProtocol protocol, uint16_t universe, UBaseType_t priority, BaseType_t core)
+{
+    End();
+
+    this->protocol = protocol;
+    this->universe = universe;
+    has_sequence = false;
+
+    packet = (uint8_t *) malloc(DMX_NET_MAX_PACKET);
+    if(packet == nullptr) {
+        DMX_LOG("DMXNetBridge::Begin : Error when allocating the packet buffer!\n");
+        return false;
+    }
+
+    sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if(sock < 0) {
+        DMX_LOG("DMXNetBridge::Begin : Error when creating the udp socket!\n");
+        End();
+        return false;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((protocol == DMX_NET_SACN) ? DMX_SACN_PORT : DMX_ARTNET_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if(bind(sock, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        DMX_LOG("DMXNetBridge::Begin : Error when binding the udp port!\n");
+        End();
+        return false;
+    }
+
+    // the task checks running between two packets or after DMX_NET_POLL_MS of silence
+    struct timeval poll;
+    poll.tv_sec = 0;
+    poll.tv_usec = DMX_NET_POLL_MS * 1000;
+    if(setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &poll, sizeof(poll)) < 0) {
+        DMX_LOG("DMXNetBridge::Begin : Error when setting the receive timeout!\n");
+        End();
+        return false;
+    }
+
+    if(protocol == DMX_NET_SACN) {
+        // sACN universes are sent to 239.255.<universe high>.<universe low>
+        struct ip_mreq group;
+        memset(&group, 0, sizeof(group));
+        group.imr_multiaddr.s_addr = htonl(0xEFFF0000UL | universe);
+        group.imr_interface.s_addr = htonl(INADDR_ANY);
+        if(setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &group, sizeof(group)) < 0) {
+            DMX_LOG("DMXNetBridge::Begin : Error when joining the multicast group of universe %d!\n", universe);
+        }
+    }
+
+    running = true;
+    TaskHandle_t handle;
+    if(xTaskCreatePinnedToCore(DMXNetBridge::bridge_task, "dmx_bridge_task", 3072, this, priority, &handle, core) != pdPASS) {
+        DMX_LOG("DMXNetBridge::Begin : Error when creating the bridge task!\n");
+        running = false;
+        End();
+        return false;
+    }
+    task = handle;
+
+    return true;
+}
+
+void DMXNetBridge::End()
+{
+    // the task may hold the mutex of the output: it leaves by itself between two packets
+    running = false;
+    while(task != NULL) {
+        vTaskDelay(1);
+    }
+
+    if(sock >= 0) {
+        closesocket(sock);
+        sock = -1;
+    }
+
+    free(packet);
+    packet = nullptr;
+}
+
+void DMXNetBridge::bridge_task(void * pvParameters)
+{
+    DMXNetBridge * bridge = static_cast<DMXNetBridge *>(pvParameters);
+
+    while(bridge->running)
+    {
+        // wait for the next packet, the task sleeps meanwhile
+        int len = recvfrom(bridge->sock, bridge->packet, DMX_NET_MAX_PACKET, 0, NULL, NULL);
+        if(len <= 0) {
+            vTaskDelay(1);
+            continue;
+        }
+
+        bridge->HandlePacket(bridge->packet, len, (uint32_t) esp_timer_get_time());
+    }
+
+    bridge->task = NULL;
+    vTaskDelete(NULL);
+}
+
+bool DMXNetBridge::HandlePacket(const uint8_t * packet, size_t size, uint32_t now_us)
+{
+    stats.packets++;
+
+    if(protocol == DMX_NET_SACN) {
+        return parseSACN(packet, size, now_us);
+    }
+    return parseArtNet(packet, size, now_us);
+}
+
+//*****************************************************************************
+//** Sequence check (E1.31 6.7.2), a forgotten source restarts the sequence  **
+//*****************************************************************************
+bool DMXNetBridge::acceptSequence(uint8_t sequence, uint32_t now_us)
+{
+    if(has_sequence && (now_us - last_packet_us < DMX_NET_SOURCE_TIMEOUT * 1000UL)) {
+        int8_t diff = (int8_t) (sequence - last_sequence);
+        if((diff <= 0) && (diff > -20)) {
+            stats.out_of_order++;
+            return false;
+        }
+    }
+
+    has_sequence = true;
+    last_sequence = sequence;
+    last_packet_us = now_us;
+    return true;
+}
+
+bool DMXNetBridge::commit(const uint8_t * slots, uint16_t count, uint32_t now_us)
+{
+    // the slots beyond the frame of the output are dropped, a smaller output sends the first ones
+    uint16_t nb = output.GetDmxNbChannels();
+    if(count > nb) count = nb;
+    if(count == 0) return false;
+
+    // one copy from the udp buffer into the output frame, sent as a whole
+    output.WriteFrame(slots, 1, count, now_us);
+
+    stats.frames++;
+    return true;
+}
+
+bool DMXNetBridge::parseSACN(const uint8_t * packet, size_t size, uint32_t now_us)
+{
+    if((size < SACN_HEADER_SIZE) ||
+       (memcmp(packet + SACN_ACN_ID, SACN_ID, sizeof(SACN_ID)) != 0) ||
+       (packet[SACN_ROOT_VECTOR + 3] != 0x04) ||
+       (packet[SACN_FRAMING_VECTOR + 3] != 0x02) ||
+       (packet[SACN_DMP_VECTOR] != 0x02)) {
+        stats.invalid++;
+        return false;
+    }
+
+    uint16_t packet_universe = (packet[SACN_UNIVERSE] << 8) | packet[SACN_UNIVERSE + 1];
+    if(packet_universe != universe) {
+        stats.other_universe++;
+        return false;
+    }
+
+    uint8_t options = packet[SACN_OPTIONS];
+    if(options & SACN_OPT_TERMINATED) {
+        // the source stops, the next one starts a new sequence
+        stats.terminated++;
+        has_sequence = false;
+        return false;
+    }
+    if(options & SACN_OPT_PREVIEW) {
+        return false;
+    }
+
+    // only NULL start code data is sent to the output
+    uint16_t count = (packet[SACN_VALUE_COUNT] << 8) | packet[SACN_VALUE_COUNT + 1];
+    if((count < 1) || ((size_t) (SACN_START_CODE + count) > size) || (packet[SACN_START_CODE] != 0)) {
+        stats.invalid++;
+        return false;
+    }
+
+    if(!acceptSequence(packet[SACN_SEQUENCE], now_us)) {
+        return false;
+    }
+
+    return commit(packet + SACN_START_CODE + 1, count - 1, now_us);
+}
+
+bool DMXNetBridge::parseArtNet(const uint8_t * packet, size_t size, uint32_t now_us)
+{
+    if((size < ARTNET_HEADER_SIZE) ||
+       (memcmp(packet, ARTNET_ID, sizeof(ARTNET_ID)) != 0) ||
+       ((packet[ARTNET_OPCODE] | (packet[ARTNET_OPCODE + 1] << 8)) != ARTNET_OP_DMX)) {
+        stats.invalid++;
+        return false;
+    }
+
+    // 15 bits port address: net (7 bits), sub-net and universe (8 bits)
+    uint16_t packet_universe = ((packet[ARTNET_NET] & 0x7F) << 8) | packet[ARTNET_SUBUNI];
+    if(packet_universe != universe) {
+        stats.other_universe++;
+        return false;
+    }
+
+    uint16_t count = (packet[ARTNET_LENGTH] << 8) | packet[ARTNET_LENGTH + 1];
+    if((size_t) (ARTNET_HEADER_SIZE + count) > size) {
+        stats.invalid++;
+        return false;
+    }
+
+    // sequence 0 means no sequence check
+    uint8_t sequence = packet[ARTNET_SEQUENCE];
+    if((sequence != 0) && !acceptSequence(sequence, now_us)) {
+        return false;
+    }
+
+    return commit(packet + ARTNET_HEADER_SIZE, count, now_us);
+}
@@ -0,0 +1,95 @@
+/*
+ * This file is part of the ESP32-DMX distribution (https://github.com/luksal/ESP32-DMX).
+ * Copyright (c) 2021 Lukas Salomon.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "dmx.h"
+
+#ifndef DMX_BRIDGE_h
+#define DMX_BRIDGE_h
+
+#define DMX_SACN_PORT           5568        // E1.31 udp port
+#define DMX_ARTNET_PORT         6454        // Art-Net udp port
+
+#define DMX_NET_MAX_PACKET      638         // largest sACN data packet (Art-Net is 530)
+#define DMX_NET_SOURCE_TIMEOUT  2500        // ms without packet before the sequence of a source is forgotten (E1.31)
+#define DMX_NET_POLL_MS         100         // longest wait of the bridge task in recvfrom, End() takes at most that long
+
+enum DMXNetProtocol { DMX_NET_SACN, DMX_NET_ARTNET };
+
+// Counters of the bridge, written by the bridge task
+struct DMXNetStats
+{
+    uint32_t packets;                                       // udp packets received
+    uint32_t frames;                                        // frames committed to the output
+    uint32_t invalid;                                       // not a sACN / ArtDmx data packet
+    uint32_t other_universe;                                // data for another universe
+    uint32_t out_of_order;                                  // late or duplicated sequence number, discarded
+    uint32_t terminated;                                    // sACN stream terminated packets
+};
+
+// Receives one sACN (E1.31) or Art-Net universe over udp and writes its
+// slots straight into the output frame of a DMX instance, one frame commit
+// per packet: the slots are copied once from the udp buffer, the ones out of
+// the packet are carried over from the previous frame. The latency from packet arrival to first slot on the wire is
+// available from the output with DMX::GetTxLatency().
+class DMXNetBridge
+{
+    public:
+        DMXNetBridge(DMX & output);
+        ~DMXNetBridge();
+
+        // opens the udp socket (joins the sACN multicast group) and starts the bridge task
+        bool Begin(DMXNetProtocol protocol, uint16_t universe,
+                   UBaseType_t priority = 2, BaseType_t core = tskNO_AFFINITY);
+        void End();
+
+        // parses one udp payload received at now_us, returns true when a frame was committed
+        bool HandlePacket(const uint8_t * packet, size_t size, uint32_t now_us);
+
+        const DMXNetStats & GetStats() const { return stats; }
+
+    private:
+        DMXNetBridge(const DMXNetBridge &);
+        DMXNetBridge & operator=(const DMXNetBridge &);
+
+        DMX & output;
+        DMXNetProtocol protocol;
+        uint16_t universe;
+
+        int sock;
+        uint8_t * packet;                                   // udp receive buffer (DMX_NET_MAX_PACKET bytes)
+        TaskHandle_t volatile task;                         // cleared by the bridge task when it leaves
+        volatile bool running;                              // false asks the bridge task to leave
+
+        bool has_sequence;                                  // a sequence number was received from the source
+        uint8_t last_sequence;
+        uint32_t last_packet_us;
+
+        DMXNetStats stats;
+
+        bool acceptSequence(uint8_t sequence, uint32_t now_us);
+        bool commit(const uint8_t * slots, uint16_t count, uint32_t now_us);
+
+        bool parseSACN(const uint8_t * packet, size_t size, uint32_t now_us);
+        bool parseArtNet(const uint8_t * packet, size_t size, uint32_t now_us);
+
+        static void bridge_task(void * pvParameters);       // udp receive task, pvParameters is the bridge
+};
+
+#endif
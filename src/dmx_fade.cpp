@@ -0,0 +1,285 @@
+/*
+ * This file is part of the ESP32-DMX distribution (https://github.com/luksal/ESP32-DMX).
+ * Copyright (c) 2021 Lukas Salomon.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+#include "esp_timer.h"
+#include "dmx_fade.h"
+
+#define DMX_FADE_ONE            32768       // progress of a finished fade (Q15)
+#define DMX_FADE_MAX_MS         3600000     // longest fade, the times are 32 bits microseconds
+
+DMXFader::DMXFader() :
+    output(nullptr),
+    sync_fade(NULL)
+{
+    memset(from, 0, sizeof(from));
+    memset(to, 0, sizeof(to));
+    memset(start_us, 0, sizeof(start_us));
+    memset(rate, 0, sizeof(rate));
+    memset(progress, 0, sizeof(progress));
+    memset(value, 0, sizeof(value));
+    memset(mode, DMX_FADE_NONE, sizeof(mode));
+    memset(level, 0, sizeof(level));
+    memset(shown, 0, sizeof(shown));
+}
+
+DMXFader::~DMXFader()
+{
+    // the send task is done with Render once End returns
+    End();
+    if(sync_fade != NULL) {
+        vSemaphoreDelete(sync_fade);
+    }
+}
+
+bool DMXFader::Begin(DMX & output)
+{
+    End();
+
+    if(sync_fade == NULL) {
+        sync_fade = xSemaphoreCreateMutex();
+        if(sync_fade == NULL) {
+            DMX_LOG("DMXFader::Begin : Error when creating the mutex!\n");
+            return false;
+        }
+    }
+
+    this->output = &output;
+    output.SetTxCallback(DMXFader::tx_callback, this);
+    return true;
+}
+
+void DMXFader::End()
+{
+    if(output != nullptr) {
+        output->SetTxCallback(nullptr);
+        output = nullptr;
+    }
+}
+
+void DMXFader::tx_callback(uint8_t * frame, uint16_t nb, uint32_t now_us, void * arg)
+{
+    static_cast<DMXFader *>(arg)->Render(frame, nb, now_us);
+}
+
+//*****************************************************************************
+//** Fades set by the application, under sync_fade                           **
+//*****************************************************************************
+void DMXFader::Fade(uint16_t channel, uint8_t target, uint32_t ms)
+{
+    if(channel < 1 || channel > 512) return;
+
+    uint32_t now = (uint32_t) esp_timer_get_time();
+    xSemaphoreTake(sync_fade, portMAX_DELAY);
+    uint16_t start = current(channel, now);
+    own(channel, DMX_FADE_8BIT);
+    set(channel, start, target * 257, now, ms);
+    xSemaphoreGive(sync_fade);
+}
+
+void DMXFader::Fade16(uint16_t channel, uint16_t target, uint32_t ms)
+{
+    if(channel < 1 || channel > 511) return;
+
+    uint32_t now = (uint32_t) esp_timer_get_time();
+    xSemaphoreTake(sync_fade, portMAX_DELAY);
+    uint16_t start = current(channel, now);
+    own(channel, DMX_FADE_COARSE);
+    set(channel, start, target, now, ms);
+    xSemaphoreGive(sync_fade);
+}
+
+void DMXFader::FadeTo(const uint8_t * scene, uint16_t start, uint16_t size, uint32_t ms)
+{
+    if(start < 1 || start > 512 || start + size > 513) return;
+
+    // all the channels share the same start time
+    uint32_t now = (uint32_t) esp_timer_get_time();
+    xSemaphoreTake(sync_fade, portMAX_DELAY);
+    for(uint16_t i = 0; i < size; i++)
+    {
+        uint16_t channel = start + i;
+        uint16_t value = current(channel, now);
+        own(channel, DMX_FADE_8BIT);
+        set(channel, value, scene[i] * 257, now, ms);
+    }
+    xSemaphoreGive(sync_fade);
+}
+
+void DMXFader::Crossfade(const uint8_t * from, const uint8_t * to, uint16_t start, uint16_t size, uint32_t ms)
+{
+    if(start < 1 || start > 512 || start + size > 513) return;
+
+    uint32_t now = (uint32_t) esp_timer_get_time();
+    xSemaphoreTake(sync_fade, portMAX_DELAY);
+    for(uint16_t i = 0; i < size; i++)
+    {
+        own(start + i, DMX_FADE_8BIT);
+        set(start + i, from[i] * 257, to[i] * 257, now, ms);
+    }
+    xSemaphoreGive(sync_fade);
+}
+
+void DMXFader::Release(uint16_t start, uint16_t size)
+{
+    if(start < 1 || start > 512 || start + size > 513) return;
+
+    xSemaphoreTake(sync_fade, portMAX_DELAY);
+    for(uint16_t i = 0; i < size; i++)
+    {
+        own(start + i, DMX_FADE_NONE);
+    }
+    xSemaphoreGive(sync_fade);
+}
+
+bool DMXFader::IsFading()
+{
+    bool fading = false;
+    xSemaphoreTake(sync_fade, portMAX_DELAY);
+    for(uint16_t i = 1; i < DMX_FADE_CHANNELS; i++)
+    {
+        if(rate[i] != 0) {
+            fading = true;
+            break;
+        }
+    }
+    xSemaphoreGive(sync_fade);
+    return fading;
+}
+
+uint8_t DMXFader::Get(uint16_t channel)
+{
+    if(channel < 1 || channel > 512) return 0;
+    return level[channel];
+}
+
+// 16 bits value of the channel at now_us, where a new fade starts from
+uint16_t DMXFader::current(uint16_t channel, uint32_t now_us)
+{
+    switch(mode[channel])
+    {
+        case DMX_FADE_NONE:
+            return (output != nullptr) ? output->Read(channel) * 257 : 0;
+        case DMX_FADE_FINE:
+            return level[channel] * 257;
+        default:
+            break;
+    }
+
+    if(rate[channel] == 0) return to[channel];
+
+    uint64_t p = ((uint64_t) (now_us - start_us[channel]) * rate[channel]) >> 17;
+    if(p > DMX_FADE_ONE) p = DMX_FADE_ONE;
+    return from[channel] + (((int32_t) (to[channel] - from[channel]) * (int32_t) p) >> 15);
+}
+
+void DMXFader::set(uint16_t channel, uint16_t start, uint16_t target, uint32_t now_us, uint32_t ms)
+{
+    if(ms > DMX_FADE_MAX_MS) ms = DMX_FADE_MAX_MS;
+
+    to[channel] = target;
+    start_us[channel] = now_us;
+    if(ms == 0) {
+        // immediate, applied on the next frame
+        from[channel] = target;
+        rate[channel] = 0;
+        return;
+    }
+
+    // rounded up, the fade never ends after its time
+    uint32_t duration = ms * 1000UL;
+    uint64_t r = (((uint64_t) 1 << 32) + duration - 1) / duration;
+    from[channel] = start;
+    rate[channel] = (r > 0xFFFFFFFFUL) ? 0xFFFFFFFFUL : (r == 0) ? 1 : (uint32_t) r;
+}
+
+// gives the channel to the fader (or back to the writers), a 16 bits pair is split when one of its channels changes
+void DMXFader::own(uint16_t channel, DMXFadeMode channel_mode)
+{
+    if(mode[channel] == DMX_FADE_FINE) {
+        mode[channel - 1] = DMX_FADE_8BIT;
+    }
+    if((mode[channel] == DMX_FADE_COARSE) && (channel_mode != DMX_FADE_COARSE)) {
+        mode[channel + 1] = DMX_FADE_NONE;
+    }
+
+    mode[channel] = channel_mode;
+    if(channel_mode == DMX_FADE_NONE) {
+        rate[channel] = 0;
+    }
+
+    if(channel_mode == DMX_FADE_COARSE) {
+        if(mode[channel + 1] == DMX_FADE_COARSE) {
+            mode[channel + 2] = DMX_FADE_NONE;
+        }
+        mode[channel + 1] = DMX_FADE_FINE;
+        from[channel + 1] = to[channel + 1] = 0;
+        rate[channel + 1] = 0;
+    }
+}
+
+//*****************************************************************************
+//** Frame rendering, once per frame from the send task                      **
+//*****************************************************************************
+void DMXFader::Render(uint8_t * frame, uint16_t nb, uint32_t now_us)
+{
+    uint16_t i;
+
+    if(nb > 512) nb = 512;
+
+    // never wait for the application: a busy writer gets the previous frame again
+    if(xSemaphoreTake(sync_fade, 0) == pdTRUE)
+    {
+        // progress of each fade (Q15), the finished ones stay on their target
+        for(i = 1; i < DMX_FADE_CHANNELS; i++)
+        {
+            uint64_t p = ((uint64_t) (now_us - start_us[i]) * rate[i]) >> 17;
+            if(p >= DMX_FADE_ONE) {
+                p = DMX_FADE_ONE;
+                from[i] = to[i];
+                rate[i] = 0;
+            }
+            progress[i] = (uint16_t) p;
+        }
+
+        // interpolation of all the channels, no branch, unrolled by the compiler
+        for(i = 1; i < DMX_FADE_CHANNELS; i++)
+        {
+            value[i] = from[i] + (((int32_t) (to[i] - from[i]) * (int32_t) progress[i]) >> 15);
+        }
+
+        // 16 bits values to slots
+        for(i = 1; i < DMX_FADE_CHANNELS; i++)
+        {
+            if(mode[i] == DMX_FADE_COARSE) {
+                level[i] = value[i] >> 8;
+                level[i + 1] = value[i] & 0xFF;
+            } else if(mode[i] == DMX_FADE_8BIT) {
+                level[i] = value[i] >> 8;
+            }
+            shown[i] = (mode[i] != DMX_FADE_NONE) ? 0xFF : 0;
+        }
+
+        xSemaphoreGive(sync_fade);
+    }
+
+    // the channels of the last rendered frame, even when the writers held the lock: only a render changes them
+    for(i = 1; i <= nb; i++)
+    {
+        frame[i] = (frame[i] & ~shown[i]) | (level[i] & shown[i]);
+    }
+}
@@ -0,0 +1,91 @@
+/*
+ * This file is part of the ESP32-DMX distribution (https://github.com/luksal/ESP32-DMX).
+ * Copyright (c) 2021 Lukas Salomon.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "dmx.h"
+
+#ifndef DMX_FADE_h
+#define DMX_FADE_h
+
+#define DMX_FADE_CHANNELS       513         // indexed like the frame, 0 (start code) is never faded
+
+enum DMXFadeMode { DMX_FADE_NONE, DMX_FADE_8BIT, DMX_FADE_COARSE, DMX_FADE_FINE };
+
+// Fades the channels of a DMX output at the frame rate of the send task.
+//
+// Each faded channel holds a start value, a target, a start time and a rate,
+// all values are 16 bits (an 8 bit value v is v * 257). Once per frame the
+// send task computes the progress of every fade (Q15) and interpolates all
+// the channels with one branch free pass over the arrays, then writes them
+// into the frame being sent: 8 bit channels get the upper byte, 16 bit
+// channels the upper byte on the coarse channel and the lower one on the
+// fine channel that follows. The application only gives targets and times.
+// The output hands the fader a copy of each frame, so the written values
+// come back as soon as a channel is released.
+class DMXFader
+{
+    public:
+        DMXFader();
+        ~DMXFader();
+
+        bool Begin(DMX & output);                           // renders the fades into every frame sent by output
+        void End();
+
+        void Fade(uint16_t channel, uint8_t target, uint32_t ms);      // 8 bit channel from its current value
+        void Fade16(uint16_t channel, uint16_t target, uint32_t ms);   // coarse on channel, fine on channel + 1
+
+        // fades size channels from start towards scene (8 bit channels), all of them in ms
+        void FadeTo(const uint8_t * scene, uint16_t start, uint16_t size, uint32_t ms);
+
+        // crossfade of size channels from start, from scene from to scene to, in ms
+        void Crossfade(const uint8_t * from, const uint8_t * to, uint16_t start, uint16_t size, uint32_t ms);
+
+        void Release(uint16_t start, uint16_t size);        // the channels are sent from the written values again
+
+        bool IsFading();                                    // a fade is still running
+        uint8_t Get(uint16_t channel);                      // value of the channel in the last frame rendered
+
+        // interpolates the fades at now_us into frame[1..nb], called by the send task (public for other outputs)
+        void Render(uint8_t * frame, uint16_t nb, uint32_t now_us);
+
+    private:
+        DMXFader(const DMXFader &);
+        DMXFader & operator=(const DMXFader &);
+
+        DMX * output;
+        SemaphoreHandle_t sync_fade;                        // writers against the send task
+
+        uint16_t from[DMX_FADE_CHANNELS];                   // 16 bits start value
+        uint16_t to[DMX_FADE_CHANNELS];                     // 16 bits target
+        uint32_t start_us[DMX_FADE_CHANNELS];
+        uint32_t rate[DMX_FADE_CHANNELS];                   // progress per us (2^32 / duration), 0 when done
+        uint16_t progress[DMX_FADE_CHANNELS];               // Q15 progress of the frame being rendered
+        uint16_t value[DMX_FADE_CHANNELS];                  // 16 bits value of the frame being rendered
+        uint8_t mode[DMX_FADE_CHANNELS];                    // DMXFadeMode of each channel
+        uint8_t level[DMX_FADE_CHANNELS];                   // last rendered slots
+        uint8_t shown[DMX_FADE_CHANNELS];                   // 0xFF for the channels of the last rendered frame
+
+        uint16_t current(uint16_t channel, uint32_t now_us);
+        void set(uint16_t channel, uint16_t start, uint16_t target, uint32_t now_us, uint32_t ms);
+        void own(uint16_t channel, DMXFadeMode channel_mode);
+
+        static void tx_callback(uint8_t * frame, uint16_t nb, uint32_t now_us, void * arg);
+};
+
+#endif
@@ -0,0 +1,152 @@
+/*
+ * This file is part of the ESP32-DMX distribution (https://github.com/luksal/ESP32-DMX).
+ * Copyright (c) 2021 Lukas Salomon.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+
+#include "dmx.h"
+
+#ifndef DMX_FIXTURE_h
+#define DMX_FIXTURE_h
+
+// Fixture profiles declared at compile time.
+//
+// A profile maps the channels of a fixture (offsets from its start address)
+// to the members of a plain struct:
+//
+//   struct Spot { uint16_t pan; uint16_t tilt; uint8_t dimmer; DMXRGB color; };
+//
+//   typedef DMXFixture<Spot,
+//       DMXAttr16<Spot, 0, &Spot::pan>,                    // channels 1-2, coarse / fine
+//       DMXAttr16<Spot, 2, &Spot::tilt>,                   // channels 3-4
+//       DMXAttr8<Spot, 4, &Spot::dimmer>,                  // channel 5
+//       DMXAttrRGB<Spot, 5, &Spot::color> > SpotProfile;   // channels 6-8
+//
+//   Spot spot;
+//   SpotProfile::Read(dmx, 101, spot);
+//
+// Read() takes one ReadAll() snapshot of the fixture footprint, offsets and
+// sizes are template arguments so the decoding is expanded by the compiler
+// into plain loads and stores, without any table at run time.
+
+struct DMXRGB
+{
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+};
+
+// 8 bit attribute at Offset
+template<typename T, uint16_t Offset, uint8_t T::*Member>
+struct DMXAttr8
+{
+    static const uint16_t end = Offset + 1;
+    static void Decode(const uint8_t * data, T & fixture) { fixture.*Member = data[Offset]; }
+    static void Encode(uint8_t * data, const T & fixture) { data[Offset] = fixture.*Member; }
+};
+
+// 16 bit attribute, coarse at Offset and fine at Offset + 1
+template<typename T, uint16_t Offset, uint16_t T::*Member>
+struct DMXAttr16
+{
+    static const uint16_t end = Offset + 2;
+    static void Decode(const uint8_t * data, T & fixture) { fixture.*Member = (data[Offset] << 8) | data[Offset + 1]; }
+    static void Encode(uint8_t * data, const T & fixture)
+    {
+        data[Offset] = (fixture.*Member) >> 8;
+        data[Offset + 1] = (fixture.*Member) & 0xFF;
+    }
+};
+
+// red, green and blue from Offset
+template<typename T, uint16_t Offset, DMXRGB T::*Member>
+struct DMXAttrRGB
+{
+    static const uint16_t end = Offset + 3;
+    static void Decode(const uint8_t * data, T & fixture)
+    {
+        (fixture.*Member).r = data[Offset];
+        (fixture.*Member).g = data[Offset + 1];
+        (fixture.*Member).b = data[Offset + 2];
+    }
+    static void Encode(uint8_t * data, const T & fixture)
+    {
+        data[Offset] = (fixture.*Member).r;
+        data[Offset + 1] = (fixture.*Member).g;
+        data[Offset + 2] = (fixture.*Member).b;
+    }
+};
+
+template<typename T, typename... Attrs>
+struct DMXFixture;
+
+template<typename T>
+struct DMXFixture<T>
+{
+    static const uint16_t footprint = 0;
+    static void Decode(const uint8_t *, T &) {}
+    static void Encode(uint8_t *, const T &) {}
+};
+
+template<typename T, typename Attr, typename... Attrs>
+struct DMXFixture<T, Attr, Attrs...>
+{
+    typedef DMXFixture<T, Attrs...> Next;
+
+    // channels used by the fixture
+    static const uint16_t footprint = (Attr::end > Next::footprint) ? Attr::end : Next::footprint;
+
+    // data[0] is the first channel of the fixture
+    static void Decode(const uint8_t * data, T & fixture)
+    {
+        Attr::Decode(data, fixture);
+        Next::Decode(data, fixture);
+    }
+
+    static void Encode(uint8_t * data, const T & fixture)
+    {
+        Attr::Encode(data, fixture);
+        Next::Encode(data, fixture);
+    }
+
+    // decodes the fixture patched at address from one snapshot of the received frame, false (fixture
+    // untouched) when its channels are not all in the listened window
+    static bool Read(DMX & dmx, uint16_t address, T & fixture)
+    {
+        uint8_t data[footprint];
+        uint16_t first = dmx.GetDmxStartAdress();
+        if(address < first || address + footprint > 513) return false;
+
+        // the read buffer starts at the window
+        if(!dmx.ReadAll(data, address - first + 1, footprint)) return false;
+        Decode(data, fixture);
+        return true;
+    }
+
+    // writes all the channels of the fixture patched at address with one WriteAll, the unused ones are set to 0
+    static bool Write(DMX & dmx, uint16_t address, const T & fixture)
+    {
+        uint8_t data[footprint];
+        if(address < 1 || address + footprint > 513) return false;
+
+        memset(data, 0, footprint);
+        Encode(data, fixture);
+        dmx.WriteAll(data, address, footprint);
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,314 @@
+/*
+ * This file is part of the ESP32-DMX distribution (https://github.com/luksal/ESP32-DMX).
+ * Copyright (c) 2021 Lukas Salomon.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+
+#ifndef DMX_FRAME_h
+#define DMX_FRAME_h
+
+// three buffers of size bytes set to 0, allocated or taken from storage (3 * size bytes)
+static inline bool attachBuffers(uint8_t * buffers[3], uint16_t size, uint8_t * storage)
+{
+    if(storage != nullptr)
+    {
+        memset(storage, 0, 3 * size);
+        for(int i = 0; i < 3; i++) buffers[i] = storage + i * size;
+        return true;
+    }
+
+    for(int i = 0; i < 3; i++)
+    {
+        buffers[i] = (uint8_t *) calloc(size, sizeof(uint8_t));
+        if(buffers[i] == nullptr)
+        {
+            for(int j = 0; j < i; j++)
+            {
+                free(buffers[j]);
+                buffers[j] = nullptr;
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+static inline void detachBuffers(uint8_t * buffers[3], bool owned)
+{
+    for(int i = 0; i < 3; i++)
+    {
+        if(owned) free(buffers[i]);
+        buffers[i] = nullptr;
+    }
+}
+
+// Wait-free publication of DMX frames, one writer and any number of readers.
+//
+// Three buffers rotate: the published frame lives in one of them, the writer
+// fills the next one and the third holds the previous frame. A published
+// buffer is only refilled two publications later, so a reader whose copy
+// started and finished within fewer than two publications holds a consistent
+// snapshot. At DMX frame rates (one frame every ~23ms) a reader never has to
+// retry, neither side ever takes a lock.
+//
+// The published state is a single 32 bit word: frame sequence number in the
+// upper 30 bits, index of the published buffer in the lower 2 bits.
+class DMXFrameBuffer
+{
+    public:
+        static const uint32_t SEQ_MASK = 0x3FFFFFFF;        // sequence numbers wrap at 2^30
+
+        DMXFrameBuffer() : buffers{nullptr, nullptr, nullptr}, _size(0), owned(false), back_index(1), published(0) {}
+        ~DMXFrameBuffer() { End(); }
+
+        // three buffers of size bytes all set to 0, taken from storage (3 * size bytes) or allocated when nullptr
+        bool Begin(uint16_t size, uint8_t * storage = nullptr)
+        {
+            End();
+            if(!attachBuffers(buffers, size, storage)) return false;
+            _size = size;
+            owned = (storage == nullptr);
+            back_index = 1;
+            published.store(0, std::memory_order_release);
+            return true;
+        }
+
+        void End()
+        {
+            detachBuffers(buffers, owned);
+            _size = 0;
+        }
+
+        uint16_t Size() const { return _size; }
+
+        // writer side: buffer to fill before the next Publish()
+        uint8_t * Back() { return buffers[back_index]; }
+
+        // writer side: last published buffer (only stable for the writer)
+        const uint8_t * Front() const { return buffers[published.load(std::memory_order_relaxed) & 0x03]; }
+
+        // writer side: publishes the back buffer with a single atomic store, returns its sequence number
+        uint32_t Publish()
+        {
+            uint32_t state = published.load(std::memory_order_relaxed);
+            uint32_t seq = (state >> 2) + 1;
+            published.store((seq << 2) | back_index, std::memory_order_release);
+            // the new back buffer is the one published two frames ago, keep our
+            // next writes into it ordered after the publication
+            back_index = (back_index + 1) % 3;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            return seq & SEQ_MASK;
+        }
+
+        // number of frames published so far (wraps at 2^30)
+        uint32_t Sequence() const { return (published.load(std::memory_order_acquire) >> 2) & SEQ_MASK; }
+
+        // reader side: copies size bytes from offset of the last published frame, returns its sequence number
+        uint32_t Snapshot(uint8_t * data, uint16_t offset, uint16_t size) const
+        {
+            for(;;)
+            {
+                uint32_t state = published.load(std::memory_order_acquire);
+                memcpy(data, buffers[state & 0x03] + offset, size);
+                if(stable(state))
+                {
+                    return (state >> 2) & SEQ_MASK;
+                }
+            }
+        }
+
+        // reader side: single byte of the last published frame
+        uint8_t Get(uint16_t offset) const
+        {
+            for(;;)
+            {
+                uint32_t state = published.load(std::memory_order_acquire);
+                uint8_t value = buffers[state & 0x03][offset];
+                if(stable(state))
+                {
+                    return value;
+                }
+            }
+        }
+
+    private:
+        uint8_t * buffers[3];
+        uint16_t _size;
+        bool owned;                                         // buffers allocated by Begin()
+        uint8_t back_index;                                 // only touched by the writer
+        std::atomic<uint32_t> published;                    // seq << 2 | published buffer index
+
+        // true when the buffer read under state has not been reused by the writer in the meantime
+        bool stable(uint32_t state) const
+        {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint32_t now = published.load(std::memory_order_relaxed);
+            return (((now >> 2) - (state >> 2)) & SEQ_MASK) < 2;
+        }
+};
+
+// Tear-free hand over of output frames from the application to the send task.
+//
+// The application (one writer at a time) fills the back buffer and Commit()
+// exchanges it with the pending buffer in a single atomic operation. At the
+// start of each frame the send task takes the pending buffer as its front
+// buffer if a new one was committed, so it always transmits a complete,
+// stable frame and never shares a lock with the writers. The new back buffer
+// is brought up to date from the committed one on its first access only (the
+// send task never writes the buffers it sends), so a frame replaced as a
+// whole with Overwrite() is copied once instead of twice.
+class DMXTxBuffer
+{
+    public:
+        DMXTxBuffer() : buffers{nullptr, nullptr, nullptr}, stamps{0, 0, 0}, _size(0), owned(false), back_index(0), carry(NONE), front_index(2), pending(1), commits(0) {}
+        ~DMXTxBuffer() { End(); }
+
+        // three buffers of size bytes all set to 0, taken from storage (3 * size bytes) or allocated when nullptr
+        bool Begin(uint16_t size, uint8_t * storage = nullptr)
+        {
+            End();
+            if(!attachBuffers(buffers, size, storage)) return false;
+            _size = size;
+            owned = (storage == nullptr);
+            back_index = 0;
+            carry = NONE;
+            pending.store(1, std::memory_order_release);
+            front_index = 2;
+            return true;
+        }
+
+        void End()
+        {
+            detachBuffers(buffers, owned);
+            _size = 0;
+        }
+
+        uint16_t Size() const { return _size; }
+
+        // writer side: buffer written by the application, a copy of the last committed frame
+        uint8_t * Back() { return Overwrite(0, 0); }
+
+        // writer side: same for a writer replacing bytes [start, start + size) (within Size()) at once,
+        // only the other bytes are carried over from the last committed frame
+        uint8_t * Overwrite(uint16_t start, uint16_t size)
+        {
+            uint8_t * back = buffers[back_index];
+            if(carry != NONE) {
+                const uint8_t * last = buffers[carry];
+                memcpy(back, last, start);
+                memcpy(back + start + size, last + start + size, _size - start - size);
+                carry = NONE;
+            }
+            return back;
+        }
+
+        // writer side: hands the back buffer over to the send task, the new
+        // back buffer follows it so that writes stay incremental.
+        // stamp travels with the frame (e.g. the time its data arrived)
+        void Commit(uint32_t stamp = 0)
+        {
+            uint8_t committed = back_index;
+            Back();                                         // back buffer untouched since the last commit
+            stamps[committed] = stamp;
+            back_index = pending.exchange(committed | FRESH, std::memory_order_acq_rel) & INDEX;
+            carry = committed;
+            commits.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // sender side: takes the last committed buffer if any, returns the buffer to send
+        const uint8_t * Acquire(bool * fresh = nullptr)
+        {
+            bool taken = false;
+            if(pending.load(std::memory_order_acquire) & FRESH)
+            {
+                front_index = pending.exchange(front_index, std::memory_order_acq_rel) & INDEX;
+                taken = true;
+            }
+            if(fresh != nullptr) *fresh = taken;
+            return buffers[front_index];
+        }
+
+        // sender side: buffer taken by the last Acquire(), owned by the send task till the next one
+        uint8_t * Front() { return buffers[front_index]; }
+
+        // sender side: stamp given to Commit() for the buffer being sent
+        uint32_t FrontStamp() const { return stamps[front_index]; }
+
+        // number of frames committed so far
+        uint32_t Commits() const { return commits.load(std::memory_order_relaxed); }
+
+    private:
+        static const uint8_t INDEX = 0x03;
+        static const uint8_t FRESH = 0x04;
+        static const uint8_t NONE = 0x03;                   // no carry
+
+        uint8_t * buffers[3];
+        uint32_t stamps[3];
+        uint16_t _size;
+        bool owned;                                         // buffers allocated by Begin()
+        uint8_t back_index;                                 // only touched by the writer
+        uint8_t carry;                                      // committed buffer the back buffer still has to be copied from
+        uint8_t front_index;                                // only touched by the send task
+        std::atomic<uint8_t> pending;                       // pending buffer index | FRESH when not yet sent
+        std::atomic<uint32_t> commits;
+};
+
+// Callback and argument handed over as one to the task that runs them.
+//
+// Set() writes the pair into the spare of two slots and publishes it with a
+// single atomic store: the task sees the old pair or the new one, never the new
+// argument with the old callback. A slot is only written again by the second
+// Set() after it, so the owner makes sure in between that the task left the
+// callback it replaced, and serializes its setters with TryLock()/Unlock()
+// around Set() and that wait.
+template<typename Callback>
+class DMXCallbackPair
+{
+    public:
+        struct Pair
+        {
+            Callback callback;
+            void * arg;
+        };
+
+        DMXCallbackPair() : pairs{{nullptr, nullptr}, {nullptr, nullptr}}, current(&pairs[0]), locked(false) {}
+
+        // task side: the pair to call, valid till the owner has seen the task leave it
+        const Pair * Get() const { return current.load(); }
+        Callback GetCallback() const { return current.load()->callback; }
+
+        // setter side: one setter at a time, from TryLock() till Unlock()
+        bool TryLock() { return !locked.exchange(true, std::memory_order_acquire); }
+        void Unlock() { locked.store(false, std::memory_order_release); }
+
+        void Set(Callback callback, void * arg)
+        {
+            Pair * spare = (current.load(std::memory_order_relaxed) == &pairs[0]) ? &pairs[1] : &pairs[0];
+            spare->callback = callback;
+            spare->arg = arg;
+            current.store(spare);                           // sequentially consistent: ordered with the owner's wait
+        }
+
+    private:
+        Pair pairs[2];
+        std::atomic<Pair *> current;
+        std::atomic<bool> locked;
+};
+
+#endif
@@ -0,0 +1,208 @@
+/*
+ * This file is part of the ESP32-DMX distribution (https://github.com/luksal/ESP32-DMX).
+ * Copyright (c) 2021 Lukas Salomon.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+#include "esp_timer.h"
+#include "dmx_merge.h"
+
+DMXMerger::DMXMerger(DMX & input_a, DMX & input_b, DMX & output) :
+    input_a(input_a),
+    input_b(input_b),
+    output(output),
+    task(NULL),
+    running(false)
+{
+    memset(ltp, 0, sizeof(ltp));
+    memset(owner, 0, sizeof(owner));
+    memset(&stats, 0, sizeof(stats));
+}
+
+DMXMerger::~DMXMerger()
+{
+    End();
+}
+
+bool DMXMerger::Begin(UBaseType_t priority, BaseType_t core)
+{
+    End();
+
+    // the merge reads and the dirty bitmaps index the whole universe
+    if((input_a.GetDmxStartAdress() != 1) || (input_a.GetDmxNbChannels() != 512) ||
+       (input_b.GetDmxStartAdress() != 1) || (input_b.GetDmxNbChannels() != 512)) {
+        DMX_LOG("DMXMerger::Begin : Error, the inputs must listen to channels 1 to 512!\n");
+        return false;
+    }
+
+    // each published frame wakes the merge task up, the inputs must not be used by another merger or recorder
+    if(!input_a.SetFrameCallback(DMXMerger::frame_callback_a, this)) {
+        return false;
+    }
+    if(!input_b.SetFrameCallback(DMXMerger::frame_callback_b, this)) {
+        input_a.SetFrameCallback(nullptr);
+        return false;
+    }
+
+    running = true;
+    TaskHandle_t handle;
+    if(xTaskCreatePinnedToCore(DMXMerger::merge_task, "dmx_merge_task", 3072, this, priority, &handle, core) != pdPASS) {
+        DMX_LOG("DMXMerger::Begin : Error when creating the merge task!\n");
+        running = false;
+        input_a.SetFrameCallback(nullptr);
+        input_b.SetFrameCallback(nullptr);
+        return false;
+    }
+    task = handle;
+    return true;
+}
+
+void DMXMerger::End()
+{
+    if(!running) return;
+
+    // the receive tasks are out of onFrame once these return
+    input_a.SetFrameCallback(nullptr);
+    input_b.SetFrameCallback(nullptr);
+
+    // the task may hold the mutex of the output: it leaves by itself at its next wake up
+    running = false;
+    while(task != NULL) {
+        vTaskDelay(1);
+    }
+}
+
+void DMXMerger::SetPolicy(uint16_t start, uint16_t size, DMXMergePolicy policy)
+{
+    if(start < 1 || start > 512 || start + size > 513) return;
+
+    memset(ltp + start, (policy == DMX_MERGE_LTP) ? 0xFF : 0, size);
+}
+
+void DMXMerger::frame_callback_a(const uint8_t * frame, uint16_t start, uint16_t nb, const uint32_t * dirty, uint32_t seq, uint32_t now_us, void * arg)
+{
+    static_cast<DMXMerger *>(arg)->onFrame(0, nb, dirty);
+}
+
+void DMXMerger::frame_callback_b(const uint8_t * frame, uint16_t start, uint16_t nb, const uint32_t * dirty, uint32_t seq, uint32_t now_us, void * arg)
+{
+    static_cast<DMXMerger *>(arg)->onFrame(0xFF, nb, dirty);
+}
+
+// called by the receive task of an input: takes the LTP channels it changed and wakes the merge task up
+void DMXMerger::onFrame(uint8_t source, uint16_t nb, const uint32_t * dirty)
+{
+    for(uint16_t w = 0; w <= (nb >> 5); w++)
+    {
+        uint32_t bits = dirty[w];
+        while(bits != 0)
+        {
+            uint16_t ch = (w << 5) + __builtin_ctz(bits);
+            bits &= bits - 1;
+            if((ch >= 1) && (ch <= nb)) {
+                owner[ch] = source;
+            }
+        }
+    }
+
+    if(source == 0) {
+        stats.frames_a++;
+    } else {
+        stats.frames_b++;
+    }
+
+    TaskHandle_t merge = task;
+    if(merge != NULL) {
+        xTaskNotifyGive(merge);
+    }
+}
+
+//*****************************************************************************
+//** Merge kernel, no branch in the loop                                     **
+//*****************************************************************************
+void DMXMerger::Merge(uint8_t * out, const uint8_t * a, const uint8_t * b,
+                      const uint8_t * ltp, const uint8_t * owner, uint16_t n)
+{
+    for(uint16_t i = 0; i < n; i++)
+    {
+        uint8_t htp = (a[i] > b[i]) ? a[i] : b[i];
+        uint8_t latest = (owner[i] & b[i]) | (~owner[i] & a[i]);
+        out[i] = (ltp[i] & latest) | (~ltp[i] & htp);
+    }
+}
+
+void DMXMerger::merge_task(void * pvParameters)
+{
+    DMXMerger * merger = static_cast<DMXMerger *>(pvParameters);
+    merger->run();
+
+    merger->task = NULL;
+    vTaskDelete(NULL);
+}
+
+void DMXMerger::run()
+{
+    uint8_t a[512];
+    uint8_t b[512];
+    uint8_t out[512];
+    bool healthy_a = false;
+    bool healthy_b = false;
+    uint32_t seq_a = 0;
+    uint32_t seq_b = 0;
+
+    while(running)
+    {
+        // woken up by a new frame, or periodically to notice a lost source
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(DMX_MERGE_CHECK_MS));
+        if(!running) break;
+
+        bool ok_a = input_a.IsHealthy();
+        bool ok_b = input_b.IsHealthy();
+        if(healthy_a && !ok_a) stats.losses_a++;
+        if(healthy_b && !ok_b) stats.losses_b++;
+
+        uint32_t new_a = input_a.GetFrameSequence();
+        uint32_t new_b = input_b.GetFrameSequence();
+        bool changed = (new_a != seq_a) || (new_b != seq_b) || (ok_a != healthy_a) || (ok_b != healthy_b);
+        seq_a = new_a;
+        seq_b = new_b;
+        healthy_a = ok_a;
+        healthy_b = ok_b;
+
+        // nothing new, or both sources lost: the output holds the last look
+        if(!changed || (!ok_a && !ok_b)) continue;
+
+        if(ok_a && ok_b) {
+            input_a.ReadAll(a, 1, 512);
+            input_b.ReadAll(b, 1, 512);
+
+            uint32_t start = (uint32_t) esp_timer_get_time();
+            Merge(out, a, b, ltp + 1, owner + 1, 512);
+            stats.merge_us += (uint32_t) esp_timer_get_time() - start;
+            stats.merges++;
+        } else if(ok_a) {
+            input_a.ReadAll(out, 1, 512);
+        } else {
+            input_b.ReadAll(out, 1, 512);
+        }
+
+        // an output smaller than the universe sends the first channels
+        uint16_t nb = output.GetDmxNbChannels();
+        output.BeginFrame();
+        output.WriteAll(out, 1, (nb < 512) ? nb : 512);
+        output.Commit();
+        stats.frames++;
+    }
+}
@@ -0,0 +1,95 @@
+/*
+ * This file is part of the ESP32-DMX distribution (https://github.com/luksal/ESP32-DMX).
+ * Copyright (c) 2021 Lukas Salomon.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "dmx.h"
+
+#ifndef DMX_MERGE_h
+#define DMX_MERGE_h
+
+#define DMX_MERGE_CHECK_MS      100         // source loss check period when no frame is received
+
+enum DMXMergePolicy { DMX_MERGE_HTP, DMX_MERGE_LTP };
+
+// Counters of the merger, written by the merge task
+struct DMXMergeStats
+{
+    uint32_t frames;                                        // frames committed to the output
+    uint32_t merges;                                        // frames merged from both inputs
+    uint32_t frames_a;                                      // frames received on each input
+    uint32_t frames_b;
+    uint32_t losses_a;                                      // times an input was lost (not healthy anymore)
+    uint32_t losses_b;
+    uint32_t merge_us;                                      // total cpu time spent in the merge kernel
+
+    float CostPerFrame() const { return (merges == 0) ? 0 : (float) merge_us / merges; }
+};
+
+// Merges two DMX inputs into one DMX output, channel by channel:
+// HTP (highest takes precedence) or LTP (latest takes precedence, the input
+// whose frame last changed the channel). A merged frame is committed as soon
+// as either input publishes a frame. An input that is not healthy anymore is
+// left out of the merge; when both are lost the output holds the last look.
+//
+// The merger uses the frame callback of both inputs, which must listen to
+// the whole universe (start address 1, 512 channels): Begin() fails on an
+// input listening to a window or whose callback is already used (by a
+// DMXRecorder for instance).
+class DMXMerger
+{
+    public:
+        DMXMerger(DMX & input_a, DMX & input_b, DMX & output);
+        ~DMXMerger();
+
+        // starts the merge task, the inputs and the output must be initialized, false when an input can not be merged
+        bool Begin(UBaseType_t priority = 2, BaseType_t core = tskNO_AFFINITY);
+        void End();                                         // returns once the merge task left, DMX_MERGE_CHECK_MS at most
+
+        void SetPolicy(uint16_t start, uint16_t size, DMXMergePolicy policy);   // HTP by default
+
+        const DMXMergeStats & GetStats() const { return stats; }
+
+        // merge kernel on n slots: out = ltp[i] ? (owner[i] ? b : a) : max(a, b)
+        static void Merge(uint8_t * out, const uint8_t * a, const uint8_t * b,
+                          const uint8_t * ltp, const uint8_t * owner, uint16_t n);
+
+    private:
+        DMXMerger(const DMXMerger &);
+        DMXMerger & operator=(const DMXMerger &);
+
+        DMX & input_a;
+        DMX & input_b;
+        DMX & output;
+        TaskHandle_t volatile task;                         // cleared by the merge task when it leaves
+        volatile bool running;                              // false asks the merge task to leave
+
+        uint8_t ltp[513];                                   // 0xFF for LTP channels, 0 for HTP
+        uint8_t owner[513];                                 // 0xFF when input b changed the channel last, 0 for input a
+
+        DMXMergeStats stats;
+
+        void onFrame(uint8_t source, uint16_t nb, const uint32_t * dirty);
+        void run();
+
+        static void frame_callback_a(const uint8_t * frame, uint16_t start, uint16_t nb, const uint32_t * dirty, uint32_t seq, uint32_t now_us, void * arg);
+        static void frame_callback_b(const uint8_t * frame, uint16_t start, uint16_t nb, const uint32_t * dirty, uint32_t seq, uint32_t now_us, void * arg);
+        static void merge_task(void * pvParameters);        // pvParameters is the merger
+};
+
+#endif
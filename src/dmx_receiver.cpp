@@ -0,0 +1,666 @@
+/*
+ * This file is part of the ESP32-DMX distribution (https://github.com/luksal/ESP32-DMX).
+ * Copyright (c) 2021 Lukas Salomon.
+ *
+ * Reviewed by Yoann Darche 2022-2023 (https://github.com/yoann-darche/ESP32-DMX)
+ * - RX state machine with all 0 filter and blackout detection
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "dmx_receiver.h"
+
+DMXReceiver::DMXReceiver() :
+    capacity(512),
+    dirty_offset(DMX_FRAME_DIRTY_OFFSET),
+    _StartDMXAddr(1),
+    _NbChannels(512),
+    dmx_state(DMX_IDLE),
+    current_rx_addr(0),
+    last_dmx_packet(0),
+    rx_start(1),
+    rx_nb(512),
+    published_start(1),
+    published_nb(512),
+    isAllZero(true),
+    CptAllZeroFrame(0),
+    frame_events(0),
+    stats_version(0),
+    stats_reset(true),
+    alt_size(0),
+    alt_delivered(true),
+    nb_windows(0),
+    rx_windows(0),
+    transform(nullptr)
+{
+    memset(windows, 0, sizeof(windows));
+    memset(&counters, 0, sizeof(counters));
+    memset(&stats, 0, sizeof(stats));
+}
+
+bool DMXReceiver::Begin(uint16_t capacity, uint8_t * storage)
+{
+    if((capacity == 0) || (capacity > 512)) return false;
+
+    dmx_state = DMX_IDLE;
+    isAllZero = true;
+    CptAllZeroFrame = 0;
+    frame_events = 0;
+
+    this->capacity = capacity;
+    dirty_offset = DirtyOffset(capacity);
+    if(_NbChannels > capacity) _NbChannels = capacity;
+    if(_StartDMXAddr + _NbChannels > 513) _StartDMXAddr = 513 - _NbChannels;
+    rx_start = published_start = _StartDMXAddr;
+    rx_nb = published_nb = _NbChannels;
+
+    // the frames are sized for the largest window, so the listened
+    // window can be changed later without reallocating under the readers
+    return rx_frame.Begin(FrameSize(capacity), storage);
+}
+
+void DMXReceiver::End()
+{
+    rx_frame.End();
+}
+
+//*****************************************************************************
+//** Update the listenning startAddress and NbChannel (applied on next frame) **
+//*****************************************************************************
+bool DMXReceiver::SetWindow(uint16_t StartAddr, uint16_t nb)
+{
+    if((StartAddr == 0) || (StartAddr > 512)) return false;
+
+    if((nb == 0) || (nb > capacity)) return false;
+
+    if(StartAddr+nb > 513) return false;
+
+    // latched at the next break
+    _StartDMXAddr = StartAddr;
+    _NbChannels = nb;
+    return true;
+}
+
+bool DMXReceiver::SetDmxStartAdress(uint16_t StartAddr)
+{
+    if((StartAddr == 0) || (StartAddr > 512)) return false;
+
+    if(StartAddr+_NbChannels > 513) return false;
+
+    // latched at the next break
+    _StartDMXAddr = StartAddr;
+    return true;
+}
+
+bool DMXReceiver::SetDmxNbChannels(uint16_t nb)
+{
+    if((nb == 0) || (nb > capacity)) return false;
+
+    if(_StartDMXAddr+nb > 513) return false;
+
+    // latched at the next break, buffers are already full sized
+    _NbChannels = nb;
+    return true;
+}
+
+bool DMXReceiver::AddWindow(DMXWindow & window)
+{
+    uint8_t n = nb_windows.load(std::memory_order_relaxed);
+    if((n >= DMX_MAX_WINDOWS) || (window._nb == 0)) return false;
+
+    // the receiving task sees the window once the count is stored
+    windows[n] = &window;
+    nb_windows.store(n + 1, std::memory_order_release);
+    return true;
+}
+
+void DMXReceiver::SetAltStartCodeCallback(DMXAltCallback callback, void * arg)
+{
+    alt_callback.Set(callback, arg);
+}
+
+void DMXReceiver::SetFrameCallback(DMXFrameCallback callback, void * arg)
+{
+    frame_callback.Set(callback, arg);
+}
+
+void DMXReceiver::SetSlotsCallback(DMXSlotsCallback callback, void * arg)
+{
+    slots_callback.Set(callback, arg);
+}
+
+void DMXReceiver::OnBreak(uint32_t now_us)
+{
+    const DMXCallbackPair<DMXSlotsCallback>::Pair * slots = slots_callback.Get();
+    if(slots->callback != nullptr) slots->callback(0, nullptr, 0, now_us, slots->arg);
+
+    counters.frame_events = frame_events;
+    if(frame_events > counters.max_frame_events) counters.max_frame_events = frame_events;
+    frame_events = 0;
+
+    if(dmx_state == DMX_ALT)
+    {
+        // end of an alternate start code packet, the next frame can follow without resync
+        deliverAlt();
+        dmx_state = DMX_BREAK;
+    }
+    else if((dmx_state == DMX_DONE) || (dmx_state == DMX_DATA))
+    {
+        updateStats(now_us);
+        dmx_state = DMX_BREAK;
+
+        if(!isAllZero)
+        {
+            // hand the frame over to the readers
+            commitFrame(now_us);
+            CptAllZeroFrame = 0;
+        }
+        else
+        {
+            counters.zero_frames++;
+            CptAllZeroFrame++;
+
+            if(CptAllZeroFrame >= NBZEROFRAME_TRIGGER_BLACKOUT)
+            {
+                // publish a blackout frame
+                memset(rx_frame.Back(), 0, capacity + 1);
+                for(uint8_t i = 0; i < rx_windows; i++)
+                {
+                    DMXWindow * window = windows[i];
+                    memset(window->frame.Back(), 0, window->_nb + 1);
+                    window->frame.Publish();
+                }
+                publishFrame(now_us);
+                counters.blackouts++;
+                CptAllZeroFrame = 0;
+            }
+        }
+        isAllZero = true;
+    }
+    else if(dmx_state == DMX_IDLE)
+    {
+        stats.last_break_us = now_us;
+        dmx_state = DMX_BREAK;
+    }
+    else
+    {
+        // two breaks without data, resync on the next one
+        counters.resyncs++;
+        dmx_state = DMX_IDLE;
+    }
+}
+
+void DMXReceiver::OnData(const uint8_t * data, size_t size, uint32_t now_us)
+{
+    if(size == 0) return;
+
+    // check if break detected
+    if(dmx_state == DMX_BREAK)
+    {
+        // if not 0, then RDM or custom protocol
+        if(data[0] == 0)
+        {
+            dmx_state = DMX_DATA;
+
+            // reset dmx adress to 0
+            current_rx_addr = 0;
+            isAllZero = true;
+
+            // latch the listened window for this frame
+            rx_start = _StartDMXAddr;
+            rx_nb = _NbChannels;
+            rx_windows = nb_windows.load(std::memory_order_acquire);
+
+            // store received timestamp
+            last_dmx_packet.store(now_us, std::memory_order_relaxed);
+        }
+        else if(alt_callback.GetCallback() != nullptr)
+        {
+            // RDM or custom protocol, captured in its own buffer
+            dmx_state = DMX_ALT;
+            alt_size = 0;
+            alt_delivered = false;
+        }
+        else
+        {
+            counters.ignored_frames++;
+            dmx_state = DMX_IDLE;
+        }
+    }
+
+    if(dmx_state == DMX_ALT)
+    {
+        onAltData(data, size);
+        return;
+    }
+
+    // check if in data receive mode
+    if(dmx_state == DMX_DATA)
+    {
+        // slots of this chunk belonging to the frame, extra bytes are ignored
+        size_t nb = 513 - current_rx_addr;
+        if(size < nb) nb = size;
+
+        isAllZero = isAllZero && isZero(data, nb);
+
+        const DMXCallbackPair<DMXSlotsCallback>::Pair * slots = slots_callback.Get();
+        if(slots->callback != nullptr) slots->callback(current_rx_addr, data, nb, now_us, slots->arg);
+
+        // copy the part of the chunk inside the listened window at once
+        uint16_t first = current_rx_addr;
+        uint16_t last = current_rx_addr + nb;                       // exclusive
+        if(first < rx_start) first = rx_start;
+        if(last > rx_start + rx_nb) last = rx_start + rx_nb;
+        if(first < last)
+        {
+            memcpy(rx_frame.Back() + first - rx_start + 1, data + first - current_rx_addr, last - first);
+        }
+
+        // same chunk into the subscriber windows
+        for(uint8_t i = 0; i < rx_windows; i++)
+        {
+            windows[i]->fill(data, current_rx_addr, current_rx_addr + nb);
+        }
+
+        current_rx_addr += nb;
+
+        if((current_rx_addr == 513) || (size > nb))  {
+            dmx_state = DMX_DONE;
+            stats.last_frame_end_us = now_us;
+        }
+    }
+}
+
+void DMXReceiver::OnError()
+{
+    // error recevied, going to idle mode
+    if(dmx_state == DMX_ALT) deliverAlt();
+    counters.errors++;
+    dmx_state = DMX_IDLE;
+}
+
+void DMXReceiver::OnOverflow(uint32_t now_us)
+{
+    counters.overflows++;
+
+    if(dmx_state == DMX_DATA)
+    {
+        // the slots after the loss are ignored till the next break, which commits the frame as a short one
+        dmx_state = DMX_DONE;
+        stats.last_frame_end_us = now_us;
+    }
+    else if(dmx_state != DMX_DONE)
+    {
+        // nothing worth keeping, going to idle mode
+        if(dmx_state == DMX_ALT) deliverAlt();
+        dmx_state = DMX_IDLE;
+    }
+}
+
+//*****************************************************************************
+//** Alternate start code packets                                             **
+//*****************************************************************************
+void DMXReceiver::onAltData(const uint8_t * data, size_t size)
+{
+    if(alt_delivered) return;
+
+    if(alt_size < DMX_ALT_MAX_SIZE)
+    {
+        size_t nb = DMX_ALT_MAX_SIZE - alt_size;
+        if(size < nb) nb = size;
+        memcpy(alt_data + alt_size, data, nb);
+    }
+    alt_size = (alt_size + size > 0xFFFF) ? 0xFFFF : alt_size + size;
+
+    // RDM packets carry their length (byte 2, checksum excluded), no need to wait for the next break
+    if((alt_data[0] == DMX_SC_RDM) && (alt_size >= 3) && (alt_size >= alt_data[2] + 2))
+    {
+        deliverAlt();
+    }
+}
+
+void DMXReceiver::deliverAlt()
+{
+    if(alt_delivered) return;
+    alt_delivered = true;
+
+    uint16_t size = alt_size;
+    if(size > DMX_ALT_MAX_SIZE)
+    {
+        counters.alt_overflows++;
+        size = DMX_ALT_MAX_SIZE;
+    }
+
+    // RDM: drop anything received after the checksum
+    if((alt_data[0] == DMX_SC_RDM) && (size >= 3) && (size > alt_data[2] + 2))
+    {
+        size = alt_data[2] + 2;
+    }
+
+    counters.alt_frames++;
+    const DMXCallbackPair<DMXAltCallback>::Pair * callback = alt_callback.Get();
+    if(callback->callback != nullptr)
+    {
+        callback->callback(alt_data[0], alt_data, size, callback->arg);
+    }
+}
+
+//*****************************************************************************
+//** Timing statistics, updated once per frame under a version counter       **
+//*****************************************************************************
+void DMXReceiver::updateStats(uint32_t now_us)
+{
+    uint32_t period = now_us - stats.last_break_us;
+    uint16_t slots = (current_rx_addr > 0) ? current_rx_addr - 1 : 0;
+
+    stats_version.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    if(stats_reset)
+    {
+        memset(&stats, 0, sizeof(stats));
+        stats.period_min_us = UINT32_MAX;
+        stats.slots_min = UINT16_MAX;
+        stats.last_break_us = now_us;
+        stats_reset = false;
+    }
+    else
+    {
+        if(stats.frames == 0)
+        {
+            stats.period_avg_us = period;
+        }
+        else
+        {
+            stats.period_avg_us += ((int32_t) (period - stats.period_avg_us)) / 16;
+        }
+        if(period < stats.period_min_us) stats.period_min_us = period;
+        if(period > stats.period_max_us) stats.period_max_us = period;
+
+        uint32_t jitter = (period > stats.period_avg_us) ? period - stats.period_avg_us : stats.period_avg_us - period;
+        static const uint32_t limits[DMX_JITTER_BUCKETS - 1] = { 50, 100, 200, 500, 1000, 2000, 5000 };
+        uint8_t bucket = 0;
+        while((bucket < DMX_JITTER_BUCKETS - 1) && (jitter >= limits[bucket])) bucket++;
+        stats.jitter[bucket]++;
+
+        stats.slots_last = slots;
+        if(slots < stats.slots_min) stats.slots_min = slots;
+        if(slots > stats.slots_max) stats.slots_max = slots;
+
+        stats.frames++;
+        stats.last_break_us = now_us;
+    }
+
+    std::atomic_thread_fence(std::memory_order_release);
+    stats_version.fetch_add(1, std::memory_order_release);
+}
+
+bool DMXReceiver::GetStats(DMXRxStats & copy) const
+{
+    bool consistent = false;
+    for(uint8_t tries = 0; (tries < DMX_STATS_TRIES) && !consistent; tries++)
+    {
+        uint32_t version = stats_version.load(std::memory_order_acquire);
+        if(version & 1) continue;
+
+        memcpy(&copy, (const void *) &stats, sizeof(copy));
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        consistent = (stats_version.load(std::memory_order_relaxed) == version);
+    }
+    if(!consistent) return false;
+
+    if(copy.frames == 0)
+    {
+        copy.period_min_us = 0;
+        copy.slots_min = 0;
+    }
+    return true;
+}
+
+void DMXReceiver::ResetStats()
+{
+    // the receiving task owns the statistics, it clears them on the next frame
+    stats_reset = true;
+}
+
+//*****************************************************************************
+//** True when all the bytes are 0, tested 32 bits at a time                 **
+//*****************************************************************************
+bool DMXReceiver::isZero(const uint8_t * data, size_t size)
+{
+    uint32_t acc = 0;
+
+    // head, up to the first aligned word
+    while((size > 0) && ((uintptr_t) data & 0x03))
+    {
+        acc |= *data++;
+        size--;
+    }
+
+    const uint32_t * words = (const uint32_t *) data;
+    for(size_t i = 0; i < size / 4; i++)
+    {
+        acc |= words[i];
+    }
+
+    // tail
+    data += size & ~((size_t) 0x03);
+    for(size_t i = 0; i < (size & 0x03); i++)
+    {
+        acc |= data[i];
+    }
+
+    return acc == 0;
+}
+
+//*****************************************************************************
+//** Publish the received frame: slots not received keep their last value   **
+//*****************************************************************************
+void DMXReceiver::commitFrame(uint32_t now_us)
+{
+    uint8_t * back = rx_frame.Back();
+    const uint8_t * front = rx_frame.Front();
+    const DMXTransform * curves = transform.load(std::memory_order_acquire);
+
+    // curves on the slots received in the window, the ones carried over went through them already;
+    // a short frame cut inside a 16 bit pair carries the whole pair over
+    uint16_t end = (current_rx_addr < rx_start + rx_nb) ? current_rx_addr : rx_start + rx_nb;
+    if((curves != nullptr) && (end > rx_start) && (end < rx_start + rx_nb))
+    {
+        end = rx_start + curves->Whole(rx_start, end - rx_start);
+    }
+    if((curves != nullptr) && (end > rx_start))
+    {
+        curves->Apply(back, rx_start, end - rx_start);
+    }
+
+    // short frame, carry over the remaining slots of the window from the last frame: the window
+    // may have moved since, the channels it did not hold are 0
+    if(end < rx_start + rx_nb)
+    {
+        uint16_t first = (end > rx_start) ? end : rx_start;                     // channels first to last - 1
+        uint16_t last = rx_start + rx_nb;
+        uint16_t from = (first > published_start) ? first : published_start;
+        uint16_t to = (last < published_start + published_nb) ? last : published_start + published_nb;
+
+        if((from != first) || (to != last)) {
+            memset(back + first - rx_start + 1, 0, last - first);
+        }
+        if(from < to) {
+            memcpy(back + from - rx_start + 1, front + from - published_start + 1, to - from);
+        }
+    }
+
+    // the windows are published before the main frame, its callback finds them up to date
+    for(uint8_t i = 0; i < rx_windows; i++)
+    {
+        windows[i]->commit(current_rx_addr, curves);
+    }
+
+    publishFrame(now_us);
+    counters.frames++;
+}
+
+//*****************************************************************************
+//** Diff the back buffer against the last frame, store the bitmap, publish  **
+//*****************************************************************************
+void DMXReceiver::publishFrame(uint32_t now_us)
+{
+    uint8_t * back = rx_frame.Back();
+    const uint8_t * front = rx_frame.Front();
+    uint32_t * dirty = (uint32_t *) (back + dirty_offset);
+
+    if((rx_start != published_start) || (rx_nb != published_nb))
+    {
+        // the window moved, every channel changed
+        memset(dirty, 0xFF, DirtyWords(capacity) * 4);
+        published_start = rx_start;
+        published_nb = rx_nb;
+    }
+    else
+    {
+        memset(dirty, 0, DirtyWords(capacity) * 4);
+
+        // compare 4 slots at a time, most of them do not change
+        for(uint16_t i = 0; i <= rx_nb; i += 4)
+        {
+            uint32_t a, b;
+            memcpy(&a, back + i, 4);
+            memcpy(&b, front + i, 4);
+            if(a == b) continue;
+
+            for(uint16_t j = i; (j < i + 4) && (j <= rx_nb); j++)
+            {
+                if(back[j] != front[j])
+                {
+                    dirty[j >> 5] |= (uint32_t) 1 << (j & 31);
+                }
+            }
+        }
+    }
+
+    uint32_t seq = rx_frame.Publish();
+
+    // the published buffer stays stable for this task until the next commits
+    const DMXCallbackPair<DMXFrameCallback>::Pair * callback = frame_callback.Get();
+    if(callback->callback != nullptr)
+    {
+        callback->callback(back, rx_start, rx_nb, dirty, seq, now_us, callback->arg);
+    }
+}
+
+uint32_t DMXReceiver::ReadChanged(DMXChangedCallback callback, void * arg, uint32_t last_seq) const
+{
+    uint32_t frame_words[DMX_FRAME_SIZE / 4];               // keeps the bitmap 32 bits aligned
+    uint8_t * frame = (uint8_t *) frame_words;
+    uint32_t seq = rx_frame.Snapshot(frame, 0, rx_frame.Size());
+    uint16_t nb = _NbChannels;
+
+    if(seq == last_seq) return seq;
+
+    // frames were missed, the bitmap only covers the last one: everything is reported
+    if(seq != ((last_seq + 1) & DMXFrameBuffer::SEQ_MASK))
+    {
+        callback(1, frame + 1, nb, arg);
+        return seq;
+    }
+
+    const uint32_t * dirty = (const uint32_t *) (frame + dirty_offset);
+    uint16_t channel = 1;
+    while(channel <= nb)
+    {
+        uint32_t word = dirty[channel >> 5] >> (channel & 31);
+        if(word == 0)
+        {
+            // nothing changed up to the end of this word
+            channel = (channel | 31) + 1;
+            continue;
+        }
+
+        // start and length of the next range of changed channels
+        channel += __builtin_ctz(word);
+        if(channel > nb) break;
+
+        uint16_t end = channel;
+        while((end <= nb) && (dirty[end >> 5] & ((uint32_t) 1 << (end & 31))))
+        {
+            end++;
+        }
+
+        callback(channel, frame + channel, end - channel, arg);
+        channel = end;
+    }
+
+    return seq;
+}
+
+//*****************************************************************************
+//** Subscriber windows                                                      **
+//*****************************************************************************
+bool DMXWindow::Begin(uint16_t start, uint16_t nb, uint8_t * storage)
+{
+    if((start < 1) || (nb == 0) || (start + nb > 513)) return false;
+
+    _start = start;
+    _nb = nb;
+    return frame.Begin(nb + 1, storage);
+}
+
+uint8_t DMXWindow::Read(uint16_t channel) const
+{
+    if((channel < _start) || (channel >= _start + _nb)) return 0;
+
+    return frame.Get(channel - _start + 1);
+}
+
+uint32_t DMXWindow::ReadAll(uint8_t * data, uint16_t start, size_t size) const
+{
+    if((start < _start) || (start + size > (size_t) (_start + _nb))) return 0;
+
+    return frame.Snapshot(data, start - _start + 1, size);
+}
+
+void DMXWindow::fill(const uint8_t * data, uint16_t first, uint16_t last)
+{
+    uint16_t from = (first > _start) ? first : _start;
+    uint16_t to = (last < _start + _nb) ? last : _start + _nb;    // exclusive
+
+    if(from < to)
+    {
+        memcpy(frame.Back() + from - _start + 1, data + from - first, to - from);
+    }
+}
+
+void DMXWindow::commit(uint16_t received, const DMXTransform * curves)
+{
+    uint16_t end = (received < _start + _nb) ? received : _start + _nb;
+    if((curves != nullptr) && (end > _start) && (end < _start + _nb))
+    {
+        end = _start + curves->Whole(_start, end - _start);
+    }
+    if((curves != nullptr) && (end > _start))
+    {
+        curves->Apply(frame.Back(), _start, end - _start);
+    }
+
+    // short frame, carry over the remaining slots from the last frame
+    if(end < _start + _nb)
+    {
+        uint16_t first = (end > _start) ? end - _start + 1 : 1;
+        memcpy(frame.Back() + first, frame.Front() + first, _nb + 1 - first);
+    }
+
+    frame.Publish();
+}
@@ -0,0 +1,267 @@
+/*
+ * This file is part of the ESP32-DMX distribution (https://github.com/luksal/ESP32-DMX).
+ * Copyright (c) 2021 Lukas Salomon.
+ *
+ * Reviewed by Yoann Darche 2022-2023 (https://github.com/yoann-darche/ESP32-DMX)
+ * - RX state machine with all 0 filter and blackout detection
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+#include "dmx_frame.h"
+#include "dmx_transform.h"
+
+#ifndef DMX_RECEIVER_h
+#define DMX_RECEIVER_h
+
+#ifndef NBZEROFRAME_TRIGGER_BLACKOUT
+#define NBZEROFRAME_TRIGGER_BLACKOUT    12  // floor for black out detection , nb successive zeros frame.
+#endif
+
+// frame of a full universe, smaller receivers (see DMXReceiver::FrameSize) use the same layout
+#define DMX_FRAME_SLOTS         513         // start code + 512 slots
+#define DMX_FRAME_DIRTY_OFFSET  516         // changed channels bitmap stored after the slots, 32 bits aligned
+#define DMX_FRAME_DIRTY_WORDS   17          // 513 bits rounded to 32 bits words (bit 0 is the start code)
+#define DMX_FRAME_SIZE          (DMX_FRAME_DIRTY_OFFSET + DMX_FRAME_DIRTY_WORDS * 4)
+
+#define DMX_ALT_MAX_SIZE        513         // largest alternate start code packet captured (start code included)
+#define DMX_MAX_WINDOWS         8           // subscriber windows per receiver
+#define DMX_SC_RDM              0xCC        // RDM start code, its packets are delivered as soon as complete
+
+// called for each alternate start code packet received (RDM 0xCC, text 0x17, SIP 0xCF...), data[0] is the start code
+typedef void (*DMXAltCallback)(uint8_t start_code, const uint8_t * data, uint16_t size, void * arg);
+
+// called from the receiving task each time a frame is published: frame[0] is the start code, frame[1..nb] the
+// window listened from the dmx address start when the frame was received, dirty the changed channels bitmap
+// (bit n for frame[n]), seq its sequence number
+typedef void (*DMXFrameCallback)(const uint8_t * frame, uint16_t start, uint16_t nb, const uint32_t * dirty, uint32_t seq, uint32_t now_us, void * arg);
+
+// called for each chunk of the frame being received as it arrives (slot is the one of data[0], 0 for the start code),
+// and with size 0 at each break
+typedef void (*DMXSlotsCallback)(uint16_t slot, const uint8_t * data, uint16_t size, uint32_t now_us, void * arg);
+
+// called for each range of changed channels (channel is relative to the listened window, from 1)
+typedef void (*DMXChangedCallback)(uint16_t channel, const uint8_t * data, uint16_t size, void * arg);
+
+enum DMXState { DMX_IDLE, DMX_BREAK, DMX_DATA,DMX_DONE, DMX_OUTPUT, DMX_ALT };
+
+// Counters of the receive state machine, only written by the receiving task (and the interrupt)
+struct DMXRxCounters
+{
+    uint32_t frames;                                        // frames published to the readers
+    uint32_t zero_frames;                                   // frames filtered because all slots were 0
+    uint32_t blackouts;                                     // blackout published after NBZEROFRAME_TRIGGER_BLACKOUT zero frames
+    uint32_t ignored_frames;                                // alternate start code packets not captured (no callback)
+    uint32_t alt_frames;                                    // alternate start code packets delivered
+    uint32_t alt_overflows;                                 // alternate start code packets truncated to DMX_ALT_MAX_SIZE
+    uint32_t alt_dropped;                                   // alternate start code packets dropped, the receive task was DMX_ALT_RING packets late (interrupt receive mode)
+    uint32_t late_frames;                                   // frames not given to the frame callback, the receive task came two frames late (interrupt receive mode)
+    uint32_t resyncs;                                       // breaks received in an unexpected state
+    uint32_t errors;                                        // uart errors (frame, parity), the frame is dropped
+    uint32_t overflows;                                     // frames cut short by bytes lost in the uart, the slots received before are kept
+    uint32_t events;                                        // uart events (or interrupts) handled
+    uint32_t frame_events;                                  // events between the last two breaks
+    uint32_t max_frame_events;                              // most events seen between two breaks
+};
+
+#define DMX_STATS_TRIES         4           // copies attempted by GetStats() while the statistics are being updated
+#define DMX_JITTER_BUCKETS      8           // histogram of |period - average period|: <50us, <100, <200, <500, <1ms, <2ms, <5ms, more
+
+// Timing of the received signal, measured on the breaks (microseconds)
+struct DMXRxStats
+{
+    uint32_t frames;                                        // frames measured (break to break)
+    uint32_t period_min_us;                                 // break to break time
+    uint32_t period_avg_us;                                 // running average over ~16 frames
+    uint32_t period_max_us;
+    uint16_t slots_last;                                    // slots received in the last frame (start code excluded)
+    uint16_t slots_min;
+    uint16_t slots_max;
+    uint32_t last_break_us;                                 // timestamp of the last break
+    uint32_t last_frame_end_us;                             // timestamp of the last slot of the last complete frame
+    uint32_t jitter[DMX_JITTER_BUCKETS];
+
+    float FrameRate() const { return (period_avg_us == 0) ? 0 : 1000000.0f / period_avg_us; }
+};
+
+// Subscriber window: channels start to start + nb - 1 in their own frame buffers.
+//
+// The receiver fills every registered window in the same pass over the
+// incoming slots as its main window, and publishes them all at the break
+// that commits the frame. Each window is read lock free, so the task that
+// owns it neither copies the whole universe nor shares anything with the
+// readers of the other windows.
+class DMXWindow
+{
+    public:
+        DMXWindow() : _start(1), _nb(0) {}
+
+        // frame buffers for channels start to start + nb - 1, in storage (3 * (nb + 1) bytes) or allocated when nullptr
+        bool Begin(uint16_t start, uint16_t nb, uint8_t * storage = nullptr);
+
+        uint16_t GetStart() const { return _start; }
+        uint16_t GetNbChannels() const { return _nb; }
+
+        uint8_t Read(uint16_t channel) const;               // dmx value of channel (absolute address), 0 outside the window
+
+        // copies size channels from channel start (absolute address) of the last frame, returns its sequence number
+        uint32_t ReadAll(uint8_t * data, uint16_t start, size_t size) const;
+
+        uint32_t GetFrameSequence() const { return frame.Sequence(); }   // frames published in this window
+
+    private:
+        friend class DMXReceiver;
+
+        DMXWindow(const DMXWindow &);
+        DMXWindow & operator=(const DMXWindow &);
+
+        uint16_t _start;
+        uint16_t _nb;
+        DMXFrameBuffer frame;                               // index 0 is the start code, then the nb channels
+
+        void fill(const uint8_t * data, uint16_t first, uint16_t last);  // slots first to last - 1, data[0] is slot first
+        void commit(uint16_t received, const DMXTransform * curves);  // transforms the slots received, carries over the others, publishes
+};
+
+// DMX512 receive state machine (IDLE/BREAK/DATA/DONE).
+//
+// It has no dependency on FreeRTOS or on the UART driver: the owner feeds it
+// with the uart events (break, data chunks, errors) and a timestamp in
+// microseconds, so the same code runs in the uart event task and in a host
+// side line simulator.
+class DMXReceiver
+{
+    public:
+        DMXReceiver();
+
+        // frame buffers for windows of up to capacity channels, in storage (3 * FrameSize(capacity) bytes,
+        // 32 bits aligned) or allocated when nullptr
+        bool Begin(uint16_t capacity = 512, uint8_t * storage = nullptr);
+        void End();
+
+        // bytes of one frame: start code and capacity slots, then the changed channels bitmap (32 bits aligned)
+        static constexpr uint16_t DirtyOffset(uint16_t capacity) { return (capacity + 1 + 3) & ~3; }
+        static constexpr uint16_t DirtyWords(uint16_t capacity) { return (capacity + 1 + 31) / 32; }
+        static constexpr uint16_t FrameSize(uint16_t capacity) { return DirtyOffset(capacity) + DirtyWords(capacity) * 4; }
+
+        uint16_t GetCapacity() const { return capacity; }
+
+        bool SetWindow(uint16_t StartAddr, uint16_t nb);    // listened window, applied at the next break
+        bool SetDmxStartAdress(uint16_t StartAddr);
+        bool SetDmxNbChannels(uint16_t nb);
+        uint16_t GetDmxStartAdress() const { return _StartDMXAddr; }
+        uint16_t GetDmxNbChannels() const { return _NbChannels; }
+
+        void OnBreak(uint32_t now_us);                      // uart break detected
+        void OnData(const uint8_t * data, size_t size, uint32_t now_us); // slots received
+        void OnError();                                     // uart error, wait for the next break
+        void OnOverflow(uint32_t now_us);                   // bytes lost by the uart, the frame ends with the slots received so far
+        void OnEvent() { counters.events++; frame_events++; }   // one uart event (or interrupt) handled
+        void OnAltDropped() { counters.alt_dropped++; }     // an alternate start code packet found no room to be handed over
+        void OnLateFrame() { counters.late_frames++; }      // a frame was reused before its callback could run
+
+        // window filled and published with each frame from the next break on, it stays registered
+        // as long as the receiver (up to DMX_MAX_WINDOWS, one registering task at a time)
+        bool AddWindow(DMXWindow & window);
+
+        // packets with a non 0 start code are captured and given to callback (from the receiving task). Swapped
+        // as one with its argument, the owner serializes the setters
+        void SetAltStartCodeCallback(DMXAltCallback callback, void * arg = nullptr);
+
+        // callback is called after each frame commit (from the receiving task), keep it short. The callback and
+        // its argument are swapped as one (see DMXCallbackPair), the owner serializes the setters
+        void SetFrameCallback(DMXFrameCallback callback, void * arg = nullptr);
+        DMXFrameCallback GetFrameCallback() const { return frame_callback.GetCallback(); }
+
+        // callback sees the slots of the frame before they are stored (from the receiving task), keep it short.
+        // Swapped as one with its argument, the owner serializes the setters
+        void SetSlotsCallback(DMXSlotsCallback callback, void * arg = nullptr);
+
+        // curves applied to the slots received at each commit (nullptr for none), swapped at once
+        void SetTransform(const DMXTransform * curves) { transform.store(curves, std::memory_order_release); }
+
+        DMXState GetState() const { return dmx_state; }
+        uint32_t GetLastPacket() const { return last_dmx_packet.load(std::memory_order_relaxed); }
+        const DMXRxCounters & GetCounters() const { return counters; }
+        // consistent copy of the timing statistics, false when they were being updated at each of the
+        // DMX_STATS_TRIES attempts: never spins, the caller lets the receiving task run and retries
+        bool GetStats(DMXRxStats & copy) const;
+        void ResetStats();
+
+        const DMXFrameBuffer & GetFrame() const { return rx_frame; }   // published frames, index 0 is the start code
+
+        // calls callback for each range of channels changed since the frame last_seq, returns the sequence of the frame read
+        uint32_t ReadChanged(DMXChangedCallback callback, void * arg, uint32_t last_seq) const;
+
+    private:
+        uint16_t capacity;                                  // largest listened window
+        uint16_t dirty_offset;                              // DirtyOffset(capacity)
+
+        uint16_t _StartDMXAddr;                             // First adress liestend
+        uint16_t _NbChannels;                               // Number of channels listened from the start address
+
+        DMXState dmx_state;                                 // status, in which recevied state we are
+
+        uint16_t current_rx_addr;                           // last received dmx channel
+
+        std::atomic<uint32_t> last_dmx_packet;              // timestamp (us) for the last received packet
+
+        DMXFrameBuffer rx_frame;                            // received frames, published without lock to the readers
+        uint16_t rx_start;                                  // listened window latched for the frame being received
+        uint16_t rx_nb;
+        uint16_t published_start;                           // window of the last published frame
+        uint16_t published_nb;
+
+        // Filter on Zéros DMX Frame
+        bool isAllZero;                                     // indicate when a zéro frame is detected
+        uint8_t CptAllZeroFrame;                            // store the number of successive zéro frame detected, if more than 12 ==> Blackout
+
+        DMXRxCounters counters;
+        uint32_t frame_events;                              // events since the last break
+
+        DMXRxStats stats;                                   // written by the receiving task once per frame
+        std::atomic<uint32_t> stats_version;                // odd while stats is being updated
+        volatile bool stats_reset;                          // reset requested, done by the receiving task
+
+        void updateStats(uint32_t now_us);                  // account the frame ended by the break at now_us
+
+        // alternate start code capture
+        DMXCallbackPair<DMXAltCallback> alt_callback;
+        uint8_t alt_data[DMX_ALT_MAX_SIZE];
+        uint16_t alt_size;                                  // bytes received for the packet, may exceed DMX_ALT_MAX_SIZE
+        bool alt_delivered;
+
+        void onAltData(const uint8_t * data, size_t size);
+        void deliverAlt();
+
+        DMXWindow * windows[DMX_MAX_WINDOWS];               // registered windows
+        std::atomic<uint8_t> nb_windows;
+        uint8_t rx_windows;                                 // windows latched for the frame being received
+
+        void commitFrame(uint32_t now_us);                  // publish the received frame to the readers
+        void publishFrame(uint32_t now_us);                 // compute the changed channels and publish the back buffer
+
+        DMXCallbackPair<DMXFrameCallback> frame_callback;
+
+        std::atomic<const DMXTransform *> transform;
+
+        DMXCallbackPair<DMXSlotsCallback> slots_callback;
+
+        static bool isZero(const uint8_t * data, size_t size);
+};
+
+#endif
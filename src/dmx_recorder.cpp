@@ -0,0 +1,314 @@
+/*
+ * This file is part of the ESP32-DMX distribution (https://github.com/luksal/ESP32-DMX).
+ * Copyright (c) 2021 Lukas Salomon.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+#include "esp_timer.h"
+#include "dmx_recorder.h"
+
+// next run of changed channels from channel, short unchanged gaps are merged in, returns false at the end
+static bool nextRun(const uint32_t * dirty, uint16_t nb, bool all, uint16_t from, uint16_t & start, uint16_t & len)
+{
+    if(all)
+    {
+        if(from > nb) return false;
+        start = from;
+        len = nb - from + 1;
+        return true;
+    }
+
+    uint16_t ch = from;
+    while((ch <= nb) && !(dirty[ch >> 5] & ((uint32_t) 1 << (ch & 31))))
+    {
+        // skip whole words without change
+        if(dirty[ch >> 5] >> (ch & 31) == 0) ch = (ch | 31) + 1;
+        else ch++;
+    }
+    if(ch > nb) return false;
+
+    start = ch;
+    uint16_t end = ch;                                      // last changed channel of the run
+    uint16_t gap = 0;
+    for(ch = ch + 1; (ch <= nb) && (gap < DMX_REC_MERGE_GAP); ch++)
+    {
+        if(dirty[ch >> 5] & ((uint32_t) 1 << (ch & 31)))
+        {
+            end = ch;
+            gap = 0;
+        }
+        else
+        {
+            gap++;
+        }
+    }
+    len = end - start + 1;
+    return true;
+}
+
+DMXRecorder::DMXRecorder() :
+    input(nullptr),
+    storage(nullptr),
+    size(0),
+    head(0),
+    tail(0),
+    recording(false),
+    keyframe(true),
+    last_us(0)
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+bool DMXRecorder::Begin(DMX & input, uint8_t * storage, size_t size)
+{
+    if(!Begin(storage, size)) return false;
+
+    // the first frame may come in before SetFrameCallback returns
+    this->input = &input;
+    if(!input.SetFrameCallback(DMXRecorder::frame_callback, this)) {
+        recording = false;
+        this->input = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool DMXRecorder::Begin(uint8_t * storage, size_t size)
+{
+    if((storage == nullptr) || (size < DMX_REC_HEADER_SIZE + DMX_REC_RUN_SIZE + 513)) return false;
+
+    Stop();
+    this->storage = storage;
+    this->size = size;
+    head.store(0);
+    tail.store(0);
+    keyframe = true;
+    memset(&stats, 0, sizeof(stats));
+    recording = true;
+    return true;
+}
+
+void DMXRecorder::Stop()
+{
+    recording = false;
+
+    // the receive task is out of OnFrame once the callback is removed
+    if(input != nullptr) {
+        input->SetFrameCallback(nullptr);
+        input = nullptr;
+    }
+}
+
+size_t DMXRecorder::Available() const
+{
+    size_t h = head.load(std::memory_order_acquire);
+    size_t t = tail.load(std::memory_order_relaxed);
+    return (h >= t) ? h - t : size - t + h;
+}
+
+size_t DMXRecorder::Read(uint8_t * data, size_t len)
+{
+    size_t available = Available();
+    if(len > available) len = available;
+
+    size_t t = tail.load(std::memory_order_relaxed);
+    size_t first = size - t;
+    if(first > len) first = len;
+    memcpy(data, storage + t, first);
+    memcpy(data + first, storage, len - first);
+
+    tail.store((t + len) % size, std::memory_order_release);
+    return len;
+}
+
+void DMXRecorder::frame_callback(const uint8_t * frame, uint16_t start, uint16_t nb, const uint32_t * dirty, uint32_t seq, uint32_t now_us, void * arg)
+{
+    static_cast<DMXRecorder *>(arg)->OnFrame(frame, start, nb, dirty, now_us);
+}
+
+void DMXRecorder::put(size_t & pos, const void * data, size_t len)
+{
+    size_t first = size - pos;
+    if(first > len) first = len;
+    memcpy(storage + pos, data, first);
+    memcpy(storage, (const uint8_t *) data + first, len - first);
+    pos = (pos + len) % size;
+}
+
+void DMXRecorder::OnFrame(const uint8_t * frame, uint16_t window, uint16_t nb, const uint32_t * dirty, uint32_t now_us)
+{
+    if(!recording) return;
+
+    uint32_t start_us = (uint32_t) esp_timer_get_time();
+    uint16_t start, len, ch;
+
+    // the records hold dmx addresses, from the window the frame was received with
+    uint16_t first = window - 1;
+
+    // size of the record
+    size_t record = DMX_REC_HEADER_SIZE;
+    uint16_t runs = 0;
+    for(ch = 1; nextRun(dirty, nb, keyframe, ch, start, len); ch = start + len)
+    {
+        record += DMX_REC_RUN_SIZE + len;
+        runs++;
+    }
+
+    size_t room = size - 1 - Available();
+    if(record > room)
+    {
+        // the deltas chain is broken, the next record holds everything
+        stats.dropped++;
+        keyframe = true;
+        return;
+    }
+
+    size_t pos = head.load(std::memory_order_relaxed);
+    uint32_t dt = (stats.frames == 0) ? 0 : now_us - last_us;
+    put(pos, &dt, 4);
+    put(pos, &runs, 2);
+    for(ch = 1; nextRun(dirty, nb, keyframe, ch, start, len); ch = start + len)
+    {
+        uint16_t address = first + start;
+        put(pos, &address, 2);
+        put(pos, &len, 2);
+        put(pos, frame + start, len);
+    }
+
+    // the record becomes visible to the reader at once
+    head.store(pos, std::memory_order_release);
+
+    keyframe = false;
+    last_us = now_us;
+    stats.frames++;
+    stats.raw_bytes += nb + 1;
+    stats.encoded_bytes += record;
+    stats.encode_us += (uint32_t) esp_timer_get_time() - start_us;
+}
+
+
+DMXPlayer::DMXPlayer(DMX & output) :
+    output(output),
+    data(nullptr),
+    size(0),
+    loop(false),
+    playing(false),
+    stop(false)
+{
+}
+
+DMXPlayer::~DMXPlayer()
+{
+    End();
+}
+
+bool DMXPlayer::Begin(const uint8_t * data, size_t size, bool loop, UBaseType_t priority, BaseType_t core)
+{
+    End();
+
+    this->data = data;
+    this->size = size;
+    this->loop = loop;
+    stop = false;
+    playing = true;
+
+    if(xTaskCreatePinnedToCore(DMXPlayer::player_task, "dmx_player_task", 2048, this, priority, NULL, core) != pdPASS) {
+        DMX_LOG("DMXPlayer::Begin : Error when creating the player task!\n");
+        playing = false;
+        return false;
+    }
+    return true;
+}
+
+void DMXPlayer::End()
+{
+    // the task may hold the mutex of the output: it leaves by itself between two records
+    stop = true;
+    while(playing) {
+        vTaskDelay(1);
+    }
+}
+
+void DMXPlayer::player_task(void * pvParameters)
+{
+    DMXPlayer * player = static_cast<DMXPlayer *>(pvParameters);
+    player->play();
+
+    // the player is not touched anymore once playing is cleared
+    player->playing = false;
+    vTaskDelete(NULL);
+}
+
+void DMXPlayer::play()
+{
+    const uint32_t tick_us = portTICK_PERIOD_MS * 1000;
+    const uint32_t poll_ticks = (DMX_PLAY_POLL_MS > portTICK_PERIOD_MS) ? DMX_PLAY_POLL_MS / portTICK_PERIOD_MS : 1;
+
+    if(size < DMX_REC_HEADER_SIZE) return;
+
+    do
+    {
+        size_t pos = 0;
+        uint32_t target = (uint32_t) esp_timer_get_time();
+
+        while(pos + DMX_REC_HEADER_SIZE <= size)
+        {
+            uint32_t dt;
+            uint16_t runs;
+            memcpy(&dt, data + pos, 4);
+            memcpy(&runs, data + pos + 4, 2);
+            pos += DMX_REC_HEADER_SIZE;
+
+            // original timing, the deadline is absolute so delays do not add up,
+            // slept DMX_PLAY_POLL_MS at most at a time to see End()
+            target += dt;
+            int32_t wait = (int32_t) (target - (uint32_t) esp_timer_get_time());
+            while(!stop && (wait >= (int32_t) tick_us)) {
+                uint32_t ticks = wait / tick_us;
+                if(ticks > poll_ticks) ticks = poll_ticks;
+                vTaskDelay(ticks);
+                wait = (int32_t) (target - (uint32_t) esp_timer_get_time());
+            }
+            if(stop) return;
+
+            output.BeginFrame();
+            for(uint16_t r = 0; r < runs; r++)
+            {
+                uint16_t start, len;
+
+                // truncated recording, apply what is complete and stop
+                if(pos + DMX_REC_RUN_SIZE > size) {
+                    pos = size;
+                    break;
+                }
+                memcpy(&start, data + pos, 2);
+                memcpy(&len, data + pos + 2, 2);
+                pos += DMX_REC_RUN_SIZE;
+                if(pos + len > size) {
+                    pos = size;
+                    break;
+                }
+
+                // the channels beyond the output are not played
+                uint16_t nb = output.GetDmxNbChannels();
+                if((start >= 1) && (start <= nb)) {
+                    output.WriteAll((uint8_t *) data + pos, start, (start + len - 1 <= nb) ? len : nb - start + 1);
+                }
+                pos += len;
+            }
+            output.Commit();
+        }
+    } while(loop && !stop);
+}
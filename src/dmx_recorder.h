@@ -0,0 +1,124 @@
+/*
+ * This file is part of the ESP32-DMX distribution (https://github.com/luksal/ESP32-DMX).
+ * Copyright (c) 2021 Lukas Salomon.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+#include "dmx.h"
+
+#ifndef DMX_RECORDER_h
+#define DMX_RECORDER_h
+
+// Recording format, a sequence of records (little endian):
+//   uint32_t  time since the previous record (us)
+//   uint16_t  number of runs
+//   runs:     uint16_t first channel (dmx address), uint16_t length, length bytes of data
+// A record only holds the channels changed since the previous frame, the
+// first record (and the first one after an overflow) holds all channels.
+
+#define DMX_REC_HEADER_SIZE     6
+#define DMX_REC_RUN_SIZE        4
+#define DMX_REC_MERGE_GAP       DMX_REC_RUN_SIZE    // unchanged channels cheaper to copy than to start a new run
+
+#define DMX_PLAY_POLL_MS        20          // longest sleep of the player task, DMXPlayer::End() takes at most that long
+
+struct DMXRecorderStats
+{
+    uint32_t frames;                                        // frames recorded
+    uint32_t dropped;                                       // frames lost because the buffer was full
+    uint32_t raw_bytes;                                     // size of the recorded frames, uncompressed
+    uint32_t encoded_bytes;                                 // size of the records
+    uint32_t encode_us;                                     // total cpu time spent encoding
+
+    float Ratio() const { return (encoded_bytes == 0) ? 0 : (float) raw_bytes / encoded_bytes; }
+    float CostPerFrame() const { return (frames == 0) ? 0 : (float) encode_us / frames; }
+};
+
+// Records the frames received by a DMX input as timestamped sparse deltas
+// into a ring buffer. The encoding runs in the receive task at each frame
+// commit, another task drains the ring (to a file, the network...) with
+// Read(), or reads the whole recording at once when it is not drained.
+// The recorder takes the frame callback of the input till Stop().
+class DMXRecorder
+{
+    public:
+        DMXRecorder();
+
+        // records the frames of input into storage (size bytes), recording starts immediately,
+        // false when the frame callback of input is already used
+        bool Begin(DMX & input, uint8_t * storage, size_t size);
+        bool Begin(uint8_t * storage, size_t size);         // same for the frames given to OnFrame() by the application
+        void Stop();                                        // stops recording and gives the callback back, the records stay available
+
+        size_t Available() const;                           // bytes of records not read yet
+        size_t Read(uint8_t * data, size_t size);           // drains up to size bytes of records
+
+        DMXRecorderStats GetStats() const { return stats; }
+
+        // encodes one frame, called by the receive task (public for other frame sources): frame[1] is the channel
+        // at the dmx address start
+        void OnFrame(const uint8_t * frame, uint16_t start, uint16_t nb, const uint32_t * dirty, uint32_t now_us);
+
+    private:
+        DMX * input;                                        // input whose frame callback is taken
+        uint8_t * storage;
+        size_t size;
+        std::atomic<size_t> head;                           // written by the recording task
+        std::atomic<size_t> tail;                           // written by the reading task
+        volatile bool recording;
+
+        bool keyframe;                                      // next record must hold all the channels
+        uint32_t last_us;
+
+        DMXRecorderStats stats;
+
+        void put(size_t & pos, const void * data, size_t len);
+
+        static void frame_callback(const uint8_t * frame, uint16_t start, uint16_t nb, const uint32_t * dirty, uint32_t seq, uint32_t now_us, void * arg);
+};
+
+// Plays a recording back on a DMX output at its original timing.
+class DMXPlayer
+{
+    public:
+        DMXPlayer(DMX & output);
+        ~DMXPlayer();
+
+        // plays the records in data (size bytes), from a task, optionally in loop
+        bool Begin(const uint8_t * data, size_t size, bool loop = false,
+                   UBaseType_t priority = 2, BaseType_t core = tskNO_AFFINITY);
+        void End();
+
+        bool IsPlaying() const { return playing; }
+
+    private:
+        DMXPlayer(const DMXPlayer &);
+        DMXPlayer & operator=(const DMXPlayer &);
+
+        DMX & output;
+        const uint8_t * data;
+        size_t size;
+        bool loop;
+        volatile bool playing;                              // cleared by the player task when it leaves
+        volatile bool stop;                                 // asks the player task to leave
+
+        static void player_task(void * pvParameters);       // pvParameters is the player
+        void play();
+};
+
+#endif
@@ -0,0 +1,197 @@
+/*
+ * This file is part of the ESP32-DMX distribution (https://github.com/luksal/ESP32-DMX).
+ * Copyright (c) 2021 Lukas Salomon.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+#include "driver/gpio.h"
+#include "esp_timer.h"
+#include "dmx_repeater.h"
+
+#define REPEATER_BAUDRATE       250000      // 4us per bit
+#define REPEATER_BREAK_BITS     46          // 184us break generated after the held byte
+#define REPEATER_MAB_BITS       3           // 12us, the MAB mostly comes from the input line
+#define REPEATER_RX_RING        256         // smallest rx ring accepted by the uart driver
+#define REPEATER_TX_RING        (513 * 2)   // holds the chunks queued while the previous ones are sent
+
+DMXRepeater::DMXRepeater(DMX & input) :
+    input(input),
+    nb_outputs(0),
+    running(false),
+    held(false),
+    held_byte(0),
+    held_us(0)
+{
+    memset((void *) override_mask, 0, sizeof(override_mask));
+    memset((void *) override_value, 0, sizeof(override_value));
+    memset(&stats, 0, sizeof(stats));
+}
+
+DMXRepeater::~DMXRepeater()
+{
+    End();
+}
+
+bool DMXRepeater::AddOutput(const DMXConfig & config)
+{
+    if(running || (nb_outputs >= DMX_REPEATER_MAX_OUTPUTS)) {
+        DMX_LOG("DMXRepeater::AddOutput : Error, %d outputs at most, added before Begin!\n", DMX_REPEATER_MAX_OUTPUTS);
+        return false;
+    }
+
+    outputs[nb_outputs++] = config;
+    return true;
+}
+
+bool DMXRepeater::Begin()
+{
+    End();
+
+    uart_config_t uart_config =
+    {
+        .baud_rate = REPEATER_BAUDRATE,
+        .data_bits = UART_DATA_8_BITS,
+        .parity = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_2,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .source_clk = UART_SCLK_REF_TICK
+    };
+
+    for(uint8_t i = 0; i < nb_outputs; i++)
+    {
+        const DMXConfig & config = outputs[i];
+
+        uart_param_config(config.uart_num, &uart_config);
+        if(uart_set_pin(config.uart_num, config.tx_pin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE) != ESP_OK) {
+            DMX_LOG("DMXRepeater::Begin : Error when assigning the pins of UART%d!\n", config.uart_num);
+        }
+        if(uart_driver_install(config.uart_num, REPEATER_RX_RING, REPEATER_TX_RING, 0, NULL, 0) != ESP_OK) {
+            DMX_LOG("DMXRepeater::Begin : Error when installing the driver of UART%d!\n", config.uart_num);
+        }
+        uart_set_tx_idle_num(config.uart_num, REPEATER_MAB_BITS);
+
+        if(config.dir_pin >= 0) {
+            gpio_pad_select_gpio(config.dir_pin);
+            gpio_set_direction((gpio_num_t) config.dir_pin, GPIO_MODE_OUTPUT);
+            gpio_set_level((gpio_num_t) config.dir_pin, 1);
+        }
+    }
+    running = true;
+
+    held = false;
+    if(!input.SetSlotsCallback(DMXRepeater::slots_callback, this)) {
+        End();
+        return false;
+    }
+    return true;
+}
+
+void DMXRepeater::End()
+{
+    if(!running) return;
+
+    // the receive task is out of HandleSlots once the callback is removed, the uarts can go
+    input.SetSlotsCallback(nullptr);
+    for(uint8_t i = 0; i < nb_outputs; i++)
+    {
+        uart_driver_delete(outputs[i].uart_num);
+    }
+    running = false;
+}
+
+void DMXRepeater::SetOverride(uint16_t channel, uint8_t value)
+{
+    if(channel < 1 || channel > 512) return;
+
+    // the value is in place before the channel is flagged
+    override_value[channel] = value;
+    override_mask[channel] = 0xFF;
+}
+
+void DMXRepeater::ClearOverride(uint16_t channel)
+{
+    if(channel < 1 || channel > 512) return;
+
+    override_mask[channel] = 0;
+}
+
+void DMXRepeater::slots_callback(uint16_t slot, const uint8_t * data, uint16_t size, uint32_t now_us, void * arg)
+{
+    static_cast<DMXRepeater *>(arg)->HandleSlots(slot, data, size, now_us);
+}
+
+//*****************************************************************************
+//** Forwarding, called by the receive task of the input for each chunk      **
+//*****************************************************************************
+void DMXRepeater::HandleSlots(uint16_t slot, const uint8_t * data, uint16_t size, uint32_t now_us)
+{
+    if(size == 0)
+    {
+        // break on the input: the held byte ends the frame downstream, the uart adds the break after it
+        if(held) {
+            write(&held_byte, 1, true);
+            held = false;
+            stats.frames++;
+            account((uint32_t) esp_timer_get_time() - held_us);
+        }
+        return;
+    }
+
+    // the byte held from the previous chunk goes first, then the chunk with the overrides, no branch per slot
+    uint16_t n = 0;
+    if(held) chunk[n++] = held_byte;
+    for(uint16_t i = 0; i < size; i++)
+    {
+        uint8_t mask = override_mask[slot + i];
+        chunk[n++] = (data[i] & ~mask) | (override_value[slot + i] & mask);
+    }
+
+    // the oldest slot sent arrived with the previous chunk, or is the first of this one
+    uint32_t oldest = held ? held_us : now_us - (uint32_t) (size - 1) * DMX_SLOT_US;
+
+    held_byte = chunk[--n];
+    held_us = now_us;
+    held = true;
+
+    if(n > 0) {
+        write(chunk, n, false);
+        account((uint32_t) esp_timer_get_time() - oldest);
+    }
+    stats.chunks++;
+    stats.slots += size;
+}
+
+void DMXRepeater::write(const uint8_t * data, uint16_t size, bool with_break)
+{
+    for(uint8_t i = 0; i < nb_outputs; i++)
+    {
+        if(with_break) {
+            uart_write_bytes_with_break(outputs[i].uart_num, (const char *) data, size, REPEATER_BREAK_BITS);
+        } else {
+            uart_write_bytes(outputs[i].uart_num, (const char *) data, size);
+        }
+    }
+}
+
+void DMXRepeater::account(uint32_t latency)
+{
+    stats.last_us = latency;
+    if(latency > stats.max_us) stats.max_us = latency;
+    if(stats.avg_us == 0) {
+        stats.avg_us = latency;
+    } else {
+        stats.avg_us += ((int32_t) (latency - stats.avg_us)) / 16;
+    }
+}
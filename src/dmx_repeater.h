@@ -0,0 +1,99 @@
+/*
+ * This file is part of the ESP32-DMX distribution (https://github.com/luksal/ESP32-DMX).
+ * Copyright (c) 2021 Lukas Salomon.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "dmx.h"
+
+#ifndef DMX_REPEATER_h
+#define DMX_REPEATER_h
+
+#define DMX_REPEATER_MAX_OUTPUTS    2       // uarts left besides the input one
+#define DMX_SLOT_US                 44      // one slot on the wire (11 bits at 250 kbaud)
+
+// Counters of the repeater, written by the receive task of the input
+struct DMXRepeaterStats
+{
+    uint32_t frames;                                        // breaks regenerated downstream
+    uint32_t chunks;                                        // chunks of slots forwarded
+    uint32_t slots;                                         // slots forwarded (start codes included)
+    uint32_t last_us;                                       // latency of the oldest slot of the last chunk: from its
+    uint32_t avg_us;                                        // end on the input wire to its hand off to the output uarts,
+    uint32_t max_us;                                        // running average over ~16 chunks
+};
+
+// Cut-through repeater / splitter: the slots received by an input are
+// forwarded to one or more output uarts as soon as the receive task gets
+// them, instead of once per frame, so a hop adds a fraction of a frame of
+// latency instead of a whole frame.
+//
+// The last byte of each chunk is held back: when the input sees the break it
+// is sent together with a break generated by the output uart, followed by
+// the next frame as it arrives. Per channel overrides replace slots on the
+// fly. The first frame after Begin goes out without a break before it and is
+// ignored downstream.
+//
+// The input uses the uart driver (not the interrupt receive mode), a low
+// config.rx_full_threshold gives smaller chunks and a lower latency. The
+// output uarts are owned by the repeater, not by DMX instances.
+class DMXRepeater
+{
+    public:
+        DMXRepeater(DMX & input);
+        ~DMXRepeater();
+
+        bool AddOutput(const DMXConfig & config);           // output uart and pins (before Begin)
+
+        // installs the output uarts and starts forwarding, the input must be initialized
+        bool Begin();
+        void End();
+
+        void SetOverride(uint16_t channel, uint8_t value);  // channel always sent with value
+        void ClearOverride(uint16_t channel);
+
+        const DMXRepeaterStats & GetStats() const { return stats; }
+
+        // forwards one chunk of the frame being received (slot of data[0], 0 for the start code), size 0 for a break
+        void HandleSlots(uint16_t slot, const uint8_t * data, uint16_t size, uint32_t now_us);
+
+    private:
+        DMXRepeater(const DMXRepeater &);
+        DMXRepeater & operator=(const DMXRepeater &);
+
+        DMX & input;
+        DMXConfig outputs[DMX_REPEATER_MAX_OUTPUTS];
+        uint8_t nb_outputs;
+        bool running;
+
+        volatile uint8_t override_mask[513];                // 0xFF for the overridden channels
+        volatile uint8_t override_value[513];
+
+        bool held;                                          // a byte is held back for the next break
+        uint8_t held_byte;
+        uint32_t held_us;                                   // time its chunk arrived
+        uint8_t chunk[1 + 513];                             // held byte and slots of the chunk being sent
+
+        DMXRepeaterStats stats;
+
+        void write(const uint8_t * data, uint16_t size, bool with_break);
+        void account(uint32_t latency);
+
+        static void slots_callback(uint16_t slot, const uint8_t * data, uint16_t size, uint32_t now_us, void * arg);
+};
+
+#endif
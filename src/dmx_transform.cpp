@@ -0,0 +1,140 @@
+/*
+ * This file is part of the ESP32-DMX distribution (https://github.com/luksal/ESP32-DMX).
+ * Copyright (c) 2021 Lukas Salomon.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include "dmx_transform.h"
+
+// identity table, shared by all the transforms
+#define ID4(n)      (n), (n) + 1, (n) + 2, (n) + 3
+#define ID16(n)     ID4(n), ID4((n) + 4), ID4((n) + 8), ID4((n) + 12)
+#define ID64(n)     ID16(n), ID16((n) + 16), ID16((n) + 32), ID16((n) + 48)
+
+static const uint8_t identity[256] = { ID64(0), ID64(64), ID64(128), ID64(192) };
+
+DMXTransform::DMXTransform() :
+    nb_wide(0)
+{
+    for(uint16_t i = 0; i < 513; i++) curves[i] = identity;
+}
+
+void DMXTransform::SetCurve(uint16_t start, uint16_t size, const uint8_t * lut)
+{
+    if(start < 1 || start > 512 || start + size > 513) return;
+
+    if(lut == nullptr) lut = identity;
+    removeWide(start, size);
+    for(uint16_t i = start; i < start + size; i++) curves[i] = lut;
+}
+
+bool DMXTransform::SetCurve16(uint16_t channel, const uint16_t * lut)
+{
+    if(channel < 1 || channel > 511 || lut == nullptr) return false;
+
+    // both channels are written by the 16 bit curve, the 8 bit pass leaves the coarse one as received
+    removeWide(channel, 2);
+    if(nb_wide >= DMX_TRANSFORM_MAX_WIDE) return false;
+
+    curves[channel] = identity;
+    curves[channel + 1] = identity;
+    wide_channels[nb_wide] = channel;
+    wide_curves[nb_wide] = lut;
+    nb_wide++;
+    return true;
+}
+
+void DMXTransform::Clear(uint16_t start, uint16_t size)
+{
+    SetCurve(start, size, nullptr);
+}
+
+// 16 bit curves of channels start to start + size - 1 (coarse or fine) are dropped
+void DMXTransform::removeWide(uint16_t start, uint16_t size)
+{
+    uint8_t kept = 0;
+    for(uint8_t w = 0; w < nb_wide; w++)
+    {
+        uint16_t ch = wide_channels[w];
+        if((ch + 1 >= start) && (ch < start + size)) continue;
+
+        wide_channels[kept] = ch;
+        wide_curves[kept] = wide_curves[w];
+        kept++;
+    }
+    nb_wide = kept;
+}
+
+//*****************************************************************************
+//** Frame kernel: one table lookup per channel, then the 16 bit channels    **
+//*****************************************************************************
+void DMXTransform::Apply(uint8_t * frame, uint16_t start, uint16_t nb) const
+{
+    if(start < 1 || start + nb > 513) return;
+
+    // lut[i] is the table of frame[i]
+    const uint8_t * const * lut = curves + start - 1;
+    for(uint16_t i = 1; i <= nb; i++)
+    {
+        frame[i] = lut[i][frame[i]];
+    }
+
+    for(uint8_t w = 0; w < nb_wide; w++)
+    {
+        uint16_t ch = wide_channels[w];
+        if((ch < start) || (ch >= start + nb)) continue;
+
+        uint16_t value = wide_curves[w][frame[ch - start + 1]];
+        frame[ch - start + 1] = value >> 8;
+        if(ch + 1 < start + nb) {
+            frame[ch - start + 2] = value & 0xFF;
+        }
+    }
+}
+
+uint16_t DMXTransform::Whole(uint16_t start, uint16_t nb) const
+{
+    if(nb == 0) return 0;
+
+    for(uint8_t w = 0; w < nb_wide; w++)
+    {
+        if(wide_channels[w] == start + nb - 1) return nb - 1;
+    }
+    return nb;
+}
+
+void DMXTransform::Gamma(uint8_t * lut, float gamma)
+{
+    for(uint16_t x = 0; x < 256; x++)
+    {
+        lut[x] = (uint8_t) (255.0f * powf(x / 255.0f, gamma) + 0.5f);
+    }
+}
+
+void DMXTransform::Gamma16(uint16_t * lut, float gamma)
+{
+    for(uint16_t x = 0; x < 256; x++)
+    {
+        lut[x] = (uint16_t) (65535.0f * powf(x / 255.0f, gamma) + 0.5f);
+    }
+}
+
+void DMXTransform::Limits(uint8_t * lut, uint8_t min, uint8_t max)
+{
+    for(uint16_t x = 0; x < 256; x++)
+    {
+        lut[x] = (x < min) ? min : (x > max) ? max : x;
+    }
+}
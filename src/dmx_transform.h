@@ -0,0 +1,69 @@
+/*
+ * This file is part of the ESP32-DMX distribution (https://github.com/luksal/ESP32-DMX).
+ * Copyright (c) 2021 Lukas Salomon.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef DMX_TRANSFORM_h
+#define DMX_TRANSFORM_h
+
+#define DMX_TRANSFORM_MAX_WIDE  32          // channels with a 16 bit curve
+
+// Per channel curves (gamma, dimmer curves, limits) applied to whole frames.
+//
+// Each channel points to a 256 entries lookup table, the identity by
+// default, so a frame goes through one table driven loop without any branch
+// per channel. A 16 bit curve maps a channel to a coarse / fine pair: the
+// coarse value replaces the channel and the fine one the next channel.
+//
+// The tables are kept by the caller and may be shared by many channels. A
+// transform is given to DMX::SetTransform(): received frames go through it
+// once at their commit, frames to send on a copy right before they leave,
+// so Read() always returns the values written. A short frame received up to
+// the coarse channel of a 16 bit curve keeps the last pair, coarse and fine,
+// as both come from the same value.
+class DMXTransform
+{
+    public:
+        DMXTransform();
+
+        void SetCurve(uint16_t start, uint16_t size, const uint8_t * lut);    // channels start to start + size - 1
+        bool SetCurve16(uint16_t channel, const uint16_t * lut);            // channel and channel + 1 (fine)
+        void Clear(uint16_t start, uint16_t size);                          // back to the identity
+
+        // frame[1..nb] are the channels start to start + nb - 1, transformed in place
+        void Apply(uint8_t * frame, uint16_t start, uint16_t nb) const;
+
+        // channels of start to start + nb - 1 to transform when a frame stops after them: one less when the
+        // last one is the coarse channel of a 16 bit curve, its fine channel was not received
+        uint16_t Whole(uint16_t start, uint16_t nb) const;
+
+        // tables filled for the common curves
+        static void Gamma(uint8_t * lut, float gamma);                      // 255 * (x / 255) ^ gamma
+        static void Gamma16(uint16_t * lut, float gamma);                   // 65535 * (x / 255) ^ gamma
+        static void Limits(uint8_t * lut, uint8_t min, uint8_t max);        // x clamped to [min, max]
+
+    private:
+        const uint8_t * curves[513];                        // table of each channel, index 0 is the start code
+        uint16_t wide_channels[DMX_TRANSFORM_MAX_WIDE];     // channels with a 16 bit curve, in the order set
+        const uint16_t * wide_curves[DMX_TRANSFORM_MAX_WIDE];
+        uint8_t nb_wide;
+
+        void removeWide(uint16_t start, uint16_t size);
+};
+
+#endif
@@ -0,0 +1,369 @@
+/*
+ * This file is part of the ESP32-DMX distribution (https://github.com/luksal/ESP32-DMX).
+ * Copyright (c) 2021 Lukas Salomon.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+#include "esp_timer.h"
+#include "dmx_usbpro.h"
+
+#define PRO_TIME_MIN_BREAK      9           // widget parameter limits, in 10.67us units
+#define PRO_TIME_MIN_MAB        1
+#define PRO_TIME_MAX            127
+#define PRO_MAX_RATE            40          // frames per second, 0 is as fast as possible
+
+#define PRO_CHANGE_SLOTS        40          // slots covered by one change of state message
+#define PRO_READ_CHUNK          128         // bytes read from the port at once
+
+// widget time units (10.67us) from / to microseconds
+static uint8_t proTime(uint16_t us, uint8_t min)
+{
+    uint32_t units = ((uint32_t) us * 3 + 31) / 32;
+    if(units < min) units = min;
+    return (units > PRO_TIME_MAX) ? PRO_TIME_MAX : units;
+}
+
+static uint16_t proMicros(uint8_t units)
+{
+    return ((uint16_t) units * 32) / 3;
+}
+
+DMXUsbPro::DMXUsbPro(Stream & port, DMX * output, DMX * input) :
+    port(port),
+    output(output),
+    input(input),
+    task(NULL),
+    running(false),
+    silenced(false),
+    state(WAIT_SOM),
+    label(0),
+    length(0),
+    received(0),
+    break_time(PRO_TIME_MIN_BREAK),
+    mab_time(PRO_TIME_MIN_MAB),
+    refresh_rate(0),
+    serial_number(0),
+    tx_slots(512),
+    send_changes(false),
+    input_seq(0)
+{
+    memset(input_frame, 0, sizeof(input_frame));
+    memset(changed, 0, sizeof(changed));
+    memset(&stats, 0, sizeof(stats));
+}
+
+DMXUsbPro::~DMXUsbPro()
+{
+    End();
+}
+
+bool DMXUsbPro::Begin(UBaseType_t priority, BaseType_t core)
+{
+    End();
+
+    // the frames sent to the host and the change of state bitmap index the whole universe
+    if((input != nullptr) && ((input->GetDmxStartAdress() != 1) || (input->GetDmxNbChannels() != 512))) {
+        DMX_LOG("DMXUsbPro::Begin : Error, the input must listen to channels 1 to 512!\n");
+        return false;
+    }
+
+    // the parameters reported to the host are the timing really generated
+    if(output != nullptr) {
+        DMXTxTiming timing = output->GetTxTiming();
+        break_time = proTime(timing.break_us, PRO_TIME_MIN_BREAK);
+        mab_time = proTime(timing.mab_us, PRO_TIME_MIN_MAB);
+    }
+
+    running = true;
+    TaskHandle_t handle;
+    if(xTaskCreatePinnedToCore(DMXUsbPro::usbpro_task, "dmx_usbpro_task", 3072, this, priority, &handle, core) != pdPASS) {
+        DMX_LOG("DMXUsbPro::Begin : Error when creating the widget task!\n");
+        running = false;
+        return false;
+    }
+    task = handle;
+
+    // nothing but messages of the protocol goes to the host
+    if(DMX::GetLog() == static_cast<Print *>(&port)) {
+        DMX::SetLog(nullptr);
+        silenced = true;
+    }
+    return true;
+}
+
+void DMXUsbPro::End()
+{
+    // the task may hold the mutex of the output: it leaves by itself between two reads of the port
+    running = false;
+    while(task != NULL) {
+        vTaskDelay(1);
+    }
+
+    if(silenced && (DMX::GetLog() == nullptr)) {
+        DMX::SetLog(&port);
+    }
+    silenced = false;
+}
+
+void DMXUsbPro::usbpro_task(void * pvParameters)
+{
+    DMXUsbPro * pro = static_cast<DMXUsbPro *>(pvParameters);
+    uint8_t data[PRO_READ_CHUNK];
+
+    while(pro->running)
+    {
+        int len = pro->port.available();
+        if(len > 0) {
+            if(len > PRO_READ_CHUNK) len = PRO_READ_CHUNK;
+            len = pro->port.readBytes(data, len);
+            pro->HandleData(data, len, (uint32_t) esp_timer_get_time());
+        }
+
+        // nothing to do on either side, the task sleeps one tick
+        bool sent = pro->SendInput();
+        if((len <= 0) && !sent) {
+            vTaskDelay(1);
+        }
+    }
+
+    pro->task = NULL;
+    vTaskDelete(NULL);
+}
+
+//*****************************************************************************
+//** Messages from the host: SOM, label, length (LSB first), data, EOM       **
+//*****************************************************************************
+size_t DMXUsbPro::HandleData(const uint8_t * data, size_t size, uint32_t now_us)
+{
+    size_t handled = 0;
+    size_t i = 0;
+
+    while(i < size)
+    {
+        if(state == DATA)
+        {
+            // the data part is copied at once, its length was checked against the message buffer
+            size_t nb = length - received;
+            if(size - i < nb) nb = size - i;
+            memcpy(message + received, data + i, nb);
+            received += nb;
+            i += nb;
+            if(received == length) state = WAIT_EOM;
+            continue;
+        }
+
+        uint8_t c = data[i++];
+        switch(state)
+        {
+            case WAIT_SOM:
+                // anything between two messages is ignored
+                if(c == DMX_PRO_SOM) state = LABEL;
+                break;
+            case LABEL:
+                label = c;
+                state = LENGTH_LSB;
+                break;
+            case LENGTH_LSB:
+                length = c;
+                state = LENGTH_MSB;
+                break;
+            case LENGTH_MSB:
+                length |= (uint16_t) c << 8;
+                received = 0;
+                if(length > DMX_PRO_MAX_DATA) {
+                    // not a message of the host, its data is skipped as garbage up to the next SOM
+                    stats.invalid++;
+                    state = WAIT_SOM;
+                } else {
+                    state = (length == 0) ? WAIT_EOM : DATA;
+                }
+                break;
+            default:
+                if(c == DMX_PRO_EOM) {
+                    handleMessage(now_us);
+                    handled++;
+                    state = WAIT_SOM;
+                } else {
+                    // resync, the byte may start the next message
+                    stats.invalid++;
+                    state = (c == DMX_PRO_SOM) ? LABEL : WAIT_SOM;
+                }
+                break;
+        }
+    }
+
+    return handled;
+}
+
+void DMXUsbPro::handleMessage(uint32_t now_us)
+{
+    stats.messages++;
+
+    switch(label)
+    {
+        case DMX_PRO_TX_DMX:
+        {
+            if(output == nullptr) {
+                stats.unsupported++;
+                break;
+            }
+            // start code 0 and up to 512 slots
+            if((length < 2) || (length > 513) || (message[0] != 0)) {
+                stats.invalid++;
+                break;
+            }
+
+            // one copy into the output frame, sent as a whole with as many slots as the host sends
+            uint16_t nb = length - 1;
+            output->BeginFrame();
+            output->WriteAll(message + 1, 1, nb);
+            if(nb != tx_slots) {
+                output->SetTxSlots(nb);
+                tx_slots = nb;
+            }
+            output->Commit(now_us);
+            stats.frames_out++;
+            break;
+        }
+        case DMX_PRO_GET_PARAMS:
+        {
+            // no user configuration is stored, only the timing is returned
+            uint8_t params[5] = { DMX_PRO_FIRMWARE & 0xFF, DMX_PRO_FIRMWARE >> 8, break_time, mab_time, refresh_rate };
+            send(DMX_PRO_GET_PARAMS, params, sizeof(params));
+            break;
+        }
+        case DMX_PRO_SET_PARAMS:
+            // user configuration size (2 bytes), break, mab, rate, then the user configuration (ignored)
+            if(length < 5) {
+                stats.invalid++;
+                break;
+            }
+            break_time = (message[2] < PRO_TIME_MIN_BREAK) ? PRO_TIME_MIN_BREAK : (message[2] > PRO_TIME_MAX) ? PRO_TIME_MAX : message[2];
+            mab_time = (message[3] < PRO_TIME_MIN_MAB) ? PRO_TIME_MIN_MAB : (message[3] > PRO_TIME_MAX) ? PRO_TIME_MAX : message[3];
+            refresh_rate = (message[4] > PRO_MAX_RATE) ? PRO_MAX_RATE : message[4];
+            if(output != nullptr) {
+                output->SetTxTiming(proMicros(break_time), proMicros(mab_time));
+                output->SetTxRefreshRate(refresh_rate);
+            }
+            break;
+        case DMX_PRO_RX_ON_CHANGE:
+            if(length < 1) {
+                stats.invalid++;
+                break;
+            }
+            // the first change messages carry the whole universe
+            if(!send_changes && (message[0] != 0)) {
+                memset(changed, 0xFF, sizeof(changed));
+            }
+            send_changes = (message[0] != 0);
+            break;
+        case DMX_PRO_GET_SERIAL:
+        {
+            uint8_t serial[4] = { (uint8_t) serial_number, (uint8_t) (serial_number >> 8),
+                                  (uint8_t) (serial_number >> 16), (uint8_t) (serial_number >> 24) };
+            send(DMX_PRO_GET_SERIAL, serial, sizeof(serial));
+            break;
+        }
+        default:
+            // firmware update, RDM...
+            stats.unsupported++;
+            break;
+    }
+}
+
+void DMXUsbPro::send(uint8_t label, const uint8_t * data, uint16_t size)
+{
+    uint8_t header[4] = { DMX_PRO_SOM, label, (uint8_t) (size & 0xFF), (uint8_t) (size >> 8) };
+
+    port.write(header, sizeof(header));
+    port.write(data, size);
+    port.write((uint8_t) DMX_PRO_EOM);
+}
+
+//*****************************************************************************
+//** Frames of the input to the host                                         **
+//*****************************************************************************
+bool DMXUsbPro::SendInput()
+{
+    if(input == nullptr) return false;
+    if(input->GetFrameSequence() == input_seq) return false;
+
+    if(send_changes)
+    {
+        // only the channels flagged by the receiver are copied
+        input_seq = input->ReadChanged(DMXUsbPro::changed_callback, this, input_seq);
+        sendChanges();
+        return true;
+    }
+
+    // status (no overrun), start code, then the 512 slots from one snapshot
+    input_seq = input->GetFrameSequence();
+    input_frame[0] = 0;
+    input_frame[1] = 0;
+    input->ReadAll(input_frame + 2, 1, 512);
+    send(DMX_PRO_RX_DMX, input_frame, sizeof(input_frame));
+    stats.frames_in++;
+    return true;
+}
+
+void DMXUsbPro::changed_callback(uint16_t channel, const uint8_t * data, uint16_t size, void * arg)
+{
+    DMXUsbPro * pro = static_cast<DMXUsbPro *>(arg);
+
+    memcpy(pro->input_frame + 1 + channel, data, size);
+    for(uint16_t ch = channel; ch < channel + size; ch++)
+    {
+        pro->changed[ch >> 5] |= (uint32_t) 1 << (ch & 31);
+    }
+}
+
+// one message per 40 slots block holding changes: block start / 8, changed bits, then the new values
+void DMXUsbPro::sendChanges()
+{
+    uint8_t msg[6 + PRO_CHANGE_SLOTS];
+    uint16_t slot = 1;
+
+    while(slot <= 512)
+    {
+        uint32_t word = changed[slot >> 5] >> (slot & 31);
+        if(word == 0)
+        {
+            slot = (slot | 31) + 1;
+            continue;
+        }
+        slot += __builtin_ctz(word);
+        if(slot > 512) break;
+
+        uint16_t first = slot & ~7;
+        uint16_t nb = 0;
+        memset(msg, 0, 6);
+        msg[0] = first >> 3;
+        for(uint16_t i = 0; (i < PRO_CHANGE_SLOTS) && (first + i <= 512); i++)
+        {
+            uint16_t s = first + i;
+            if((s > 0) && (changed[s >> 5] & ((uint32_t) 1 << (s & 31))))
+            {
+                msg[1 + (i >> 3)] |= 1 << (i & 7);
+                msg[6 + nb++] = input_frame[1 + s];
+            }
+        }
+
+        send(DMX_PRO_RX_CHANGES, msg, 6 + nb);
+        stats.changes_in++;
+        slot = first + PRO_CHANGE_SLOTS;
+    }
+
+    memset(changed, 0, sizeof(changed));
+}
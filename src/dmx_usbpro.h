@@ -0,0 +1,130 @@
+/*
+ * This file is part of the ESP32-DMX distribution (https://github.com/luksal/ESP32-DMX).
+ * Copyright (c) 2021 Lukas Salomon.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <Arduino.h>
+#include "dmx.h"
+
+#ifndef DMX_USBPRO_h
+#define DMX_USBPRO_h
+
+#define DMX_PRO_SOM             0x7E        // start of message
+#define DMX_PRO_EOM             0xE7        // end of message
+#define DMX_PRO_MAX_DATA        600         // largest message data accepted from the host
+
+// message labels of the Enttec DMX USB Pro widget API
+#define DMX_PRO_GET_PARAMS      3
+#define DMX_PRO_SET_PARAMS      4
+#define DMX_PRO_RX_DMX          5           // received frame, to the host
+#define DMX_PRO_TX_DMX          6           // frame to send, from the host
+#define DMX_PRO_RX_ON_CHANGE    8           // 0: every received frame is sent, 1: only the changes
+#define DMX_PRO_RX_CHANGES      9           // changed slots, to the host
+#define DMX_PRO_GET_SERIAL      10
+
+#define DMX_PRO_FIRMWARE        0x0144      // firmware version reported to the host
+
+// Counters of the widget, written by the widget task
+struct DMXProStats
+{
+    uint32_t messages;                                      // messages received from the host
+    uint32_t invalid;                                       // bad framing, length or start code
+    uint32_t unsupported;                                   // labels not handled (firmware update, RDM...)
+    uint32_t frames_out;                                    // frames committed to the output
+    uint32_t frames_in;                                     // received frames sent to the host
+    uint32_t changes_in;                                    // change of state messages sent to the host
+};
+
+// Enttec DMX USB Pro widget on a serial link (USB CDC or uart), so a board
+// is driven by the PC software written for the Pro (OLA, QLC+, ...).
+//
+// Frames from the host (label 6) are copied in one WriteAll into the output
+// and committed as a whole. Frames of the input are sent to the host either
+// whole (label 5) or as change of state messages (label 9, built from the
+// changed channels bitmap of the receiver). The input must listen to the
+// whole universe (start address 1, 512 channels).
+//
+// The widget task is the only user of the port: when the port is the log of
+// the library (Serial by default), the log is silenced from Begin to End.
+// HandleData() and SendInput() do the work of the task and can be driven by
+// the application instead. A length above DMX_PRO_MAX_DATA is rejected as
+// soon as it is read, the parser waits for the next start of message.
+class DMXUsbPro
+{
+    public:
+        DMXUsbPro(Stream & port, DMX * output, DMX * input = nullptr);
+        ~DMXUsbPro();
+
+        // starts the widget task, the universes must be initialized; false when the input does not listen to 1 to 512
+        bool Begin(UBaseType_t priority = 2, BaseType_t core = tskNO_AFFINITY);
+        void End();
+
+        // parses bytes received from the host at now_us and answers on the port, returns the messages handled
+        size_t HandleData(const uint8_t * data, size_t size, uint32_t now_us);
+
+        // sends the last frame of the input to the host when it is new, returns true when something was sent
+        bool SendInput();
+
+        void SetSerialNumber(uint32_t serial) { serial_number = serial; }  // 8 BCD digits
+
+        const DMXProStats & GetStats() const { return stats; }
+
+    private:
+        DMXUsbPro(const DMXUsbPro &);
+        DMXUsbPro & operator=(const DMXUsbPro &);
+
+        enum ParserState { WAIT_SOM, LABEL, LENGTH_LSB, LENGTH_MSB, DATA, WAIT_EOM };
+
+        Stream & port;
+        DMX * output;
+        DMX * input;
+        TaskHandle_t volatile task;                         // cleared by the widget task when it leaves
+        volatile bool running;                              // false asks the widget task to leave
+        bool silenced;                                      // the log of the library was the port, restored by End
+
+        // message being received from the host
+        ParserState state;
+        uint8_t label;
+        uint16_t length;
+        uint16_t received;
+        uint8_t message[DMX_PRO_MAX_DATA];
+
+        // widget parameters, in the units of the Pro (10.67us, frames per second)
+        uint8_t break_time;
+        uint8_t mab_time;
+        uint8_t refresh_rate;
+        uint32_t serial_number;
+
+        uint16_t tx_slots;                                  // slots sent per frame, follows the frames of the host
+
+        bool send_changes;                                  // label 8: only the changed slots go to the host
+        uint32_t input_seq;                                 // last input frame sent to the host
+        uint8_t input_frame[2 + 512];                       // status, start code and slots as sent to the host
+        uint32_t changed[DMX_FRAME_DIRTY_WORDS];            // slots changed since the last change messages
+
+        DMXProStats stats;
+
+        void handleMessage(uint32_t now_us);
+        void send(uint8_t label, const uint8_t * data, uint16_t size);
+        void sendChanges();
+
+        static void changed_callback(uint16_t channel, const uint8_t * data, uint16_t size, void * arg);
+        static void usbpro_task(void * pvParameters);       // widget task, pvParameters is the widget
+};
+
+#endif
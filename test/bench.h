@@ -0,0 +1,34 @@
+// Timing helpers of the host benches: the figures are host nanoseconds, only
+// meaningful compared with each other on the same machine.
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+
+static inline uint64_t bench_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// keeps value alive so the measured code is not optimized out
+template<typename T>
+static inline void bench_keep(const T & value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// best of runs of iterations calls of body, in nanoseconds per call
+template<typename Body>
+static double bench_run(uint32_t iterations, Body body, int runs = 5)
+{
+    double best = 1e18;
+    for(int r = 0; r < runs; r++)
+    {
+        uint64_t start = bench_ns();
+        for(uint32_t i = 0; i < iterations; i++) body(i);
+        double ns = (double) (bench_ns() - start) / iterations;
+        if(ns < best) best = ns;
+    }
+    return best;
+}
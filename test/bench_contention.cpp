@@ -0,0 +1,156 @@
+// The public API under contention, the host run of
+// examples/Benchmark: 1 to 8 threads call Read, ReadAll, Write, WriteAll or
+// BeginFrame/WriteAll/Commit while the receive task is fed by the line at
+// wire speed and the send task is sending. One JSON line per case, with the
+// same fields as the sketch; the latencies are sampled by a reservoir and the
+// max includes the preemptions when there are more threads than cores.
+#include <atomic>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "dmx.h"
+#include "shim.h"
+#include "line_sim.h"
+#include "bench.h"
+#include "check.h"
+
+#define IN_UART                 UART_NUM_1
+#define OUT_UART                UART_NUM_2
+#define RUN_MS                  200                         // duration of one case
+#define MAX_TASKS               8
+#define SAMPLES                 1024                        // latency samples kept per thread
+
+enum Op { OP_READ, OP_READALL, OP_WRITE, OP_WRITEALL, OP_COMMIT, OP_COUNT };
+static const char * opNames[OP_COUNT] = { "Read", "ReadAll", "Write", "WriteAll", "Commit" };
+
+struct Worker
+{
+    Op op;
+    uint32_t calls;
+    uint32_t count;                                         // samples stored
+    uint32_t random;                                        // xorshift state of the reservoir
+    uint32_t samples[SAMPLES];                              // ns per call
+};
+
+static std::atomic<bool> running(false);
+
+static void work(Worker * w, DMX & input, DMX & output)
+{
+    uint8_t data[512] = { 0 };
+    uint16_t i = 0;
+
+    while(!running) std::this_thread::yield();
+
+    while(running)
+    {
+        uint64_t start = bench_ns();
+        switch(w->op)
+        {
+            case OP_READ:     data[0] = input.Read((i % 512) + 1); break;
+            case OP_READALL:  input.ReadAll(data, 1, 512); break;
+            case OP_WRITE:    output.Write((i % 512) + 1, i); break;
+            case OP_WRITEALL: output.WriteAll(data, 1, 512); break;
+            default:
+                output.BeginFrame();
+                output.WriteAll(data, 1, 512);
+                output.Commit();
+                break;
+        }
+        uint32_t ns = (uint32_t) (bench_ns() - start);
+
+        // call n replaces a random sample with probability SAMPLES / (n + 1)
+        if(w->count < SAMPLES)
+        {
+            w->samples[w->count++] = ns;
+        }
+        else
+        {
+            w->random ^= w->random << 13;
+            w->random ^= w->random >> 17;
+            w->random ^= w->random << 5;
+            uint32_t j = w->random % (w->calls + 1);
+            if(j < SAMPLES) w->samples[j] = ns;
+        }
+        w->calls++;
+        i++;
+    }
+    bench_keep(data);
+}
+
+static void runCase(Op op, int tasks, DMX & input, DMX & output)
+{
+    static Worker workers[MAX_TASKS];
+    std::vector<uint32_t> all;
+    std::vector<std::thread> threads;
+    uint32_t calls = 0;
+
+    for(int t = 0; t < tasks; t++)
+    {
+        workers[t].op = op;
+        workers[t].calls = 0;
+        workers[t].count = 0;
+        workers[t].random = 2463534242UL + t;
+        threads.emplace_back(work, &workers[t], std::ref(input), std::ref(output));
+    }
+
+    running = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(RUN_MS));
+    running = false;
+    for(std::thread & thread : threads) thread.join();
+
+    for(int t = 0; t < tasks; t++)
+    {
+        calls += workers[t].calls;
+        all.insert(all.end(), workers[t].samples, workers[t].samples + workers[t].count);
+    }
+    std::sort(all.begin(), all.end());
+    size_t n = all.size();
+    CHECK(n > 0);
+    if(n == 0) return;
+
+    DMXTxLatency latency = output.GetTxLatency();
+    printf("{\"bench\":\"contention\",\"op\":\"%s\",\"tasks\":%d,\"calls\":%u,\"calls_per_s\":%.0f,"
+           "\"p50_ns\":%u,\"p90_ns\":%u,\"p99_ns\":%u,\"max_ns\":%u,"
+           "\"tx_latency_avg_us\":%u,\"tx_latency_max_us\":%u,\"rx_frames\":%u}\n",
+           opNames[op], tasks, calls, calls * 1000.0 / RUN_MS,
+           all[n / 2], all[n * 9 / 10], all[n * 99 / 100], all[n - 1],
+           latency.avg_us, latency.max_us, input.GetRxCounters().frames);
+}
+
+int main()
+{
+    shim_uart_reset(IN_UART);
+    shim_uart_reset(OUT_UART);
+
+    DMXConfig inputConfig;
+    inputConfig.uart_num = IN_UART;
+    DMXConfig outputConfig;
+    outputConfig.uart_num = OUT_UART;
+    DMX input(inputConfig);
+    DMX output(outputConfig);
+    input.Initialize(DMX_DIR_INPUT);
+    output.Initialize(DMX_DIR_OUTPUT);
+
+    // the line follows the host clock: a frame every 23ms or so, whatever the workers do
+    std::atomic<bool> feeding(true);
+    std::thread line([&] {
+        UartSink sink(IN_UART, false);
+        LineSim sim(sink);
+        while(feeding) sim.Run(4, 512, [](uint32_t n, uint8_t * slots) { LinePattern(n, slots, 512); });
+        sim.Flush();
+    });
+
+    for(int op = 0; op < OP_COUNT; op++)
+    {
+        for(int tasks = 1; tasks <= MAX_TASKS; tasks *= 2)
+        {
+            runCase((Op) op, tasks, input, output);
+        }
+    }
+
+    feeding = false;
+    line.join();
+    CHECK(input.GetRxCounters().frames > 0);
+    TEST_END();
+}
@@ -0,0 +1,88 @@
+// Fixture profiles: decoding at absolute addresses on an input
+// listening to a window, refused reads leaving the fixture untouched, and the
+// cost of one profile Read against one DMX::Read per channel.
+#include "dmx.h"
+#include "dmx_fixture.h"
+#include "shim.h"
+#include "line_sim.h"
+#include "bench.h"
+#include "check.h"
+
+#define IN_UART                 UART_NUM_1
+#define WINDOW_START            101
+#define WINDOW_NB               32
+#define ITERATIONS              200000
+
+struct Spot
+{
+    uint16_t pan;
+    uint16_t tilt;
+    uint8_t dimmer;
+    DMXRGB color;
+};
+
+typedef DMXFixture<Spot,
+    DMXAttr16<Spot, 0, &Spot::pan>,
+    DMXAttr16<Spot, 2, &Spot::tilt>,
+    DMXAttr8<Spot, 4, &Spot::dimmer>,
+    DMXAttrRGB<Spot, 5, &Spot::color> > SpotProfile;
+
+int main()
+{
+    CHECK_EQ(SpotProfile::footprint, 8);
+
+    shim_uart_reset(IN_UART);
+    DMXConfig config;
+    config.uart_num = IN_UART;
+    config.rx_isr = true;
+    DMX dmx(config);
+    dmx.Initialize(DMX_DIR_INPUT, WINDOW_START, WINDOW_NB);
+    CHECK_EQ(dmx.GetDmxStartAdress(), WINDOW_START);
+    CHECK(shim_uart_wait_isr(IN_UART));
+
+    // channel ch of frame 9 is 9 + ch
+    {
+        IsrSink sink(IN_UART);
+        LineSim line(sink);
+        line.Run(10, 512, [](uint32_t n, uint8_t * slots) { LinePattern(n, slots, 512); });
+        line.Flush();
+    }
+    shim_real_time();
+
+    // the fixture patched at 105: channel 1 of the read buffer is 101
+    Spot spot;
+    CHECK(SpotProfile::Read(dmx, 105, spot));
+    CHECK_EQ(spot.pan, (114 << 8) | 115);
+    CHECK_EQ(spot.tilt, (116 << 8) | 117);
+    CHECK_EQ(spot.dimmer, 118);
+    CHECK_EQ(spot.color.b, 121);
+
+    // outside the window (before it, across its end) the fixture is left as it is
+    Spot untouched;
+    memset(&untouched, 0x5A, sizeof(untouched));
+    Spot copy = untouched;
+    CHECK(!SpotProfile::Read(dmx, 1, copy));
+    CHECK(!SpotProfile::Read(dmx, WINDOW_START + WINDOW_NB - 4, copy));
+    CHECK(memcmp(&copy, &untouched, sizeof(copy)) == 0);
+    CHECK(SpotProfile::Read(dmx, WINDOW_START + WINDOW_NB - 8, copy));
+
+    double profile = bench_run(ITERATIONS, [&](uint32_t) {
+        SpotProfile::Read(dmx, 105, spot);
+        bench_keep(spot);
+    });
+
+    // same attributes, one Read() per channel (window relative)
+    double reads = bench_run(ITERATIONS, [&](uint32_t) {
+        spot.pan = (dmx.Read(5) << 8) | dmx.Read(6);
+        spot.tilt = (dmx.Read(7) << 8) | dmx.Read(8);
+        spot.dimmer = dmx.Read(9);
+        spot.color.r = dmx.Read(10);
+        spot.color.g = dmx.Read(11);
+        spot.color.b = dmx.Read(12);
+        bench_keep(spot);
+    });
+
+    printf("{\"bench\":\"fixture\",\"channels\":%u,\"profile_ns\":%.1f,\"read_per_channel_ns\":%.1f}\n",
+           SpotProfile::footprint, profile, reads);
+    TEST_END();
+}
@@ -0,0 +1,72 @@
+// Cost of the chunk ingest of the receiver: a 513 bytes frame in
+// chunks of the rx fifo threshold, by the receiver and by the per byte loop
+// it replaced.
+#include <vector>
+
+#include "dmx_receiver.h"
+#include "bench.h"
+#include "check.h"
+
+#define FRAMES                  20000
+
+// the per byte loop of the original state machine, window 1..512
+struct ByteLoop
+{
+    uint8_t frame[513];
+    uint16_t addr;
+    bool zero;
+
+    void OnBreak() { addr = 0; zero = true; }
+    void OnData(const uint8_t * data, size_t size)
+    {
+        for(size_t i = 0; i < size; i++)
+        {
+            if(addr < 513) {
+                zero = zero && (data[i] == 0);
+                if(addr >= 1 && addr < 513) frame[addr] = data[i];
+                addr++;
+            }
+        }
+    }
+};
+
+int main()
+{
+    std::vector<uint8_t> wire(513);
+    for(uint16_t i = 1; i < 513; i++) wire[i] = (uint8_t) i;
+
+    for(uint16_t chunk : { 64, 96, 120 })
+    {
+        ByteLoop loop;
+        double reference = bench_run(FRAMES, [&](uint32_t) {
+            loop.OnBreak();
+            for(uint16_t sent = 0; sent < 513; sent += chunk) loop.OnData(wire.data() + sent, (513 - sent < chunk) ? 513 - sent : chunk);
+            bench_keep(loop.zero);
+        });
+
+        // only the OnData calls are timed, the commit at the break is the same in both versions
+        DMXReceiver receiver;
+        CHECK(receiver.Begin());
+        uint64_t ingest = ~0ULL;
+        for(int run = 0; run < 5; run++)
+        {
+            uint64_t total = 0;
+            for(uint32_t n = 0; n < FRAMES; n++)
+            {
+                receiver.OnBreak(n * 23000);
+                uint64_t start = bench_ns();
+                for(uint16_t sent = 0; sent < 513; sent += chunk) {
+                    receiver.OnData(wire.data() + sent, (513 - sent < chunk) ? 513 - sent : chunk, n * 23000 + 22000);
+                }
+                total += bench_ns() - start;
+            }
+            if(total < ingest) ingest = total;
+        }
+        // the bench_ns() calls around each frame are part of the figure
+        double current = (double) ingest / FRAMES;
+
+        CHECK(receiver.GetCounters().frames > 0);
+        printf("{\"bench\":\"ingest\",\"chunk\":%u,\"byte_loop_ns\":%.0f,\"receiver_ns\":%.0f}\n", chunk, reference, current);
+    }
+    TEST_END();
+}
@@ -0,0 +1,163 @@
+// HTP / LTP merge: the inputs refused by DMXMerger::Begin (a
+// window, a frame callback already used), two streamed inputs merged into a
+// smaller output and a merger deleted while they stream, the kernel against a
+// per channel reference, and its cost on a full universe.
+#include <atomic>
+#include <random>
+#include <thread>
+
+#include "dmx.h"
+#include "dmx_merge.h"
+#include "dmx_recorder.h"
+#include "shim.h"
+#include "line_sim.h"
+#include "bench.h"
+#include "check.h"
+
+#define ITERATIONS              200000
+
+// the merge as written per channel, with branches
+static void reference(uint8_t * out, const uint8_t * a, const uint8_t * b,
+                      const uint8_t * ltp, const uint8_t * owner, uint16_t n)
+{
+    for(uint16_t i = 0; i < n; i++)
+    {
+        if(ltp[i]) out[i] = owner[i] ? b[i] : a[i];
+        else out[i] = (a[i] > b[i]) ? a[i] : b[i];
+    }
+}
+
+static DMXConfig config(uart_port_t uart_num)
+{
+    DMXConfig config;
+    config.uart_num = uart_num;
+    config.rx_isr = true;
+    return config;
+}
+
+static void testBegin()
+{
+    for(uart_port_t uart : { UART_NUM_0, UART_NUM_1, UART_NUM_2 }) shim_uart_reset(uart);
+
+    DMX input_a(config(UART_NUM_0));
+    DMX window(config(UART_NUM_1));
+    DMX output(config(UART_NUM_2));
+    input_a.Initialize(DMX_DIR_INPUT);
+    window.Initialize(DMX_DIR_INPUT, 101, 16);
+    output.Initialize(DMX_DIR_OUTPUT);
+
+    // a window is refused, the other input is left free
+    DMXMerger refused(input_a, window, output);
+    CHECK(!refused.Begin());
+    CHECK(input_a.SetFrameCallback([](const uint8_t *, uint16_t, uint16_t, const uint32_t *, uint32_t, uint32_t, void *) {}));
+    CHECK(input_a.SetFrameCallback(nullptr));
+
+    // an input recorded can not be merged till the recorder stops, and the other way round
+    static uint8_t records[4096];
+    DMXRecorder recorder;
+    CHECK(recorder.Begin(input_a, records, sizeof(records)));
+    DMXMerger merger(input_a, input_a, output);
+    CHECK(!merger.Begin());
+    recorder.Stop();
+    CHECK(merger.Begin() == false);                         // both callbacks on the same input
+    CHECK(recorder.Begin(input_a, records, sizeof(records)));
+    recorder.Stop();
+}
+
+// a frame callback slow enough to be caught running
+static std::atomic<bool> inside(false);
+static std::atomic<uint32_t> entered(0);
+
+static void slowCallback(const uint8_t *, uint16_t, uint16_t, const uint32_t *, uint32_t, uint32_t, void *)
+{
+    inside = true;
+    entered++;
+    vTaskDelay(2);
+    inside = false;
+}
+
+static void testStream()
+{
+    for(uart_port_t uart : { UART_NUM_0, UART_NUM_1, UART_NUM_2 }) shim_uart_reset(uart);
+
+    DMX input_a(config(UART_NUM_0));
+    DMX input_b(config(UART_NUM_1));
+    static DMXUniverse<DMX_DIR_OUTPUT, 64> output(config(UART_NUM_2));
+    input_a.Initialize(DMX_DIR_INPUT);
+    input_b.Initialize(DMX_DIR_INPUT);
+    output.Initialize();
+    CHECK(shim_uart_wait_isr(UART_NUM_0));
+    CHECK(shim_uart_wait_isr(UART_NUM_1));
+
+    // both lines at wire speed: a sends 0x40 everywhere, b the channel number
+    std::atomic<bool> feeding(true);
+    std::thread line_a([&] {
+        IsrSink sink(UART_NUM_0, false);
+        LineSim line(sink);
+        while(feeding) line.Run(2, 512, [](uint32_t, uint8_t * slots) { memset(slots, 0x40, 512); });
+        line.Flush();
+    });
+    std::thread line_b([&] {
+        IsrSink sink(UART_NUM_1, false);
+        LineSim line(sink);
+        while(feeding) line.Run(2, 512, [](uint32_t, uint8_t * slots) { for(uint16_t i = 0; i < 512; i++) slots[i] = (uint8_t) (i + 1); });
+        line.Flush();
+    });
+
+    // an output smaller than the universe gets its first channels, highest takes precedence
+    DMXMerger * merger = new DMXMerger(input_a, input_b, output);
+    CHECK(merger->Begin());
+    for(int ms = 0; ms < 1000 && output.Read(64) != 64; ms++) vTaskDelay(1);
+    CHECK_EQ(output.Read(1), 0x40);
+    CHECK_EQ(output.Read(64), 64);
+
+    // the merger goes away while the inputs keep calling it
+    delete merger;
+
+    // removed, a callback is not running any more
+    for(int i = 0; i < 10; i++)
+    {
+        uint32_t before = entered;
+        CHECK(input_a.SetFrameCallback(slowCallback));
+        while(entered == before) vTaskDelay(1);
+        CHECK(input_a.SetFrameCallback(nullptr));
+        CHECK(!inside);
+    }
+
+    feeding = false;
+    line_a.join();
+    line_b.join();
+}
+
+int main()
+{
+    testBegin();
+    testStream();
+
+    std::mt19937 random(5);
+    uint8_t a[512], b[512], ltp[512], owner[512], out[512], expected[512];
+    for(uint16_t i = 0; i < 512; i++)
+    {
+        a[i] = random();
+        b[i] = random();
+        ltp[i] = (random() & 1) ? 0xFF : 0;
+        owner[i] = (random() & 1) ? 0xFF : 0;
+    }
+    DMXMerger::Merge(out, a, b, ltp, owner, 512);
+    reference(expected, a, b, ltp, owner, 512);
+    CHECK(memcmp(out, expected, 512) == 0);
+
+    double kernel = bench_run(ITERATIONS, [&](uint32_t i) {
+        a[i & 511] = (uint8_t) i;
+        DMXMerger::Merge(out, a, b, ltp, owner, 512);
+        bench_keep(out[0]);
+    });
+    double branches = bench_run(ITERATIONS, [&](uint32_t i) {
+        a[i & 511] = (uint8_t) i;
+        reference(out, a, b, ltp, owner, 512);
+        bench_keep(out[0]);
+    });
+
+    printf("{\"bench\":\"merge\",\"slots\":512,\"kernel_ns\":%.0f,\"per_channel_ns\":%.0f}\n", kernel, branches);
+    TEST_END();
+}
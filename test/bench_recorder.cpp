@@ -0,0 +1,55 @@
+// Cost of the recorder encoding: one 512 slots frame with 1, 16
+// and 512 channels changed, encoded from the changed channels bitmap, and the
+// compression ratio of the records.
+#include <random>
+#include <vector>
+
+#include "dmx_recorder.h"
+#include "bench.h"
+#include "check.h"
+
+#define FRAMES                  20000
+
+int main()
+{
+    std::mt19937 random(9);
+    static uint8_t storage[1 << 16];
+    std::vector<uint8_t> drain(sizeof(storage));
+
+    for(uint16_t changes : { 1, 16, 512 })
+    {
+        DMXRecorder recorder;
+        CHECK(recorder.Begin(storage, sizeof(storage)));
+        uint8_t frame[513] = { 0 };
+        uint32_t dirty[DMX_FRAME_DIRTY_WORDS];
+        uint64_t best = ~0ULL;
+        DMXRecorderStats stats = {};
+
+        for(int run = 0; run < 5; run++)
+        {
+            uint64_t total = 0;
+            for(uint32_t n = 0; n < FRAMES; n++)
+            {
+                memset(dirty, 0, sizeof(dirty));
+                for(uint16_t c = 0; c < changes; c++)
+                {
+                    uint16_t ch = (changes == 512) ? c + 1 : 1 + random() % 512;
+                    frame[ch] = (uint8_t) random();
+                    dirty[ch >> 5] |= (uint32_t) 1 << (ch & 31);
+                }
+
+                uint64_t start = bench_ns();
+                recorder.OnFrame(frame, 1, 512, dirty, n * 23000);
+                total += bench_ns() - start;
+                recorder.Read(drain.data(), recorder.Available());
+            }
+            if(total < best) best = total;
+            stats = recorder.GetStats();
+        }
+
+        CHECK_EQ(stats.dropped, 0);
+        printf("{\"bench\":\"recorder\",\"changes\":%u,\"encode_ns\":%.0f,\"ratio\":%.1f}\n",
+               changes, (double) best / FRAMES, stats.Ratio());
+    }
+    TEST_END();
+}
@@ -0,0 +1,149 @@
+// Cut-through repeater: the frames of the input come out whole on
+// the output wire with the overrides applied, End gives the output uart back,
+// also while the line streams, and the latency of one hop in line time against
+// the frame a store and forward repeater waits for, for several rx fifo
+// thresholds.
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "dmx.h"
+#include "dmx_repeater.h"
+#include "shim.h"
+#include "line_sim.h"
+#include "check.h"
+
+#define IN_UART                 UART_NUM_1
+#define OUT_UART                UART_NUM_2
+#define FRAMES                  20
+#define OVERRIDE                10
+
+static void run(uint8_t threshold)
+{
+    shim_uart_reset(IN_UART);
+    shim_uart_reset(OUT_UART);
+
+    DMXConfig config;
+    config.uart_num = IN_UART;
+    config.rx_full_threshold = threshold;
+    DMX input(config);
+    input.Initialize(DMX_DIR_INPUT);
+
+    DMXConfig output;
+    output.uart_num = OUT_UART;
+    output.dir_pin = -1;
+    DMXRepeater repeater(input);
+    CHECK(repeater.AddOutput(output));
+    CHECK(repeater.Begin());
+    CHECK(shim_uart_installed(OUT_UART));
+    repeater.SetOverride(OVERRIDE, 0xEE);
+
+    // in lock step the shim time is the line time, each chunk is forwarded before the next one
+    LineConfig line_config;
+    line_config.chunk = threshold;
+    int64_t frame_us;
+    {
+        UartSink sink(IN_UART);
+        LineSim line(sink, line_config);
+        line.Run(FRAMES, 512, [](uint32_t n, uint8_t * slots) { LinePattern(n, slots, 512); });
+        frame_us = line.Now() / FRAMES;
+        line.Flush();
+    }
+
+    // each frame ends with the break regenerated at the next input break
+    std::vector<ShimWireFrame> frames = shim_uart_take_frames(OUT_UART);
+    CHECK_EQ(frames.size(), FRAMES);
+    uint8_t expected[513];
+    for(size_t n = 0; n < frames.size(); n++)
+    {
+        expected[0] = 0;
+        LinePattern(n, expected + 1, 512);
+        expected[OVERRIDE] = 0xEE;
+        CHECK_EQ(frames[n].data.size(), 513);
+        CHECK(frames[n].break_bits > 0);
+        CHECK(memcmp(frames[n].data.data(), expected, 513) == 0);
+    }
+
+    DMXRepeaterStats stats = repeater.GetStats();
+    CHECK_EQ(stats.frames, FRAMES);
+    CHECK_EQ(stats.slots, FRAMES * 513);
+    CHECK(stats.max_us < frame_us);
+
+    repeater.End();
+    CHECK(!shim_uart_installed(OUT_UART));
+    shim_real_time();
+
+    // hand off latency of the oldest slot of each chunk; a store and forward hop adds a whole frame
+    printf("{\"bench\":\"repeater\",\"threshold\":%u,\"avg_us\":%u,\"max_us\":%u,\"store_forward_us\":%lld}\n",
+           threshold, stats.avg_us, stats.max_us, (long long) frame_us);
+}
+
+// a slots callback slow enough to be caught running
+static std::atomic<bool> inside(false);
+static std::atomic<uint32_t> entered(0);
+
+static void slowCallback(uint16_t, const uint8_t *, uint16_t, uint32_t, void *)
+{
+    inside = true;
+    entered++;
+    vTaskDelay(1);
+    inside = false;
+}
+
+// repeaters stopped while the line streams: nothing is forwarded once End returns
+static void testEnd()
+{
+    shim_uart_reset(IN_UART);
+    shim_uart_reset(OUT_UART);
+
+    DMXConfig config;
+    config.uart_num = IN_UART;
+    DMX input(config);
+    input.Initialize(DMX_DIR_INPUT);
+
+    std::atomic<bool> feeding(true);
+    std::thread line([&] {
+        UartSink sink(IN_UART, false);
+        LineSim sim(sink);
+        while(feeding) sim.Run(2, 512, [](uint32_t n, uint8_t * slots) { LinePattern(n, slots, 512); });
+        sim.Flush();
+    });
+
+    DMXConfig output;
+    output.uart_num = OUT_UART;
+    output.dir_pin = -1;
+    for(int i = 0; i < 5; i++)
+    {
+        DMXRepeater repeater(input);
+        CHECK(repeater.AddOutput(output));
+        CHECK(repeater.Begin());
+        for(int ms = 0; ms < 1000 && repeater.GetStats().frames < 2; ms++) vTaskDelay(1);
+        CHECK(repeater.GetStats().frames >= 2);
+
+        repeater.End();
+        uint32_t slots = repeater.GetStats().slots;
+        CHECK(!shim_uart_installed(OUT_UART));
+        vTaskDelay(pdMS_TO_TICKS(30));
+        CHECK_EQ(repeater.GetStats().slots, slots);
+    }
+
+    // removed, a callback is not running any more
+    for(int i = 0; i < 10; i++)
+    {
+        uint32_t before = entered;
+        CHECK(input.SetSlotsCallback(slowCallback));
+        while(entered == before) vTaskDelay(1);
+        CHECK(input.SetSlotsCallback(nullptr));
+        CHECK(!inside);
+    }
+
+    feeding = false;
+    line.join();
+}
+
+int main()
+{
+    testEnd();
+    for(uint8_t threshold : { 120, 32, 8 }) run(threshold);
+    TEST_END();
+}
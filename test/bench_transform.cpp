@@ -0,0 +1,271 @@
+// Curves on frame commit: received frames transformed once at
+// their commit (8 and 16 bit curves), a short frame cut inside a 16 bit pair
+// keeping the last pair, frames sent through a transform swapped at run time
+// coming out whole with one transform or the other, a transform released as
+// soon as SetTransform returns on an output and an input, and the cost of
+// Apply on 512 slots against the curves applied per channel after Read().
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "dmx.h"
+#include "dmx_transform.h"
+#include "shim.h"
+#include "line_sim.h"
+#include "bench.h"
+#include "check.h"
+
+#define IN_UART                 UART_NUM_1
+#define OUT_UART                UART_NUM_2
+#define WIDE                    32          // 16 bit curves on channels 1, 3 ... 63
+#define ITERATIONS              100000
+
+static uint8_t gamma8[256];
+static uint16_t gamma16[256];
+
+static void testInput()
+{
+    shim_uart_reset(IN_UART);
+    DMXConfig config;
+    config.uart_num = IN_UART;
+    config.rx_isr = true;
+    DMX dmx(config);
+    dmx.Initialize(DMX_DIR_INPUT);
+    CHECK(shim_uart_wait_isr(IN_UART));
+
+    static DMXTransform curves;
+    curves.SetCurve(1, 512, gamma8);
+    CHECK(curves.SetCurve16(100, gamma16));
+    dmx.SetTransform(&curves);
+
+    {
+        IsrSink sink(IN_UART);
+        LineSim line(sink);
+        line.Run(10, 512, [](uint32_t n, uint8_t * slots) { LinePattern(n, slots, 512); });
+        line.Flush();
+    }
+    shim_real_time();
+
+    // frame 9: channel ch received as 9 + ch
+    uint8_t received[512];
+    LinePattern(9, received, 512);
+    for(uint16_t ch = 1; ch <= 512; ch++)
+    {
+        if(ch == 100 || ch == 101) continue;
+        CHECK_EQ(dmx.Read(ch), gamma8[received[ch - 1]]);
+    }
+    CHECK_EQ(dmx.Read(100), gamma16[received[99]] >> 8);
+    CHECK_EQ(dmx.Read(101), gamma16[received[99]] & 0xFF);
+    dmx.SetTransform(nullptr);
+}
+
+// a short frame ending on the coarse channel: the pair of the last whole frame stays
+static void testShort()
+{
+    shim_uart_reset(IN_UART);
+    DMXConfig config;
+    config.uart_num = IN_UART;
+    config.rx_isr = true;
+    DMX dmx(config);
+    dmx.Initialize(DMX_DIR_INPUT);
+    CHECK(shim_uart_wait_isr(IN_UART));
+
+    static DMXTransform curves;
+    CHECK(curves.SetCurve16(100, gamma16));
+    CHECK_EQ(curves.Whole(1, 100), 99);
+    CHECK_EQ(curves.Whole(1, 101), 101);
+    dmx.SetTransform(&curves);
+
+    uint8_t whole[512], cut[512];
+    LinePattern(0, whole, 512);
+    LinePattern(1, cut, 100);
+    {
+        IsrSink sink(IN_UART);
+        LineSim line(sink);
+        line.Run(1, 512, [](uint32_t, uint8_t * slots) { LinePattern(0, slots, 512); });
+        line.Run(1, 100, [](uint32_t, uint8_t * slots) { LinePattern(1, slots, 100); });
+        line.Flush();
+    }
+    shim_real_time();
+
+    CHECK_EQ(dmx.GetFrameSequence(), 2);
+    CHECK_EQ(dmx.Read(99), cut[98]);
+    CHECK_EQ(dmx.Read(100), gamma16[whole[99]] >> 8);
+    CHECK_EQ(dmx.Read(101), gamma16[whole[99]] & 0xFF);
+    CHECK_EQ(dmx.Read(102), whole[101]);
+    dmx.SetTransform(nullptr);
+}
+
+static void testSwap()
+{
+    shim_uart_reset(OUT_UART);
+    DMXConfig config;
+    config.uart_num = OUT_UART;
+    DMX dmx(config);
+    dmx.Initialize(DMX_DIR_OUTPUT);
+
+    // every slot 0x11 with one, 0x22 with the other
+    static uint8_t ones[256], twos[256];
+    memset(ones, 0x11, sizeof(ones));
+    memset(twos, 0x22, sizeof(twos));
+    static DMXTransform a, b;
+    a.SetCurve(1, 512, ones);
+    b.SetCurve(1, 512, twos);
+
+    std::atomic<bool> swapping(true);
+    std::thread swapper([&] {
+        for(uint32_t i = 0; swapping; i++)
+        {
+            dmx.SetTransform((i & 1) ? &b : &a);
+            std::this_thread::yield();
+        }
+    });
+    shim_uart_take_frames(OUT_UART);
+    CHECK(shim_uart_wait_frames(OUT_UART, 10));
+    swapping = false;
+    swapper.join();
+
+    // the written values are left alone, each frame went through a single transform
+    CHECK_EQ(dmx.Read(1), 0);
+    std::vector<ShimWireFrame> frames = shim_uart_take_frames(OUT_UART);
+    CHECK(frames.size() >= 10);
+    for(const ShimWireFrame & frame : frames)
+    {
+        if(frame.data.size() == 1) continue;                // the lone start code opening the line
+        CHECK_EQ(frame.data.size(), 513);
+        uint8_t first = frame.data[1];
+        CHECK(first == 0x11 || first == 0x22);
+        size_t same = 1;
+        while(same < frame.data.size() && frame.data[same] == first) same++;
+        CHECK_EQ(same, frame.data.size());
+    }
+    dmx.SetTransform(nullptr);
+}
+
+// the table of a transform replaced is trashed as soon as SetTransform returns: no frame shows it
+static uint8_t trash[256], kept[256];
+
+static bool trashed(const uint8_t * frame, uint16_t nb)
+{
+    for(uint16_t i = 1; i <= nb; i++) if(frame[i] == 0x33) return true;
+    return false;
+}
+
+static void testRelease()
+{
+    memset(kept, 0x22, sizeof(kept));
+    static DMXTransform a, b;
+    a.SetCurve(1, 512, trash);
+    b.SetCurve(1, 512, kept);
+
+    // output: the frames on the wire, a slow tx callback runs between the load of the curves and their use
+    shim_uart_reset(OUT_UART);
+    DMXConfig config;
+    config.uart_num = OUT_UART;
+    {
+        DMX dmx(config);
+        dmx.Initialize(DMX_DIR_OUTPUT);
+        static std::atomic<uint32_t> calls(0);
+        dmx.SetTxCallback([](uint8_t *, uint16_t, uint32_t, void *) { calls++; vTaskDelay(5); });
+        shim_uart_take_frames(OUT_UART);
+        for(int i = 0; i < 10; i++)
+        {
+            // replaced while the send task is in the callback of a frame going through a
+            memset(trash, 0x11, sizeof(trash));
+            dmx.SetTransform(&a);
+            uint32_t before = calls;
+            while(calls < before + 2) vTaskDelay(1);
+            dmx.SetTransform(&b);
+            memset(trash, 0x33, sizeof(trash));
+        }
+        dmx.SetTransform(nullptr);
+        dmx.SetTxCallback(nullptr);
+        uint32_t bad = 0;
+        for(const ShimWireFrame & frame : shim_uart_take_frames(OUT_UART))
+        {
+            if(trashed(frame.data.data(), frame.data.size() - 1)) bad++;
+        }
+        CHECK_EQ(bad, 0);
+    }
+
+    // input in interrupt mode: the frames committed, seen by the frame callback
+    shim_uart_reset(IN_UART);
+    config.uart_num = IN_UART;
+    config.rx_isr = true;
+    DMX dmx(config);
+    dmx.Initialize(DMX_DIR_INPUT);
+    CHECK(shim_uart_wait_isr(IN_UART));
+
+    static std::atomic<uint32_t> frames(0), bad(0);
+    CHECK(dmx.SetFrameCallback([](const uint8_t * frame, uint16_t, uint16_t nb, const uint32_t *, uint32_t, uint32_t, void *) {
+        frames++;
+        if(trashed(frame, nb)) bad++;
+    }));
+
+    std::atomic<bool> feeding(true);
+    std::thread line([&] {
+        IsrSink sink(IN_UART, false);
+        LineSim sim(sink);
+        while(feeding) sim.Run(2, 512, [](uint32_t n, uint8_t * slots) { LinePattern(n, slots, 512); });
+        sim.Flush();
+    });
+    for(int i = 0; i < 20; i++)
+    {
+        uint32_t before = frames;
+        memset(trash, 0x11, sizeof(trash));
+        dmx.SetTransform(&a);
+        while(frames == before) vTaskDelay(1);
+        dmx.SetTransform(&b);
+        memset(trash, 0x33, sizeof(trash));
+    }
+    feeding = false;
+    line.join();
+    dmx.SetTransform(nullptr);
+    CHECK(dmx.SetFrameCallback(nullptr));
+    CHECK_EQ(bad, 0);
+}
+
+int main()
+{
+    DMXTransform::Gamma(gamma8, 2.2f);
+    DMXTransform::Gamma16(gamma16, 2.2f);
+
+    testInput();
+    testShort();
+    testSwap();
+    testRelease();
+
+    // cost on a full frame, with and without 16 bit curves
+    static DMXTransform curves;
+    curves.SetCurve(1, 512, gamma8);
+    uint8_t frame[513];
+    for(uint16_t i = 0; i < 513; i++) frame[i] = (uint8_t) i;
+    double flat = bench_run(ITERATIONS, [&](uint32_t i) {
+        frame[1 + (i & 511)] = (uint8_t) i;
+        curves.Apply(frame, 1, 512);
+        bench_keep(frame[1]);
+    });
+    for(uint16_t ch = 1; ch < 2 * WIDE; ch += 2) CHECK(curves.SetCurve16(ch, gamma16));
+    double wide = bench_run(ITERATIONS, [&](uint32_t i) {
+        frame[1 + (i & 511)] = (uint8_t) i;
+        curves.Apply(frame, 1, 512);
+        bench_keep(frame[1]);
+    });
+
+    // the application code it replaces: one Read() and one lookup per channel
+    shim_uart_reset(IN_UART);
+    DMXConfig config;
+    config.uart_num = IN_UART;
+    config.rx_isr = true;
+    DMX dmx(config);
+    dmx.Initialize(DMX_DIR_INPUT);
+    uint8_t values[512];
+    double reads = bench_run(ITERATIONS / 10, [&](uint32_t) {
+        for(uint16_t ch = 1; ch <= 512; ch++) values[ch - 1] = gamma8[dmx.Read(ch)];
+        bench_keep(values);
+    });
+
+    printf("{\"bench\":\"transform\",\"slots\":512,\"apply_ns\":%.0f,\"apply_wide_ns\":%.0f,\"wide\":%d,\"read_per_channel_ns\":%.0f}\n",
+           flat, wide, WIDE, reads);
+    TEST_END();
+}
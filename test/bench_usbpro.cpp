@@ -0,0 +1,237 @@
+// Enttec DMX USB Pro widget on a pseudo-terminal: the widget task
+// on the slave side, the host on the master side. Nothing but messages of the
+// protocol reaches the host when the log of the library is the port, an input
+// not listening to the whole universe is refused, a length above
+// DMX_PRO_MAX_DATA is rejected at once, and the frame rates both ways.
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <thread>
+#include <vector>
+
+#include "dmx.h"
+#include "dmx_usbpro.h"
+#include "shim.h"
+#include "line_sim.h"
+#include "bench.h"
+#include "check.h"
+
+#define IN_UART                 UART_NUM_1
+#define OUT_UART                UART_NUM_2
+#define HOST_FRAMES             200
+#define LINE_FRAMES             40
+#define ITERATIONS              100000
+
+// the slave side of the pty as the serial port of the widget
+class PtyStream : public Stream
+{
+    public:
+        PtyStream(int fd) : fd(fd) {}
+
+        int available()
+        {
+            int n = 0;
+            return (ioctl(fd, FIONREAD, &n) == 0) ? n : 0;
+        }
+        int read()
+        {
+            uint8_t c;
+            return (::read(fd, &c, 1) == 1) ? c : -1;
+        }
+        size_t readBytes(uint8_t * buffer, size_t length)
+        {
+            ssize_t n = ::read(fd, buffer, length);
+            return (n > 0) ? n : 0;
+        }
+        size_t write(uint8_t c) { return write(&c, 1); }
+        size_t write(const uint8_t * buffer, size_t size)
+        {
+            size_t n = 0;
+            while(n < size)
+            {
+                ssize_t w = ::write(fd, buffer + n, size - n);
+                if(w <= 0) break;
+                n += w;
+            }
+            return n;
+        }
+
+    private:
+        int fd;
+};
+
+// what the host gets back: whole messages, or garbage
+struct HostReader
+{
+    int fd;
+    std::vector<uint8_t> bytes;
+
+    // reads for at most timeout_ms, returns the complete messages of label (their data)
+    std::vector<std::vector<uint8_t>> take(uint8_t label, size_t count, int timeout_ms, uint32_t * garbage)
+    {
+        std::vector<std::vector<uint8_t>> messages;
+        int64_t end = esp_timer_get_time() + timeout_ms * 1000LL;
+        while(messages.size() < count)
+        {
+            struct pollfd p = { fd, POLLIN, 0 };
+            int left = (int) ((end - esp_timer_get_time()) / 1000);
+            if((left <= 0) || (poll(&p, 1, left) <= 0)) break;
+            uint8_t buffer[4096];
+            ssize_t n = ::read(fd, buffer, sizeof(buffer));
+            if(n > 0) bytes.insert(bytes.end(), buffer, buffer + n);
+
+            // SOM, label, length, data, EOM
+            size_t pos = 0;
+            while(bytes.size() - pos >= 5)
+            {
+                uint16_t length = bytes[pos + 2] | (bytes[pos + 3] << 8);
+                if(bytes[pos] != DMX_PRO_SOM) { (*garbage)++; pos++; continue; }
+                if(bytes.size() - pos < 5u + length) break;
+                if(bytes[pos + 4 + length] != DMX_PRO_EOM) { (*garbage)++; pos++; continue; }
+                if(bytes[pos + 1] == label) messages.emplace_back(bytes.begin() + pos + 4, bytes.begin() + pos + 4 + length);
+                pos += 5 + length;
+            }
+            bytes.erase(bytes.begin(), bytes.begin() + pos);
+        }
+        return messages;
+    }
+};
+
+static std::vector<uint8_t> message(uint8_t label, const uint8_t * data, uint16_t size)
+{
+    std::vector<uint8_t> m(5 + size);
+    m[0] = DMX_PRO_SOM;
+    m[1] = label;
+    m[2] = size & 0xFF;
+    m[3] = size >> 8;
+    if(size > 0) memcpy(m.data() + 4, data, size);
+    m[4 + size] = DMX_PRO_EOM;
+    return m;
+}
+
+static void hostWrite(int fd, const std::vector<uint8_t> & bytes)
+{
+    size_t n = 0;
+    while(n < bytes.size())
+    {
+        ssize_t w = ::write(fd, bytes.data() + n, bytes.size() - n);
+        if(w > 0) n += w;
+        else vTaskDelay(1);
+    }
+}
+
+static DMXConfig config(uart_port_t uart_num, bool isr)
+{
+    DMXConfig config;
+    config.uart_num = uart_num;
+    config.rx_isr = isr;
+    return config;
+}
+
+int main()
+{
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    CHECK(master >= 0);
+    CHECK(grantpt(master) == 0 && unlockpt(master) == 0);
+    int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+    CHECK(slave >= 0);
+    struct termios raw;
+    tcgetattr(slave, &raw);
+    cfmakeraw(&raw);
+    tcsetattr(slave, TCSANOW, &raw);
+
+    shim_uart_reset(IN_UART);
+    shim_uart_reset(OUT_UART);
+    DMX input(config(IN_UART, true));
+    DMX output(config(OUT_UART, false));
+    input.Initialize(DMX_DIR_INPUT);
+    output.Initialize(DMX_DIR_OUTPUT);
+    CHECK(shim_uart_wait_isr(IN_UART));
+
+    // an input listening to a part of the universe is refused
+    PtyStream port(slave);
+    input.SetDmxNbChannels(256);
+    DMXUsbPro partial(port, &output, &input);
+    CHECK(!partial.Begin());
+    input.SetDmxNbChannels(512);
+
+    // the port is the log: silenced while the widget runs, even for errors
+    DMX::SetLog(&port);
+    DMXUsbPro widget(port, &output, &input);
+    widget.SetSerialNumber(0x12345678);
+    CHECK(widget.Begin());
+    CHECK(DMX::GetLog() == nullptr);
+    CHECK(input.SetFrameCallback([](const uint8_t *, uint16_t, uint16_t, const uint32_t *, uint32_t, uint32_t, void *) {}));
+    CHECK(!input.SetFrameCallback([](const uint8_t *, uint16_t, uint16_t, const uint32_t *, uint32_t, uint32_t, void *) {}));
+    CHECK(input.SetFrameCallback(nullptr));
+
+    HostReader host = { master, {} };
+    uint32_t garbage = 0;
+
+    // a length too long for the widget is rejected at once, the next message is handled
+    static const uint8_t oversized[] = { DMX_PRO_SOM, DMX_PRO_TX_DMX, 0xFF, 0xFF, 0x00, 0x11, 0x22 };
+    hostWrite(master, std::vector<uint8_t>(oversized, oversized + sizeof(oversized)));
+    hostWrite(master, message(DMX_PRO_GET_SERIAL, nullptr, 0));
+    std::vector<std::vector<uint8_t>> serial = host.take(DMX_PRO_GET_SERIAL, 1, 1000, &garbage);
+    CHECK_EQ(serial.size(), 1);
+    if(serial.size() == 1) CHECK_EQ(serial[0][3], 0x12);
+    CHECK_EQ(widget.GetStats().invalid, 1);
+    CHECK_EQ(widget.GetStats().messages, 1);
+
+    // host to dmx: frames as fast as the pty takes them
+    std::vector<uint8_t> frames;
+    uint8_t frame[513];
+    for(uint32_t n = 0; n < HOST_FRAMES; n++)
+    {
+        frame[0] = 0;
+        LinePattern(n, frame + 1, 512);
+        std::vector<uint8_t> m = message(DMX_PRO_TX_DMX, frame, sizeof(frame));
+        frames.insert(frames.end(), m.begin(), m.end());
+    }
+    uint64_t start = bench_ns();
+    hostWrite(master, frames);
+    for(int ms = 0; ms < 2000 && widget.GetStats().frames_out < HOST_FRAMES; ms++) vTaskDelay(1);
+    double host_fps = HOST_FRAMES * 1e9 / (bench_ns() - start);
+    CHECK_EQ(widget.GetStats().frames_out, HOST_FRAMES);
+    for(uint16_t ch = 1; ch <= 512; ch++) CHECK_EQ(output.Read(ch), frame[ch]);
+
+    // dmx to host: every frame of the line, at wire speed
+    uint32_t sent = widget.GetStats().frames_in;
+    std::thread feed([] {
+        IsrSink sink(IN_UART, false);
+        LineSim line(sink);
+        line.Run(LINE_FRAMES, 512, [](uint32_t n, uint8_t * slots) { LinePattern(n, slots, 512); });
+        line.Flush();
+    });
+    std::vector<std::vector<uint8_t>> received = host.take(DMX_PRO_RX_DMX, LINE_FRAMES, 3000, &garbage);
+    feed.join();
+    for(int ms = 0; ms < 100 && widget.GetStats().frames_in - sent < LINE_FRAMES; ms++) vTaskDelay(1);    // counted once sent
+    CHECK_EQ(received.size(), LINE_FRAMES);
+    CHECK_EQ(widget.GetStats().frames_in - sent, LINE_FRAMES);
+    if(!received.empty()) {
+        CHECK_EQ(received.back().size(), 514);
+        CHECK_EQ(received.back()[2], (uint8_t) (LINE_FRAMES - 1 + 1));
+    }
+    CHECK_EQ(garbage, 0);
+
+    widget.End();
+    CHECK(DMX::GetLog() == &port);
+    DMX::SetLog(&Serial);
+
+    // parsing and committing one frame, without the task
+    DMXUsbPro direct(port, &output);
+    std::vector<uint8_t> one = message(DMX_PRO_TX_DMX, frame, sizeof(frame));
+    double parse = bench_run(ITERATIONS, [&](uint32_t i) {
+        bench_keep(direct.HandleData(one.data(), one.size(), i));
+    });
+    CHECK_EQ(direct.GetStats().frames_out, 5 * ITERATIONS);
+
+    printf("{\"bench\":\"usbpro\",\"slots\":512,\"parse_commit_ns\":%.0f,\"host_to_dmx_fps\":%.0f,\"dmx_to_host_frames\":%u}\n",
+           parse, host_fps, (unsigned) received.size());
+
+    close(slave);
+    close(master);
+    TEST_END();
+}
@@ -0,0 +1,31 @@
+// Minimal checks for the host tests: a failed CHECK is printed and makes the
+// test exit with an error, TEST_END() returns the status from main().
+#pragma once
+
+#include <stdio.h>
+
+static int check_failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if(!(condition)) { \
+            check_failures++; \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+        } \
+    } while(0)
+
+#define CHECK_EQ(a, b) \
+    do { \
+        long long check_a = (long long) (a), check_b = (long long) (b); \
+        if(check_a != check_b) { \
+            check_failures++; \
+            fprintf(stderr, "%s:%d: CHECK failed: %s == %s (%lld != %lld)\n", __FILE__, __LINE__, #a, #b, check_a, check_b); \
+        } \
+    } while(0)
+
+#define TEST_END() \
+    do { \
+        if(check_failures) fprintf(stderr, "%d check(s) failed\n", check_failures); \
+        else printf("ok\n"); \
+        return check_failures ? 1 : 0; \
+    } while(0)
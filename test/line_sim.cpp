@@ -0,0 +1,220 @@
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <string.h>
+
+#include "esp_timer.h"
+#include "hal/uart_ll.h"
+#include "shim.h"
+#include "line_sim.h"
+
+#define LINE_RDM_SIZE           26          // RDM packet sent before a frame, start code included
+
+//*****************************************************************************
+//** Sinks                                                                   **
+//*****************************************************************************
+void ReceiverSink::Break(int64_t now_us)
+{
+    receiver.OnEvent();
+    receiver.OnBreak((uint32_t) now_us);
+}
+
+void ReceiverSink::Data(const uint8_t * data, size_t size, int64_t now_us, bool)
+{
+    receiver.OnEvent();
+    receiver.OnData(data, size, (uint32_t) now_us);
+}
+
+void ReceiverSink::Error(int64_t)
+{
+    receiver.OnEvent();
+    receiver.OnError();
+}
+
+// waits for the host clock to reach the line time now_us
+static void pace(int64_t offset_us, int64_t now_us)
+{
+    int64_t wait = offset_us + now_us - esp_timer_get_time();
+    if(wait > 0) std::this_thread::sleep_for(std::chrono::microseconds(wait));
+}
+
+UartSink::UartSink(uart_port_t uart_num, bool lockstep) :
+    uart_num(uart_num),
+    lockstep(lockstep),
+    offset_us(esp_timer_get_time()),
+    lost(0)
+{
+}
+
+void UartSink::post(uart_event_type_t type, const uint8_t * data, size_t size, int64_t now_us)
+{
+    if(lockstep) shim_set_time(now_us);
+    else pace(offset_us, now_us);
+
+    if(!shim_uart_post(uart_num, type, data, size)) lost++;
+    if(lockstep) shim_uart_wait_rx_idle(uart_num);
+}
+
+void UartSink::Break(int64_t now_us)
+{
+    post(UART_BREAK, nullptr, 0, now_us);
+}
+
+void UartSink::Data(const uint8_t * data, size_t size, int64_t now_us, bool)
+{
+    post(UART_DATA, data, size, now_us);
+}
+
+void UartSink::Error(int64_t now_us)
+{
+    post(UART_FRAME_ERR, nullptr, 0, now_us);
+}
+
+IsrSink::IsrSink(uart_port_t uart_num, bool lockstep) :
+    uart_num(uart_num),
+    lockstep(lockstep),
+    offset_us(esp_timer_get_time())
+{
+}
+
+void IsrSink::at(int64_t now_us)
+{
+    if(lockstep) shim_set_time(now_us);
+    else pace(offset_us, now_us);
+}
+
+void IsrSink::Break(int64_t now_us)
+{
+    // the break goes into the fifo as a 0
+    static const uint8_t zero = 0;
+    at(now_us);
+    shim_uart_interrupt(uart_num, UART_INTR_BRK_DET, &zero, 1);
+}
+
+void IsrSink::Data(const uint8_t * data, size_t size, int64_t now_us, bool timeout)
+{
+    at(now_us);
+    shim_uart_interrupt(uart_num, timeout ? UART_INTR_RXFIFO_TOUT : 0, data, size);
+}
+
+void IsrSink::Error(int64_t now_us)
+{
+    at(now_us);
+    shim_uart_interrupt(uart_num, UART_INTR_FRAM_ERR);
+}
+
+//*****************************************************************************
+//** Line                                                                    **
+//*****************************************************************************
+LineSim::LineSim(LineSink & sink, const LineConfig & config) :
+    sink(sink),
+    config(config),
+    random(config.seed),
+    now_us(0)
+{
+    memset(&counters, 0, sizeof(counters));
+}
+
+bool LineSim::chance(double rate)
+{
+    return (rate > 0) && (std::uniform_real_distribution<double>(0, 1)(random) < rate);
+}
+
+// break, mab, then the bytes reported by chunks as the uart does, a framing error on byte error_at (0 for none)
+void LineSim::packet(const uint8_t * bytes, uint16_t size, uint16_t error_at)
+{
+    counters.packets++;
+    now_us += config.break_us;
+    sink.Break(now_us);
+    counters.events++;
+    now_us += config.mab_us;
+
+    uint16_t chunk = (config.chunk > 0) ? config.chunk : 1;
+    uint16_t sent = 0;
+    while(sent < size)
+    {
+        uint16_t n = (size - sent < chunk) ? size - sent : chunk;
+        if(error_at && (error_at >= sent) && (error_at < sent + n))
+        {
+            // the bytes before the error are reported with it, the following ones are ignored by the receiver
+            sink.Error(now_us + (int64_t) (error_at + 1) * SHIM_SLOT_US);
+            counters.events++;
+            error_at = 0;
+        }
+
+        bool last = (sent + n == size) && (n < chunk);
+        int64_t at = now_us + (int64_t) (sent + n) * SHIM_SLOT_US;
+        if(last) at += (int64_t) config.timeout_slots * SHIM_SLOT_US;
+        sink.Data(bytes + sent, n, at, last);
+        counters.events++;
+        sent += n;
+    }
+
+    now_us += (int64_t) size * SHIM_SLOT_US + config.mark_us;
+    if(config.jitter_us) now_us += std::uniform_int_distribution<uint32_t>(0, config.jitter_us)(random);
+}
+
+void LineSim::Send(uint8_t start_code, const uint8_t * slots, uint16_t nb)
+{
+    std::vector<uint8_t> bytes(nb + 1);
+    bytes[0] = start_code;
+    if(nb) memcpy(bytes.data() + 1, slots, nb);
+
+    if(start_code == 0) {
+        counters.frames++;
+        counters.good_frames++;
+    }
+    packet(bytes.data(), nb + 1, 0);
+}
+
+void LineSim::Run(uint32_t frames, uint16_t nb, std::function<void(uint32_t n, uint8_t * slots)> pattern)
+{
+    std::vector<uint8_t> bytes(nb + 1);
+    for(uint32_t n = 0; n < frames; n++)
+    {
+        if(chance(config.alt_rate))
+        {
+            uint8_t rdm[LINE_RDM_SIZE];
+            // start code, sub start code, message length (checksum excluded), then the message and its checksum
+            rdm[0] = DMX_SC_RDM;
+            rdm[1] = 0x01;
+            rdm[2] = LINE_RDM_SIZE - 2;
+            for(uint16_t i = 3; i < LINE_RDM_SIZE; i++) rdm[i] = (uint8_t) (n + i);
+            packet(rdm, LINE_RDM_SIZE, 0);
+            counters.alt_packets++;
+        }
+
+        bytes[0] = 0;
+        pattern(n, bytes.data() + 1);
+
+        uint16_t size = nb + 1;
+        if(nb > 1 && chance(config.short_rate)) {
+            size = 1 + std::uniform_int_distribution<uint16_t>(1, nb - 1)(random);
+            counters.short_frames++;
+        }
+        uint16_t error_at = 0;
+        if(chance(config.error_rate)) {
+            error_at = std::uniform_int_distribution<uint16_t>(1, size - 1)(random);
+            counters.error_frames++;
+        }
+
+        counters.frames++;
+        if(error_at == 0) counters.good_frames++;
+        packet(bytes.data(), size, error_at);
+    }
+}
+
+void LineSim::Flush()
+{
+    counters.packets++;
+    now_us += config.break_us;
+    sink.Break(now_us);
+    counters.events++;
+    now_us += config.mab_us;
+}
+
+void LinePattern(uint32_t n, uint8_t * slots, uint16_t nb)
+{
+    for(uint16_t i = 0; i < nb; i++) slots[i] = (uint8_t) (n + i + 1);
+}
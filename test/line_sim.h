@@ -0,0 +1,141 @@
+// DMX512 line simulator: generates the breaks, slots and faults of a
+// transmitter with the timing of the wire, and hands them to a sink the way a
+// uart reports them (data in chunks of the rx fifo threshold, the last one
+// after the rx timeout).
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include <random>
+
+#include "driver/uart.h"
+#include "dmx_receiver.h"
+
+struct LineConfig
+{
+    uint16_t chunk;                         // bytes per data event (rx fifo full threshold)
+    uint16_t timeout_slots;                 // idle time before the last partial chunk is reported
+    uint32_t break_us;
+    uint32_t mab_us;
+    uint32_t mark_us;                       // mark between the last slot and the next break
+    uint32_t jitter_us;                     // up to jitter_us added to the mark, at random
+    double short_rate;                      // part of the frames cut at a random slot
+    double error_rate;                      // part of the frames hit by a framing error at a random slot
+    double alt_rate;                        // part of the frames preceded by an RDM packet
+    uint32_t seed;
+
+    LineConfig() :
+        chunk(120), timeout_slots(2), break_us(176), mab_us(12), mark_us(100), jitter_us(0),
+        short_rate(0), error_rate(0), alt_rate(0), seed(1)
+    {
+    }
+};
+
+// what was put on the line
+struct LineCounters
+{
+    uint32_t packets;                       // breaks sent
+    uint32_t frames;                        // null start code frames sent
+    uint32_t good_frames;                   // frames without error
+    uint32_t short_frames;
+    uint32_t error_frames;
+    uint32_t alt_packets;
+    uint32_t events;                        // events given to the sink
+};
+
+class LineSink
+{
+    public:
+        virtual ~LineSink() {}
+
+        virtual void Break(int64_t now_us) = 0;
+        virtual void Data(const uint8_t * data, size_t size, int64_t now_us, bool timeout) = 0;
+        virtual void Error(int64_t now_us) = 0;
+};
+
+// feeds a DMXReceiver directly, as the receive task does
+class ReceiverSink : public LineSink
+{
+    public:
+        ReceiverSink(DMXReceiver & receiver) : receiver(receiver) {}
+
+        void Break(int64_t now_us);
+        void Data(const uint8_t * data, size_t size, int64_t now_us, bool timeout);
+        void Error(int64_t now_us);
+
+    private:
+        DMXReceiver & receiver;
+};
+
+// posts uart driver events to a simulated uart. In lock step the shim time is
+// the line time and each event is handled before the next one, otherwise the
+// events follow the host clock.
+class UartSink : public LineSink
+{
+    public:
+        UartSink(uart_port_t uart_num, bool lockstep = true);
+
+        void Break(int64_t now_us);
+        void Data(const uint8_t * data, size_t size, int64_t now_us, bool timeout);
+        void Error(int64_t now_us);
+
+        uint32_t GetLost() const { return lost; }          // events or bytes the driver dropped
+
+    private:
+        uart_port_t uart_num;
+        bool lockstep;
+        int64_t offset_us;
+        uint32_t lost;
+
+        void post(uart_event_type_t type, const uint8_t * data, size_t size, int64_t now_us);
+};
+
+// raises the interrupts of a simulated uart, with its fifo and status bits
+class IsrSink : public LineSink
+{
+    public:
+        IsrSink(uart_port_t uart_num, bool lockstep = true);
+
+        void Break(int64_t now_us);
+        void Data(const uint8_t * data, size_t size, int64_t now_us, bool timeout);
+        void Error(int64_t now_us);
+
+    private:
+        uart_port_t uart_num;
+        bool lockstep;
+        int64_t offset_us;
+
+        void at(int64_t now_us);
+};
+
+class LineSim
+{
+    public:
+        LineSim(LineSink & sink, const LineConfig & config = LineConfig());
+
+        // one packet: break, mab, start code and nb slots, then the mark
+        void Send(uint8_t start_code, const uint8_t * slots, uint16_t nb);
+
+        // frames of nb slots, pattern fills the slots of frame n, with the faults of the config
+        void Run(uint32_t frames, uint16_t nb, std::function<void(uint32_t n, uint8_t * slots)> pattern);
+
+        // a break alone, commits the last frame sent
+        void Flush();
+
+        int64_t Now() const { return now_us; }
+        const LineCounters & GetCounters() const { return counters; }
+
+    private:
+        LineSink & sink;
+        LineConfig config;
+        std::mt19937 random;
+        int64_t now_us;
+        LineCounters counters;
+
+        void packet(const uint8_t * bytes, uint16_t size, uint16_t error_at);
+        bool chance(double rate);
+};
+
+// frame n of the patterns used by the tests: every slot holds n + slot, never all 0
+void LinePattern(uint32_t n, uint8_t * slots, uint16_t nb);
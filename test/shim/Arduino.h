@@ -0,0 +1,91 @@
+// Host stand-in for the parts of the Arduino core used by the library
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
+#include "esp_timer.h"
+
+#define IRAM_ATTR
+
+// busy wait of the rom, on the host clock
+void ets_delay_us(uint32_t us);
+
+class Print
+{
+    public:
+        virtual ~Print() {}
+
+        virtual size_t write(uint8_t c) = 0;
+        virtual size_t write(const uint8_t * buffer, size_t size)
+        {
+            size_t n = 0;
+            while((n < size) && write(buffer[n])) n++;
+            return n;
+        }
+
+        size_t print(const char * s) { return write((const uint8_t *) s, strlen(s)); }
+        size_t print(int value) { return printf("%d", value); }
+        size_t println(const char * s) { return print(s) + print("\n"); }
+        size_t println(int value) { return printf("%d\n", value); }
+
+        size_t printf(const char * format, ...) __attribute__((format(printf, 2, 3)))
+        {
+            char buffer[256];
+            va_list args;
+            va_start(args, format);
+            int len = vsnprintf(buffer, sizeof(buffer), format, args);
+            va_end(args);
+            if(len < 0) return 0;
+            return write((const uint8_t *) buffer, ((size_t) len < sizeof(buffer)) ? len : sizeof(buffer) - 1);
+        }
+};
+
+class Stream : public Print
+{
+    public:
+        virtual int available() = 0;
+        virtual int read() = 0;
+        virtual int peek() { return -1; }
+        virtual void flush() {}
+
+        virtual size_t readBytes(uint8_t * buffer, size_t length)
+        {
+            size_t n = 0;
+            while(n < length)
+            {
+                int c = read();
+                if(c < 0) break;
+                buffer[n++] = (uint8_t) c;
+            }
+            return n;
+        }
+
+        using Print::write;
+};
+
+// Serial is the standard output of the host
+class HardwareSerial : public Stream
+{
+    public:
+        void begin(unsigned long) {}
+        int available() { return 0; }
+        int read() { return -1; }
+        size_t write(uint8_t c) { return fwrite(&c, 1, 1, stdout); }
+        size_t write(const uint8_t * buffer, size_t size) { return fwrite(buffer, 1, size, stdout); }
+};
+
+extern HardwareSerial Serial;
+
+static inline unsigned long millis() { return (unsigned long) (esp_timer_get_time() / 1000); }
+static inline unsigned long micros() { return (unsigned long) esp_timer_get_time(); }
+static inline void delay(uint32_t ms) { vTaskDelay(ms); }
@@ -0,0 +1,50 @@
+// Host stand-in for the ESP-IDF uart driver: events and received bytes come
+// from the line simulator, sent bytes go to the wire log of the port.
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "hal/uart_types.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+#define UART_PIN_NO_CHANGE      (-1)
+
+typedef enum
+{
+    UART_DATA,
+    UART_BREAK,
+    UART_BUFFER_FULL,
+    UART_FIFO_OVF,
+    UART_FRAME_ERR,
+    UART_PARITY_ERR,
+    UART_DATA_BREAK,
+    UART_PATTERN_DET,
+    UART_EVENT_MAX
+} uart_event_type_t;
+
+typedef struct
+{
+    uart_event_type_t type;
+    size_t size;
+    bool timeout_flag;
+} uart_event_t;
+
+esp_err_t uart_param_config(uart_port_t uart_num, const uart_config_t * config);
+esp_err_t uart_set_pin(uart_port_t uart_num, int tx, int rx, int rts, int cts);
+esp_err_t uart_driver_install(uart_port_t uart_num, int rx_ring, int tx_ring, int queue_size, QueueHandle_t * queue, int flags);
+esp_err_t uart_driver_delete(uart_port_t uart_num);
+
+int uart_read_bytes(uart_port_t uart_num, void * buf, uint32_t length, TickType_t timeout);
+esp_err_t uart_get_buffered_data_len(uart_port_t uart_num, size_t * size);
+esp_err_t uart_flush_input(uart_port_t uart_num);
+esp_err_t uart_set_rx_full_threshold(uart_port_t uart_num, int threshold);
+esp_err_t uart_set_rx_timeout(uart_port_t uart_num, uint8_t timeout);
+
+int uart_write_bytes(uart_port_t uart_num, const void * src, size_t size);
+int uart_write_bytes_with_break(uart_port_t uart_num, const void * src, size_t size, int brk_len);
+esp_err_t uart_wait_tx_done(uart_port_t uart_num, TickType_t timeout);
+esp_err_t uart_set_tx_idle_num(uart_port_t uart_num, uint16_t idle_num);
+esp_err_t uart_set_line_inverse(uart_port_t uart_num, uint32_t mask);
+esp_err_t uart_get_baudrate(uart_port_t uart_num, uint32_t * baudrate);
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "esp_err.h"
+
+typedef struct ShimIntr * intr_handle_t;
+typedef void (*intr_handler_t)(void * arg);
+
+#define ESP_INTR_FLAG_LEVEL1    (1 << 1)
+#define ESP_INTR_FLAG_IRAM      (1 << 10)
+
+// source is the irq of a uart (uart_periph_signal[uart].irq), its handler is run by the line simulator
+esp_err_t esp_intr_alloc(int source, int flags, intr_handler_t handler, void * arg, intr_handle_t * handle);
+esp_err_t esp_intr_free(intr_handle_t handle);
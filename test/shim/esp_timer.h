@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+
+// microseconds of the host steady clock since the start, or the simulated time set with shim_set_time()
+int64_t esp_timer_get_time();
@@ -0,0 +1,53 @@
+// Host stand-in for the FreeRTOS types and macros used by the library.
+// Tasks are threads, one tick is one millisecond of the host clock.
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef uint32_t TickType_t;
+typedef TickType_t portTickType;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t StackType_t;
+typedef uint32_t EventBits_t;
+
+#define portMAX_DELAY           ((TickType_t) 0xFFFFFFFF)
+#define portTICK_PERIOD_MS      1
+#define configTICK_RATE_HZ      1000
+#define pdMS_TO_TICKS(ms)       ((TickType_t) (ms))
+
+#define pdTRUE                  1
+#define pdFALSE                 0
+#define pdPASS                  1
+#define pdFAIL                  0
+
+#define tskNO_AFFINITY          0x7FFFFFFF
+
+typedef struct ShimTask * TaskHandle_t;
+typedef struct ShimQueue * QueueHandle_t;
+typedef struct ShimQueue * SemaphoreHandle_t;
+typedef struct ShimEventGroup * EventGroupHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+// memory given to the static creation functions, only its size matters on the host
+typedef struct { uint32_t opaque[90]; } StaticTask_t;
+typedef struct { uint32_t opaque[20]; } StaticSemaphore_t;
+typedef struct { uint32_t opaque[8]; } StaticEventGroup_t;
+typedef StaticSemaphore_t StaticQueue_t;
+
+// critical sections and interrupts share one host lock
+typedef struct { int owner; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED    { 0 }
+
+void shim_enter_critical(portMUX_TYPE * mux);
+void shim_exit_critical(portMUX_TYPE * mux);
+
+#define portENTER_CRITICAL(mux)         shim_enter_critical(mux)
+#define portEXIT_CRITICAL(mux)          shim_exit_critical(mux)
+#define portENTER_CRITICAL_ISR(mux)     shim_enter_critical(mux)
+#define portEXIT_CRITICAL_ISR(mux)      shim_exit_critical(mux)
+#define portYIELD_FROM_ISR()
+#define taskYIELD()                     shim_yield()
+
+void shim_yield();
@@ -0,0 +1,29 @@
+// Host stand-in for the uart low level layer: the registers are those of the
+// simulated uart (see shim.h), fed by the line simulator.
+#pragma once
+
+#include <stdint.h>
+#include "hal/uart_types.h"
+
+typedef struct ShimUart uart_dev_t;
+
+#define UART_INTR_RXFIFO_FULL   (1 << 0)
+#define UART_INTR_PARITY_ERR    (1 << 2)
+#define UART_INTR_FRAM_ERR      (1 << 3)
+#define UART_INTR_RXFIFO_OVF    (1 << 4)
+#define UART_INTR_BRK_DET       (1 << 7)
+#define UART_INTR_RXFIFO_TOUT   (1 << 8)
+#define UART_LL_INTR_MASK       0x7FFFF
+
+uart_dev_t * shim_uart_hw(int uart_num);
+#define UART_LL_GET_HW(num)     shim_uart_hw(num)
+
+uint32_t uart_ll_get_intsts_mask(uart_dev_t * hw);
+void uart_ll_clr_intsts_mask(uart_dev_t * hw, uint32_t mask);
+void uart_ll_ena_intr_mask(uart_dev_t * hw, uint32_t mask);
+void uart_ll_disable_intr_mask(uart_dev_t * hw, uint32_t mask);
+uint32_t uart_ll_get_rxfifo_len(uart_dev_t * hw);
+void uart_ll_read_rxfifo(uart_dev_t * hw, uint8_t * buf, uint32_t len);
+void uart_ll_rxfifo_rst(uart_dev_t * hw);
+void uart_ll_set_rxfifo_full_thr(uart_dev_t * hw, uint16_t threshold);
+void uart_ll_set_rx_tout(uart_dev_t * hw, uint16_t timeout);
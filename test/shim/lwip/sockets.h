@@ -0,0 +1,10 @@
+// lwip socket API: the host sockets have the same interface
+#pragma once
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#define closesocket(s)          close(s)
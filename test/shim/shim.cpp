@@ -0,0 +1,953 @@
+// Host implementation of the FreeRTOS / ESP-IDF / Arduino parts used by the
+// library: tasks are detached threads, semaphores and queues are condition
+// variables, critical sections and the simulated interrupts share one
+// recursive lock, and the uarts are the models driven through shim.h.
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <Arduino.h>
+#include "driver/uart.h"
+#include "driver/gpio.h"
+#include "hal/uart_ll.h"
+#include "soc/uart_periph.h"
+#include "esp_intr_alloc.h"
+#include "shim.h"
+
+HardwareSerial Serial;
+
+const uart_signal_conn_t uart_periph_signal[] = { { 0 }, { 1 }, { 2 } };
+
+//*****************************************************************************
+//** Time                                                                    **
+//*****************************************************************************
+static const std::chrono::steady_clock::time_point shim_start = std::chrono::steady_clock::now();
+static std::atomic<bool> manual_time(false);
+static std::atomic<int64_t> manual_now(0);
+
+static int64_t host_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - shim_start).count();
+}
+
+int64_t esp_timer_get_time()
+{
+    return manual_time ? manual_now.load() : host_us();
+}
+
+void shim_set_time(int64_t us)
+{
+    manual_now = us;
+    manual_time = true;
+}
+
+void shim_advance_time(int64_t us)
+{
+    manual_now += us;
+    manual_time = true;
+}
+
+void shim_real_time()
+{
+    manual_time = false;
+}
+
+TickType_t xTaskGetTickCount()
+{
+    return (TickType_t) (host_us() / 1000);
+}
+
+void ets_delay_us(uint32_t us)
+{
+    int64_t end = host_us() + us;
+    while(host_us() < end) {}
+}
+
+//*****************************************************************************
+//** Critical sections, also held while a simulated interrupt runs           **
+//*****************************************************************************
+static std::recursive_mutex critical;
+
+void shim_enter_critical(portMUX_TYPE *)
+{
+    critical.lock();
+}
+
+void shim_exit_critical(portMUX_TYPE *)
+{
+    critical.unlock();
+}
+
+void shim_yield()
+{
+    std::this_thread::yield();
+}
+
+//*****************************************************************************
+//** Tasks                                                                   **
+//*****************************************************************************
+
+// thrown in the thread of a task deleted while it waits in the shim
+struct ShimTaskExit {};
+
+struct ShimTask
+{
+    std::string name;
+    TaskFunction_t function;
+    void * arg;
+    std::atomic<bool> deleted;
+    std::atomic<bool> finished;
+
+    std::mutex lock;
+    std::condition_variable wake;
+    uint32_t notify_value;
+    bool notified;
+
+    ShimTask() : function(nullptr), arg(nullptr), deleted(false), finished(false), notify_value(0), notified(false) {}
+};
+
+static thread_local ShimTask * current_task = nullptr;
+
+static ShimTask * self()
+{
+    // threads not created as tasks (main, the test threads) get a handle on first use, never freed
+    if(current_task == nullptr) current_task = new ShimTask();
+    return current_task;
+}
+
+static void check_deleted()
+{
+    if(current_task && current_task->deleted) throw ShimTaskExit();
+}
+
+// waits on cv till ready() or timeout ticks, by slices of 1ms so a deleted task leaves
+template<typename Ready>
+static bool wait_for(std::unique_lock<std::mutex> & lock, std::condition_variable & cv, TickType_t timeout, Ready ready)
+{
+    auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+    while(!ready())
+    {
+        check_deleted();
+        if(timeout == 0) return false;
+
+        auto slice = std::chrono::steady_clock::now() + std::chrono::milliseconds(1);
+        if((timeout != portMAX_DELAY) && (slice > end)) slice = end;
+        cv.wait_until(lock, slice);
+        if((timeout != portMAX_DELAY) && (std::chrono::steady_clock::now() >= end)) return ready();
+    }
+    return true;
+}
+
+static void task_main(ShimTask * task)
+{
+    current_task = task;
+    try {
+        task->function(task->arg);
+    } catch(ShimTaskExit &) {
+    }
+    task->finished = true;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char * name, uint32_t, void * arg,
+                                   UBaseType_t, TaskHandle_t * handle, BaseType_t)
+{
+    ShimTask * task = new ShimTask();
+    task->name = name ? name : "";
+    task->function = function;
+    task->arg = arg;
+    if(handle) *handle = task;
+
+    std::thread(task_main, task).detach();
+    return pdPASS;
+}
+
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t function, const char * name, uint32_t stack_size, void * arg,
+                                           UBaseType_t priority, StackType_t *, StaticTask_t *, BaseType_t core)
+{
+    TaskHandle_t handle = NULL;
+    xTaskCreatePinnedToCore(function, name, stack_size, arg, priority, &handle, core);
+    return handle;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if((task == NULL) || (task == current_task)) throw ShimTaskExit();
+
+    // another task: it leaves at its next wait in the shim, its handle is kept (a late notification stays harmless)
+    task->deleted = true;
+    task->wake.notify_all();
+    while(!task->finished) std::this_thread::sleep_for(std::chrono::microseconds(100));
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+    return self();
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    ShimTask * task = self();
+    std::unique_lock<std::mutex> lock(task->lock);
+    wait_for(lock, task->wake, (ticks > 0) ? ticks : 1, [] { return false; });
+}
+
+void vTaskDelayUntil(TickType_t * previous, TickType_t period)
+{
+    TickType_t wake = *previous + period;
+    TickType_t now = xTaskGetTickCount();
+    if((int32_t) (wake - now) > 0) vTaskDelay(wake - now);
+    *previous = wake;
+}
+
+static BaseType_t notify(TaskHandle_t task, uint32_t value, eNotifyAction action)
+{
+    if(task == NULL) return pdFAIL;
+
+    std::lock_guard<std::mutex> lock(task->lock);
+    BaseType_t result = pdPASS;
+    switch(action)
+    {
+        case eNoAction: break;
+        case eSetBits: task->notify_value |= value; break;
+        case eIncrement: task->notify_value++; break;
+        case eSetValueWithOverwrite: task->notify_value = value; break;
+        case eSetValueWithoutOverwrite:
+            if(task->notified) result = pdFAIL;
+            else task->notify_value = value;
+            break;
+    }
+    task->notified = true;
+    task->wake.notify_all();
+    return result;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    return notify(task, 0, eIncrement);
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t * woken)
+{
+    notify(task, 0, eIncrement);
+    if(woken) *woken = pdTRUE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t timeout)
+{
+    ShimTask * task = self();
+    std::unique_lock<std::mutex> lock(task->lock);
+    if(!wait_for(lock, task->wake, timeout, [task] { return task->notify_value > 0; })) return 0;
+
+    uint32_t value = task->notify_value;
+    task->notify_value = clear ? 0 : value - 1;
+    task->notified = false;
+    return value;
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action)
+{
+    return notify(task, value, action);
+}
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action, BaseType_t * woken)
+{
+    BaseType_t result = notify(task, value, action);
+    if(woken) *woken = pdTRUE;
+    return result;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t * value, TickType_t timeout)
+{
+    ShimTask * task = self();
+    std::unique_lock<std::mutex> lock(task->lock);
+    if(!task->notified) task->notify_value &= ~clear_on_entry;
+    if(!wait_for(lock, task->wake, timeout, [task] { return task->notified; })) return pdFALSE;
+
+    if(value) *value = task->notify_value;
+    task->notify_value &= ~clear_on_exit;
+    task->notified = false;
+    return pdTRUE;
+}
+
+//*****************************************************************************
+//** Queues and semaphores                                                   **
+//*****************************************************************************
+struct ShimQueue
+{
+    std::mutex lock;
+    std::condition_variable changed;
+
+    // queue
+    size_t length;
+    size_t item_size;
+    std::deque<std::vector<uint8_t>> items;
+    int receivers;                          // tasks waiting in xQueueReceive
+
+    // semaphore
+    bool semaphore;
+    UBaseType_t count;
+    UBaseType_t max;
+
+    ShimQueue() : length(0), item_size(0), receivers(0), semaphore(false), count(0), max(0) {}
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    ShimQueue * queue = new ShimQueue();
+    queue->length = length;
+    queue->item_size = item_size;
+    return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void * item, TickType_t timeout)
+{
+    std::unique_lock<std::mutex> lock(queue->lock);
+    if(!wait_for(lock, queue->changed, timeout, [queue] { return queue->items.size() < queue->length; })) return pdFALSE;
+
+    const uint8_t * bytes = (const uint8_t *) item;
+    queue->items.push_back(std::vector<uint8_t>(bytes, bytes + queue->item_size));
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void * item, TickType_t timeout)
+{
+    std::unique_lock<std::mutex> lock(queue->lock);
+    queue->receivers++;
+    queue->changed.notify_all();
+    bool ready;
+    try {
+        ready = wait_for(lock, queue->changed, timeout, [queue] { return !queue->items.empty(); });
+    } catch(...) {
+        queue->receivers--;
+        throw;
+    }
+    queue->receivers--;
+    if(!ready) return pdFALSE;
+
+    memcpy(item, queue->items.front().data(), queue->item_size);
+    queue->items.pop_front();
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue)
+{
+    std::lock_guard<std::mutex> lock(queue->lock);
+    queue->items.clear();
+    queue->changed.notify_all();
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    std::lock_guard<std::mutex> lock(queue->lock);
+    return queue->items.size();
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    delete queue;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial)
+{
+    ShimQueue * semaphore = new ShimQueue();
+    semaphore->semaphore = true;
+    semaphore->max = max;
+    semaphore->count = initial;
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+    return xSemaphoreCreateCounting(1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *)
+{
+    return xSemaphoreCreateMutex();
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary()
+{
+    return xSemaphoreCreateCounting(1, 0);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t timeout)
+{
+    std::unique_lock<std::mutex> lock(semaphore->lock);
+    if(!wait_for(lock, semaphore->changed, timeout, [semaphore] { return semaphore->count > 0; })) return pdFALSE;
+
+    semaphore->count--;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    std::lock_guard<std::mutex> lock(semaphore->lock);
+    if(semaphore->count >= semaphore->max) return pdFALSE;
+
+    semaphore->count++;
+    semaphore->changed.notify_all();
+    return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore)
+{
+    delete semaphore;
+}
+
+//*****************************************************************************
+//** Event groups                                                            **
+//*****************************************************************************
+struct ShimEventGroup
+{
+    std::mutex lock;
+    std::condition_variable changed;
+    EventBits_t bits;
+
+    ShimEventGroup() : bits(0) {}
+};
+
+EventGroupHandle_t xEventGroupCreate()
+{
+    return new ShimEventGroup();
+}
+
+EventGroupHandle_t xEventGroupCreateStatic(StaticEventGroup_t *)
+{
+    return xEventGroupCreate();
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    std::lock_guard<std::mutex> lock(group->lock);
+    group->bits |= bits;
+    group->changed.notify_all();
+    return group->bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    std::lock_guard<std::mutex> lock(group->lock);
+    EventBits_t before = group->bits;
+    group->bits &= ~bits;
+    return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+    std::lock_guard<std::mutex> lock(group->lock);
+    return group->bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_all, TickType_t timeout)
+{
+    std::unique_lock<std::mutex> lock(group->lock);
+    auto ready = [group, bits, wait_all] {
+        return wait_all ? ((group->bits & bits) == bits) : ((group->bits & bits) != 0);
+    };
+    bool set = wait_for(lock, group->changed, timeout, ready);
+
+    EventBits_t result = group->bits;
+    if(set && clear_on_exit) group->bits &= ~bits;
+    return result;
+}
+
+void vEventGroupDelete(EventGroupHandle_t group)
+{
+    delete group;
+}
+
+//*****************************************************************************
+//** Uarts                                                                   **
+//*****************************************************************************
+struct ShimUart
+{
+    std::mutex lock;
+    std::condition_variable changed;
+
+    bool installed;
+    int rx_ring_size;
+    int tx_ring_size;
+    int rx_full_threshold;
+    int rx_timeout;
+    int tx_idle;
+
+    // driver mode
+    QueueHandle_t events;
+    std::deque<uint8_t> rx_ring;
+
+    // interrupt mode, the registers are only touched under the critical lock
+    std::vector<uint8_t> fifo;
+    uint32_t intsts;
+    uint32_t intena;
+    intr_handler_t handler;
+    void * handler_arg;
+
+    // wire
+    ShimTxHook tx_hook;
+    int64_t tx_free_us;                     // time the last byte queued leaves the uart
+    ShimWireFrame tx_frame;                 // frame being queued
+    bool tx_open;
+    std::deque<ShimWireFrame> tx_frames;
+
+    ShimUart() { clear(); }
+
+    void clear()
+    {
+        installed = false;
+        rx_ring_size = 0;
+        tx_ring_size = 0;
+        rx_full_threshold = 120;
+        rx_timeout = 10;
+        tx_idle = 10;
+        events = NULL;
+        rx_ring.clear();
+        fifo.clear();
+        intsts = 0;
+        intena = 0;
+        handler = nullptr;
+        handler_arg = nullptr;
+        tx_hook = nullptr;
+        tx_free_us = 0;
+        tx_open = false;
+        tx_frames.clear();
+    }
+};
+
+#define SHIM_MAX_WIRE_FRAMES    20000       // frames kept when the test does not take them
+
+static ShimUart uarts[UART_NUM_MAX];
+
+uart_dev_t * shim_uart_hw(int uart_num)
+{
+    return &uarts[uart_num];
+}
+
+void shim_uart_reset(uart_port_t uart_num)
+{
+    ShimUart & uart = uarts[uart_num];
+    std::lock_guard<std::recursive_mutex> isr(critical);
+    std::lock_guard<std::mutex> lock(uart.lock);
+    uart.clear();
+}
+
+bool shim_uart_installed(uart_port_t uart_num)
+{
+    std::lock_guard<std::mutex> lock(uarts[uart_num].lock);
+    return uarts[uart_num].installed;
+}
+
+int shim_uart_rx_ring(uart_port_t uart_num)
+{
+    std::lock_guard<std::mutex> lock(uarts[uart_num].lock);
+    return uarts[uart_num].rx_ring_size;
+}
+
+int shim_uart_tx_ring(uart_port_t uart_num)
+{
+    std::lock_guard<std::mutex> lock(uarts[uart_num].lock);
+    return uarts[uart_num].tx_ring_size;
+}
+
+int shim_uart_rx_full_threshold(uart_port_t uart_num)
+{
+    std::lock_guard<std::mutex> lock(uarts[uart_num].lock);
+    return uarts[uart_num].rx_full_threshold;
+}
+
+int shim_uart_rx_timeout(uart_port_t uart_num)
+{
+    std::lock_guard<std::mutex> lock(uarts[uart_num].lock);
+    return uarts[uart_num].rx_timeout;
+}
+
+int shim_uart_tx_idle(uart_port_t uart_num)
+{
+    std::lock_guard<std::mutex> lock(uarts[uart_num].lock);
+    return uarts[uart_num].tx_idle;
+}
+
+esp_err_t uart_param_config(uart_port_t, const uart_config_t *)
+{
+    return ESP_OK;
+}
+
+esp_err_t uart_set_pin(uart_port_t, int, int, int, int)
+{
+    return ESP_OK;
+}
+
+esp_err_t uart_driver_install(uart_port_t uart_num, int rx_ring, int tx_ring, int queue_size, QueueHandle_t * queue, int)
+{
+    ShimUart & uart = uarts[uart_num];
+    std::lock_guard<std::mutex> lock(uart.lock);
+    if(uart.installed || (rx_ring <= SHIM_RX_FIFO_SIZE)) return ESP_FAIL;
+
+    uart.installed = true;
+    uart.rx_ring_size = rx_ring;
+    uart.tx_ring_size = tx_ring;
+    uart.rx_ring.clear();
+    // the queue of a previous install is left to a receive task that may still hold it
+    uart.events = ((queue_size > 0) && queue) ? xQueueCreate(queue_size, sizeof(uart_event_t)) : NULL;
+    if(queue) *queue = uart.events;
+    return ESP_OK;
+}
+
+esp_err_t uart_driver_delete(uart_port_t uart_num)
+{
+    ShimUart & uart = uarts[uart_num];
+    std::lock_guard<std::mutex> lock(uart.lock);
+    if(!uart.installed) return ESP_FAIL;
+
+    uart.installed = false;
+    uart.events = NULL;
+    uart.rx_ring.clear();
+    return ESP_OK;
+}
+
+int uart_read_bytes(uart_port_t uart_num, void * buf, uint32_t length, TickType_t timeout)
+{
+    ShimUart & uart = uarts[uart_num];
+    std::unique_lock<std::mutex> lock(uart.lock);
+    if(!uart.installed) return -1;
+    wait_for(lock, uart.changed, timeout, [&uart] { return !uart.rx_ring.empty(); });
+
+    uint32_t n = 0;
+    uint8_t * bytes = (uint8_t *) buf;
+    while((n < length) && !uart.rx_ring.empty())
+    {
+        bytes[n++] = uart.rx_ring.front();
+        uart.rx_ring.pop_front();
+    }
+    return n;
+}
+
+esp_err_t uart_get_buffered_data_len(uart_port_t uart_num, size_t * size)
+{
+    std::lock_guard<std::mutex> lock(uarts[uart_num].lock);
+    *size = uarts[uart_num].rx_ring.size();
+    return ESP_OK;
+}
+
+esp_err_t uart_flush_input(uart_port_t uart_num)
+{
+    std::lock_guard<std::mutex> lock(uarts[uart_num].lock);
+    uarts[uart_num].rx_ring.clear();
+    return ESP_OK;
+}
+
+esp_err_t uart_set_rx_full_threshold(uart_port_t uart_num, int threshold)
+{
+    if(threshold < 1 || threshold >= SHIM_RX_FIFO_SIZE) return ESP_ERR_INVALID_ARG;
+
+    std::lock_guard<std::mutex> lock(uarts[uart_num].lock);
+    uarts[uart_num].rx_full_threshold = threshold;
+    return ESP_OK;
+}
+
+esp_err_t uart_set_rx_timeout(uart_port_t uart_num, uint8_t timeout)
+{
+    if(timeout > 126) return ESP_ERR_INVALID_ARG;
+
+    std::lock_guard<std::mutex> lock(uarts[uart_num].lock);
+    uarts[uart_num].rx_timeout = timeout;
+    return ESP_OK;
+}
+
+bool shim_uart_post(uart_port_t uart_num, uart_event_type_t type, const uint8_t * data, size_t size)
+{
+    ShimUart & uart = uarts[uart_num];
+    QueueHandle_t events;
+    bool kept = true;
+    {
+        std::lock_guard<std::mutex> lock(uart.lock);
+        if(!uart.installed) return false;
+
+        for(size_t i = 0; i < size; i++)
+        {
+            if(uart.rx_ring.size() >= (size_t) uart.rx_ring_size) {
+                kept = false;
+                break;
+            }
+            uart.rx_ring.push_back(data[i]);
+        }
+        uart.changed.notify_all();
+        events = uart.events;
+    }
+    if(events == NULL) return kept;
+
+    uart_event_t event;
+    memset(&event, 0, sizeof(event));
+    event.type = type;
+    event.size = size;
+    return (xQueueSend(events, &event, 0) == pdTRUE) && kept;
+}
+
+bool shim_uart_wait_rx_idle(uart_port_t uart_num, uint32_t timeout_ms)
+{
+    QueueHandle_t events;
+    {
+        std::lock_guard<std::mutex> lock(uarts[uart_num].lock);
+        events = uarts[uart_num].events;
+    }
+    if(events == NULL) return false;
+
+    std::unique_lock<std::mutex> lock(events->lock);
+    return wait_for(lock, events->changed, timeout_ms, [events] { return events->items.empty() && (events->receivers > 0); });
+}
+
+//*****************************************************************************
+//** Uart registers and interrupts                                           **
+//*****************************************************************************
+uint32_t uart_ll_get_intsts_mask(uart_dev_t * hw)
+{
+    return hw->intsts & hw->intena;
+}
+
+void uart_ll_clr_intsts_mask(uart_dev_t * hw, uint32_t mask)
+{
+    hw->intsts &= ~mask;
+}
+
+void uart_ll_ena_intr_mask(uart_dev_t * hw, uint32_t mask)
+{
+    std::lock_guard<std::recursive_mutex> isr(critical);
+    hw->intena |= mask;
+}
+
+void uart_ll_disable_intr_mask(uart_dev_t * hw, uint32_t mask)
+{
+    std::lock_guard<std::recursive_mutex> isr(critical);
+    hw->intena &= ~mask;
+}
+
+uint32_t uart_ll_get_rxfifo_len(uart_dev_t * hw)
+{
+    return hw->fifo.size();
+}
+
+void uart_ll_read_rxfifo(uart_dev_t * hw, uint8_t * buf, uint32_t len)
+{
+    if(len > hw->fifo.size()) len = hw->fifo.size();
+    memcpy(buf, hw->fifo.data(), len);
+    hw->fifo.erase(hw->fifo.begin(), hw->fifo.begin() + len);
+}
+
+void uart_ll_rxfifo_rst(uart_dev_t * hw)
+{
+    hw->fifo.clear();
+}
+
+void uart_ll_set_rxfifo_full_thr(uart_dev_t * hw, uint16_t threshold)
+{
+    std::lock_guard<std::mutex> lock(hw->lock);
+    hw->rx_full_threshold = threshold;
+}
+
+void uart_ll_set_rx_tout(uart_dev_t * hw, uint16_t timeout)
+{
+    std::lock_guard<std::mutex> lock(hw->lock);
+    hw->rx_timeout = timeout;
+}
+
+struct ShimIntr
+{
+    ShimUart * uart;
+};
+
+static ShimIntr intrs[UART_NUM_MAX];
+
+esp_err_t esp_intr_alloc(int source, int, intr_handler_t handler, void * arg, intr_handle_t * handle)
+{
+    if(source < 0 || source >= UART_NUM_MAX || handler == nullptr) return ESP_ERR_INVALID_ARG;
+
+    std::lock_guard<std::recursive_mutex> isr(critical);
+    ShimUart & uart = uarts[source];
+    if(uart.handler) return ESP_ERR_INVALID_STATE;
+
+    uart.handler = handler;
+    uart.handler_arg = arg;
+    intrs[source].uart = &uart;
+    if(handle) *handle = &intrs[source];
+    return ESP_OK;
+}
+
+esp_err_t esp_intr_free(intr_handle_t handle)
+{
+    if(handle == NULL) return ESP_ERR_INVALID_ARG;
+
+    // waits for a running handler
+    std::lock_guard<std::recursive_mutex> isr(critical);
+    handle->uart->handler = nullptr;
+    handle->uart->handler_arg = nullptr;
+    return ESP_OK;
+}
+
+void shim_uart_interrupt(uart_port_t uart_num, uint32_t status, const uint8_t * data, size_t size)
+{
+    ShimUart & uart = uarts[uart_num];
+    std::lock_guard<std::recursive_mutex> isr(critical);
+
+    for(size_t i = 0; i < size; i++)
+    {
+        if(uart.fifo.size() >= SHIM_RX_FIFO_SIZE) {
+            status |= UART_INTR_RXFIFO_OVF;
+            break;
+        }
+        uart.fifo.push_back(data[i]);
+    }
+    int threshold;
+    {
+        std::lock_guard<std::mutex> lock(uart.lock);
+        threshold = uart.rx_full_threshold;
+    }
+    if((int) uart.fifo.size() >= threshold) status |= UART_INTR_RXFIFO_FULL;
+    uart.intsts |= status;
+
+    // level triggered: the handler runs while an enabled status is raised
+    for(int guard = 0; (guard < 8) && uart.handler && (uart.intsts & uart.intena); guard++)
+    {
+        uart.handler(uart.handler_arg);
+    }
+}
+
+bool shim_uart_wait_isr(uart_port_t uart_num, uint32_t timeout_ms)
+{
+    ShimUart & uart = uarts[uart_num];
+    for(uint32_t ms = 0; ms < timeout_ms; ms++)
+    {
+        {
+            std::lock_guard<std::recursive_mutex> isr(critical);
+            if(uart.handler && uart.intena) return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+}
+
+//*****************************************************************************
+//** Wire of the output uarts                                                **
+//*****************************************************************************
+esp_err_t uart_set_tx_idle_num(uart_port_t uart_num, uint16_t idle_num)
+{
+    std::lock_guard<std::mutex> lock(uarts[uart_num].lock);
+    uarts[uart_num].tx_idle = idle_num;
+    return ESP_OK;
+}
+
+esp_err_t uart_set_line_inverse(uart_port_t, uint32_t)
+{
+    return ESP_OK;
+}
+
+esp_err_t uart_get_baudrate(uart_port_t, uint32_t * baudrate)
+{
+    *baudrate = 250000;
+    return ESP_OK;
+}
+
+static int write_wire(uart_port_t uart_num, const void * src, size_t size, int brk_len)
+{
+    ShimUart & uart = uarts[uart_num];
+    ShimTxHook hook;
+    {
+        std::lock_guard<std::mutex> lock(uart.lock);
+        if(!uart.installed) return -1;
+        hook = uart.tx_hook;
+    }
+    if(hook) hook((const uint8_t *) src, size, brk_len);
+
+    std::lock_guard<std::mutex> lock(uart.lock);
+    int64_t now = esp_timer_get_time();
+    if(uart.tx_free_us < now) uart.tx_free_us = now;
+    if(!uart.tx_open) {
+        uart.tx_frame.start_us = uart.tx_free_us;
+        uart.tx_frame.data.clear();
+        uart.tx_open = true;
+    }
+    const uint8_t * bytes = (const uint8_t *) src;
+    uart.tx_frame.data.insert(uart.tx_frame.data.end(), bytes, bytes + size);
+    uart.tx_free_us += (int64_t) size * SHIM_SLOT_US;
+
+    if(brk_len > 0) {
+        uart.tx_free_us += (int64_t) (brk_len + uart.tx_idle) * SHIM_BIT_US;
+        uart.tx_frame.break_bits = brk_len;
+        uart.tx_frame.idle_bits = uart.tx_idle;
+        uart.tx_frames.push_back(uart.tx_frame);
+        if(uart.tx_frames.size() > SHIM_MAX_WIRE_FRAMES) uart.tx_frames.pop_front();
+        uart.tx_open = false;
+        uart.changed.notify_all();
+    }
+    return (int) size;
+}
+
+int uart_write_bytes(uart_port_t uart_num, const void * src, size_t size)
+{
+    return write_wire(uart_num, src, size, 0);
+}
+
+int uart_write_bytes_with_break(uart_port_t uart_num, const void * src, size_t size, int brk_len)
+{
+    return write_wire(uart_num, src, size, brk_len);
+}
+
+esp_err_t uart_wait_tx_done(uart_port_t uart_num, TickType_t)
+{
+    // the bytes take their wire time when the host clock is used
+    int64_t free_us;
+    {
+        std::lock_guard<std::mutex> lock(uarts[uart_num].lock);
+        free_us = uarts[uart_num].tx_free_us;
+    }
+    int64_t now = esp_timer_get_time();
+    if(!manual_time && (free_us > now)) std::this_thread::sleep_for(std::chrono::microseconds(free_us - now));
+    check_deleted();
+    return ESP_OK;
+}
+
+void shim_uart_set_tx_hook(uart_port_t uart_num, ShimTxHook hook)
+{
+    std::lock_guard<std::mutex> lock(uarts[uart_num].lock);
+    uarts[uart_num].tx_hook = hook;
+}
+
+std::vector<ShimWireFrame> shim_uart_take_frames(uart_port_t uart_num)
+{
+    std::lock_guard<std::mutex> lock(uarts[uart_num].lock);
+    std::vector<ShimWireFrame> frames(uarts[uart_num].tx_frames.begin(), uarts[uart_num].tx_frames.end());
+    uarts[uart_num].tx_frames.clear();
+    return frames;
+}
+
+bool shim_uart_wait_frames(uart_port_t uart_num, size_t count, uint32_t timeout_ms)
+{
+    ShimUart & uart = uarts[uart_num];
+    std::unique_lock<std::mutex> lock(uart.lock);
+    return wait_for(lock, uart.changed, timeout_ms, [&uart, count] { return uart.tx_frames.size() >= count; });
+}
+
+//*****************************************************************************
+//** Gpio                                                                    **
+//*****************************************************************************
+void gpio_pad_select_gpio(int)
+{
+}
+
+esp_err_t gpio_set_direction(gpio_num_t, gpio_mode_t)
+{
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t, uint32_t)
+{
+    return ESP_OK;
+}
@@ -0,0 +1,64 @@
+// Control side of the host stand-ins: time, simulated uarts and their wire.
+// Only the tests and the line simulator include it, the library only sees
+// the FreeRTOS / ESP-IDF headers of this directory.
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <functional>
+
+#include "driver/uart.h"
+
+#define SHIM_SLOT_US            44          // 11 bits at 250 kbaud
+#define SHIM_BIT_US             4
+#define SHIM_RX_FIFO_SIZE       128
+
+// Time: the host steady clock by default. Once shim_set_time() is called the
+// time only moves when the test sets or advances it (ticks still use the host
+// clock, so the tasks keep running).
+void shim_set_time(int64_t us);
+void shim_advance_time(int64_t us);
+void shim_real_time();
+
+// One frame sent by an output uart: the bytes queued before a break, the time
+// the first one went on the wire, the break and the mark (tx idle) after it
+struct ShimWireFrame
+{
+    int64_t start_us;
+    std::vector<uint8_t> data;
+    int break_bits;
+    int idle_bits;
+};
+
+typedef std::function<void(const uint8_t * data, size_t size, int break_bits)> ShimTxHook;
+
+void shim_uart_reset(uart_port_t uart_num);                 // forgets the wire and the settings of the uart
+bool shim_uart_installed(uart_port_t uart_num);
+int shim_uart_rx_ring(uart_port_t uart_num);                // rings given to uart_driver_install
+int shim_uart_tx_ring(uart_port_t uart_num);
+int shim_uart_rx_full_threshold(uart_port_t uart_num);      // set by uart_set_rx_full_threshold or uart_ll
+int shim_uart_rx_timeout(uart_port_t uart_num);
+int shim_uart_tx_idle(uart_port_t uart_num);
+
+// Receive side, driver mode: size bytes go into the rx ring (what does not fit
+// is lost) and event is posted to the event queue of the driver (lost when
+// the queue is full, as the driver does). Returns false when something was lost.
+bool shim_uart_post(uart_port_t uart_num, uart_event_type_t type, const uint8_t * data = nullptr, size_t size = 0);
+
+// waits till the receive task took every posted event and is waiting again
+bool shim_uart_wait_rx_idle(uart_port_t uart_num, uint32_t timeout_ms = 1000);
+
+// Receive side, interrupt mode: data goes into the hardware fifo (the excess
+// raises UART_INTR_RXFIFO_OVF), status is raised and the handler allocated
+// with esp_intr_alloc runs right away when the interrupt is enabled
+void shim_uart_interrupt(uart_port_t uart_num, uint32_t status, const uint8_t * data = nullptr, size_t size = 0);
+
+// waits till a handler is allocated for the uart and its interrupts are enabled
+bool shim_uart_wait_isr(uart_port_t uart_num, uint32_t timeout_ms = 1000);
+
+// Send side: every write is given to hook (from the writing task), the frames
+// ended by a break are kept till taken
+void shim_uart_set_tx_hook(uart_port_t uart_num, ShimTxHook hook);
+std::vector<ShimWireFrame> shim_uart_take_frames(uart_port_t uart_num);
+bool shim_uart_wait_frames(uart_port_t uart_num, size_t count, uint32_t timeout_ms = 2000);
@@ -0,0 +1,218 @@
+// sACN / Art-Net bridge: packet parsing and sequence rules, the
+// slots out of a short packet carried over from the previous frame, an output
+// smaller than the universe, and a loopback udp stream sent to the simulated
+// uart.
+#include <chrono>
+#include <vector>
+
+#include "dmx.h"
+#include "dmx_bridge.h"
+#include "lwip/sockets.h"
+#include "shim.h"
+#include "check.h"
+
+#define OUT_UART                UART_NUM_2
+#define UNIVERSE                3
+
+static std::vector<uint8_t> artnet(uint16_t universe, uint8_t sequence, const uint8_t * slots, uint16_t count)
+{
+    std::vector<uint8_t> packet(18 + count, 0);
+    memcpy(packet.data(), "Art-Net", 8);
+    packet[8] = 0x00;                                       // OpDmx, little endian
+    packet[9] = 0x50;
+    packet[11] = 14;                                        // protocol version
+    packet[12] = sequence;
+    packet[14] = universe & 0xFF;
+    packet[15] = (universe >> 8) & 0x7F;
+    packet[16] = count >> 8;
+    packet[17] = count & 0xFF;
+    memcpy(packet.data() + 18, slots, count);
+    return packet;
+}
+
+static std::vector<uint8_t> sacn(uint16_t universe, uint8_t sequence, uint8_t options, uint8_t start_code,
+                                 const uint8_t * slots, uint16_t count)
+{
+    static const uint8_t id[12] = { 'A', 'S', 'C', '-', 'E', '1', '.', '1', '7', 0, 0, 0 };
+    std::vector<uint8_t> packet(126 + count, 0);
+    packet[1] = 0x10;                                       // preamble size
+    memcpy(packet.data() + 4, id, sizeof(id));
+    packet[21] = 0x04;                                      // VECTOR_ROOT_E131_DATA
+    packet[43] = 0x02;                                      // VECTOR_E131_DATA_PACKET
+    packet[111] = sequence;
+    packet[112] = options;
+    packet[113] = universe >> 8;
+    packet[114] = universe & 0xFF;
+    packet[117] = 0x02;                                     // VECTOR_DMP_SET_PROPERTY
+    packet[123] = (count + 1) >> 8;
+    packet[124] = (count + 1) & 0xFF;
+    packet[125] = start_code;
+    memcpy(packet.data() + 126, slots, count);
+    return packet;
+}
+
+static DMXConfig outputConfig()
+{
+    DMXConfig config;
+    config.uart_num = OUT_UART;
+    return config;
+}
+
+static void testArtNet()
+{
+    shim_uart_reset(OUT_UART);
+    DMX dmx(outputConfig());
+    dmx.Initialize(DMX_DIR_OUTPUT);
+    DMXNetBridge bridge(dmx);
+    CHECK(bridge.Begin(DMX_NET_ARTNET, UNIVERSE));
+
+    uint8_t slots[512];
+    for(uint16_t i = 0; i < 512; i++) slots[i] = (uint8_t) (i + 1);
+    std::vector<uint8_t> packet = artnet(UNIVERSE, 1, slots, 512);
+    CHECK(bridge.HandlePacket(packet.data(), packet.size(), 1000));
+    CHECK_EQ(dmx.Read(1), 1);
+    CHECK_EQ(dmx.Read(512), 0);
+
+    // late or repeated sequence
+    CHECK(!bridge.HandlePacket(packet.data(), packet.size(), 2000));
+    CHECK_EQ(bridge.GetStats().out_of_order, 1);
+
+    // a short packet replaces its slots only, the other ones come from the previous frame
+    uint8_t ten[10];
+    memset(ten, 0xAA, sizeof(ten));
+    packet = artnet(UNIVERSE, 2, ten, sizeof(ten));
+    CHECK(bridge.HandlePacket(packet.data(), packet.size(), 3000));
+    CHECK_EQ(dmx.Read(10), 0xAA);
+    CHECK_EQ(dmx.Read(11), 11);
+    CHECK_EQ(dmx.Read(511), 255);
+
+    // the writers see the same frame and keep writing on it
+    dmx.Write(300, 7);
+    dmx.Commit();
+    CHECK_EQ(dmx.Read(300), 7);
+    CHECK_EQ(dmx.Read(299), (uint8_t) 299);
+    CHECK_EQ(dmx.Read(5), 0xAA);
+
+    // sequence 0 disables the check, other universes and packets are counted
+    packet = artnet(UNIVERSE, 0, slots, 4);
+    CHECK(bridge.HandlePacket(packet.data(), packet.size(), 4000));
+    CHECK(bridge.HandlePacket(packet.data(), packet.size(), 5000));
+    packet = artnet(UNIVERSE + 1, 3, slots, 4);
+    CHECK(!bridge.HandlePacket(packet.data(), packet.size(), 6000));
+    CHECK_EQ(bridge.GetStats().other_universe, 1);
+    packet = artnet(UNIVERSE, 3, slots, 4);
+    CHECK(!bridge.HandlePacket(packet.data(), packet.size() - 1, 7000));
+    CHECK_EQ(bridge.GetStats().invalid, 1);
+    CHECK_EQ(bridge.GetStats().frames, 4);
+    CHECK_EQ(bridge.GetStats().packets, 7);
+}
+
+static void testSACN()
+{
+    shim_uart_reset(OUT_UART);
+    DMX dmx(outputConfig());
+    dmx.Initialize(DMX_DIR_OUTPUT);
+    DMXNetBridge bridge(dmx);
+
+    // universe 1 by default, packets handed over without socket
+    uint8_t slots[16];
+    memset(slots, 0x42, sizeof(slots));
+    std::vector<uint8_t> packet = sacn(1, 10, 0, 0, slots, sizeof(slots));
+    CHECK(bridge.HandlePacket(packet.data(), packet.size(), 1000));
+    CHECK_EQ(dmx.Read(16), 0x42);
+
+    // (-20, 0] is stale, a source silent for 2.5s starts a new sequence
+    packet = sacn(1, 250, 0, 0, slots, sizeof(slots));
+    CHECK(!bridge.HandlePacket(packet.data(), packet.size(), 2000));
+    CHECK(bridge.HandlePacket(packet.data(), packet.size(), 2000 + DMX_NET_SOURCE_TIMEOUT * 1000UL + 1000));
+
+    // preview data and non NULL start codes are not sent, a terminated stream restarts the sequence
+    packet = sacn(1, 251, 0x80, 0, slots, sizeof(slots));
+    CHECK(!bridge.HandlePacket(packet.data(), packet.size(), 3000000));
+    packet = sacn(1, 252, 0, 0xDD, slots, sizeof(slots));
+    CHECK(!bridge.HandlePacket(packet.data(), packet.size(), 3000000));
+    packet = sacn(1, 253, 0x40, 0, slots, sizeof(slots));
+    CHECK(!bridge.HandlePacket(packet.data(), packet.size(), 3000000));
+    CHECK_EQ(bridge.GetStats().terminated, 1);
+    packet = sacn(1, 1, 0, 0, slots, sizeof(slots));
+    CHECK(bridge.HandlePacket(packet.data(), packet.size(), 3000000));
+    CHECK_EQ(bridge.GetStats().frames, 3);
+}
+
+// an output smaller than the universe sends the first slots of each packet
+static void testSmallOutput()
+{
+    shim_uart_reset(OUT_UART);
+    static DMXUniverse<DMX_DIR_OUTPUT, 64> dmx(outputConfig());
+    dmx.Initialize();
+    DMXNetBridge bridge(dmx);
+
+    uint8_t slots[512];
+    for(uint16_t i = 0; i < 512; i++) slots[i] = (uint8_t) (i + 1);
+    std::vector<uint8_t> packet = sacn(1, 1, 0, 0, slots, sizeof(slots));
+    CHECK(bridge.HandlePacket(packet.data(), packet.size(), 1000));
+    CHECK_EQ(dmx.Read(1), 1);
+    CHECK_EQ(dmx.Read(64), 64);
+    CHECK_EQ(bridge.GetStats().frames, 1);
+}
+
+static void testLoopback()
+{
+    shim_uart_reset(OUT_UART);
+    DMX dmx(outputConfig());
+    dmx.Initialize(DMX_DIR_OUTPUT);
+    dmx.SetTxSlots(24);
+    DMXNetBridge bridge(dmx);
+    CHECK(bridge.Begin(DMX_NET_ARTNET, UNIVERSE));
+
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    struct sockaddr_in to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_port = htons(DMX_ARTNET_PORT);
+    to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    // a 44Hz stream, the last packet is on the wire a frame later
+    uint8_t slots[24];
+    for(uint8_t n = 1; n <= 20; n++)
+    {
+        memset(slots, n, sizeof(slots));
+        std::vector<uint8_t> packet = artnet(UNIVERSE, n, slots, sizeof(slots));
+        sendto(sock, packet.data(), packet.size(), 0, (struct sockaddr *) &to, sizeof(to));
+        vTaskDelay(pdMS_TO_TICKS(23));
+    }
+    close(sock);
+
+    for(int i = 0; i < 100 && bridge.GetStats().frames < 20; i++) vTaskDelay(pdMS_TO_TICKS(10));
+    CHECK_EQ(bridge.GetStats().frames, 20);
+    CHECK_EQ(bridge.GetStats().out_of_order, 0);
+
+    shim_uart_take_frames(OUT_UART);
+    CHECK(shim_uart_wait_frames(OUT_UART, 2));
+    std::vector<ShimWireFrame> frames = shim_uart_take_frames(OUT_UART);
+    CHECK_EQ(frames.back().data.size(), 25);
+    CHECK_EQ(frames.back().data[0], 0);
+    CHECK_EQ(frames.back().data[24], 20);
+
+    // arrival to wire: at most the frame in progress (24 slots) and its break
+    DMXTxLatency latency = dmx.GetTxLatency();
+    CHECK(latency.frames > 0);
+    printf("packet to wire: %u us average, %u us max over %u frames\n", latency.avg_us, latency.max_us, latency.frames);
+
+    // End stops the task between two receives, the port is free again
+    auto start = std::chrono::steady_clock::now();
+    bridge.End();
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    CHECK(ms <= 2 * DMX_NET_POLL_MS);
+    CHECK(bridge.Begin(DMX_NET_ARTNET, UNIVERSE));
+    bridge.End();
+}
+
+int main()
+{
+    testArtNet();
+    testSACN();
+    testSmallOutput();
+    testLoopback();
+    TEST_END();
+}
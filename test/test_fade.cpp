@@ -0,0 +1,125 @@
+// Fader rendered by the send task of an output: the fades only
+// reach the copy put on the wire, the written values come back on release,
+// a fader can go away while the output keeps sending, and callbacks swapped
+// from two tasks always get their own argument.
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "dmx.h"
+#include "dmx_fade.h"
+#include "shim.h"
+#include "check.h"
+
+#define OUT_UART                UART_NUM_2
+
+// slot channel of the next frames sent, after the ones already on the wire
+static std::vector<uint8_t> nextSlots(uint16_t channel, size_t count)
+{
+    std::vector<uint8_t> values;
+    shim_uart_take_frames(OUT_UART);
+    shim_uart_wait_frames(OUT_UART, count);
+    for(const ShimWireFrame & frame : shim_uart_take_frames(OUT_UART))
+    {
+        if(frame.data.size() > channel) values.push_back(frame.data[channel]);
+    }
+    return values;
+}
+
+static uint8_t wire(uint16_t channel)
+{
+    std::vector<uint8_t> values = nextSlots(channel, 2);
+    return values.empty() ? 0 : values.back();
+}
+
+// each callback checks it is given its own argument
+static int argA, argB;
+static std::atomic<uint32_t> calls(0), mismatched(0);
+
+static void callbackA(uint8_t *, uint16_t, uint32_t, void * arg)
+{
+    calls++;
+    if(arg != &argA) mismatched++;
+}
+
+static void callbackB(uint8_t *, uint16_t, uint32_t, void * arg)
+{
+    calls++;
+    if(arg != &argB) mismatched++;
+}
+
+int main()
+{
+    shim_uart_reset(OUT_UART);
+    DMXConfig config;
+    config.uart_num = OUT_UART;
+    DMX dmx(config);
+    dmx.Initialize(DMX_DIR_OUTPUT);
+    dmx.SetTxSlots(16);
+
+    dmx.Write(1, 10);
+    dmx.Write(2, 20);
+    CHECK_EQ(wire(1), 10);
+
+    {
+        DMXFader fader;
+        CHECK(fader.Begin(dmx));
+
+        // the fade is on the wire only, the written value stays
+        fader.Fade(1, 200, 0);
+        CHECK_EQ(wire(1), 200);
+        CHECK_EQ(wire(2), 20);
+        CHECK_EQ(dmx.Read(1), 10);
+
+        // released: the written value is sent again without any new write
+        fader.Release(1, 1);
+        CHECK_EQ(wire(1), 10);
+
+        // a fade over 60ms, never going backwards and ending on its target
+        fader.Fade(2, 255, 60);
+        std::vector<uint8_t> ramp = nextSlots(2, 100);
+        CHECK(ramp.size() >= 50);
+        for(size_t i = 1; i < ramp.size(); i++) CHECK(ramp[i] >= ramp[i - 1]);
+        CHECK_EQ(ramp.back(), 255);
+        CHECK(!fader.IsFading());
+
+        // 16 bits fade: coarse and fine
+        fader.Fade16(3, 0x1234, 0);
+        std::vector<uint8_t> coarse = nextSlots(3, 2);
+        CHECK_EQ(coarse.back(), 0x12);
+        CHECK_EQ(wire(4), 0x34);
+
+        // commits go on under the fade
+        dmx.BeginFrame();
+        dmx.Write(2, 30);
+        dmx.Write(5, 50);
+        dmx.Commit();
+        CHECK_EQ(wire(5), 50);
+        CHECK_EQ(wire(2), 255);
+    }
+
+    // the fader is gone, the output sends the written values
+    CHECK_EQ(wire(2), 30);
+    CHECK_EQ(wire(3), 0);
+
+    // faders created and destroyed while the send task renders them
+    for(int i = 0; i < 20; i++)
+    {
+        DMXFader fader;
+        fader.Begin(dmx);
+        fader.Fade(6, 100, 1000);
+        vTaskDelay(1);
+    }
+    CHECK_EQ(wire(6), 0);
+
+    // two tasks swapping their callbacks: the send task never pairs one with the argument of the other
+    std::thread other([&] {
+        for(int i = 0; i < 50; i++) dmx.SetTxCallback(callbackB, &argB);
+    });
+    for(int i = 0; i < 50; i++) dmx.SetTxCallback(callbackA, &argA);
+    other.join();
+    dmx.SetTxCallback(nullptr);
+    CHECK(calls > 0);
+    CHECK_EQ(mismatched, 0);
+    TEST_END();
+}
@@ -0,0 +1,86 @@
+// Triple buffer under contention: one writer publishing as fast as it can,
+// readers on the other cores checking every snapshot is a single frame and
+// matches the sequence number published with it.
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "dmx_frame.h"
+#include "check.h"
+
+#define FRAME_SIZE              513
+#define READERS                 4
+#define FRAMES                  200000
+
+// frame seq: every byte is the low byte of seq, the first four hold seq itself
+static void fill(uint8_t * frame, uint32_t seq)
+{
+    memset(frame, (uint8_t) seq, FRAME_SIZE);
+    memcpy(frame, &seq, sizeof(seq));
+}
+
+static bool whole(const uint8_t * frame, uint32_t seq)
+{
+    uint32_t stored;
+    memcpy(&stored, frame, sizeof(stored));
+    if(stored != seq) return false;
+    for(uint16_t i = sizeof(seq); i < FRAME_SIZE; i++)
+    {
+        if(frame[i] != (uint8_t) seq) return false;
+    }
+    return true;
+}
+
+int main()
+{
+    DMXFrameBuffer buffer;
+    CHECK(buffer.Begin(FRAME_SIZE));
+    CHECK_EQ(buffer.Sequence(), 0);
+
+    std::atomic<bool> done(false);
+    std::atomic<uint32_t> torn(0), backwards(0), reads(0);
+
+    std::vector<std::thread> readers;
+    for(int r = 0; r < READERS; r++)
+    {
+        readers.push_back(std::thread([&] {
+            uint8_t copy[FRAME_SIZE];
+            uint32_t last = 0;
+            uint32_t n = 0;
+            while(!done)
+            {
+                uint32_t seq = buffer.Snapshot(copy, 0, FRAME_SIZE);
+                // frame 0 is the zeroed buffer
+                if(seq != 0 && !whole(copy, seq)) torn++;
+                if(seq < last) backwards++;
+                last = seq;
+                n++;
+            }
+            reads += n;
+        }));
+    }
+
+    for(uint32_t seq = 1; seq <= FRAMES; seq++)
+    {
+        fill(buffer.Back(), seq);
+        CHECK_EQ(buffer.Publish(), seq);
+    }
+    done = true;
+    for(auto & reader : readers) reader.join();
+
+    printf("%u snapshots while %u frames were published\n", reads.load(), FRAMES);
+    CHECK_EQ(torn.load(), 0);
+    CHECK_EQ(backwards.load(), 0);
+    CHECK_EQ(buffer.Sequence(), FRAMES);
+
+    // the published word: index in the low bits, so the front buffer follows the sequence
+    uint8_t copy[FRAME_SIZE];
+    CHECK_EQ(buffer.Snapshot(copy, 0, FRAME_SIZE), FRAMES);
+    CHECK(whole(copy, FRAMES));
+    CHECK(whole(buffer.Front(), FRAMES));
+    CHECK(buffer.Back() != buffer.Front());
+
+    // the sequence wraps at 2^30 like the published word
+    CHECK_EQ(DMXFrameBuffer::SEQ_MASK, 0x3FFFFFFF);
+    TEST_END();
+}
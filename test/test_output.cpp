@@ -0,0 +1,94 @@
+// Output generated by the uart: break and MAB lengths, frame length, refresh
+// rate and the frames seen on the wire of the simulated uart.
+#include <vector>
+
+#include "dmx.h"
+#include "shim.h"
+#include "check.h"
+
+#define OUT_UART                UART_NUM_2
+
+static DMXConfig outputConfig()
+{
+    DMXConfig config;
+    config.uart_num = OUT_UART;
+    return config;
+}
+
+static void testTiming()
+{
+    shim_uart_reset(OUT_UART);
+    DMX dmx(outputConfig());
+
+    // 4us bits, rounded up, E1.11 minimums
+    DMXTxTiming timing = dmx.GetTxTiming();
+    CHECK_EQ(timing.break_us, 184);
+    CHECK_EQ(timing.mab_us, 24);
+    dmx.SetTxTiming(101, 13);
+    timing = dmx.GetTxTiming();
+    CHECK_EQ(timing.break_us, 104);
+    CHECK_EQ(timing.mab_us, 16);
+    dmx.SetTxTiming(50, 5);
+    timing = dmx.GetTxTiming();
+    CHECK_EQ(timing.break_us, 92);
+    CHECK_EQ(timing.mab_us, 12);
+    dmx.SetTxTiming(184, 24);
+
+    dmx.SetTxSlots(24);
+    dmx.Initialize(DMX_DIR_OUTPUT);
+    CHECK(shim_uart_wait_frames(OUT_UART, 4));
+
+    // a lone start code opens the line, then frame, break, MAB: no busy wait, no gpio toggling
+    std::vector<ShimWireFrame> frames = shim_uart_take_frames(OUT_UART);
+    CHECK_EQ(frames[0].data.size(), 1);
+    for(size_t i = 0; i < frames.size(); i++)
+    {
+        CHECK_EQ(frames[i].break_bits, 46);
+        CHECK_EQ(frames[i].idle_bits, 6);
+        if(i > 0) CHECK_EQ(frames[i].data.size(), 25);
+    }
+    CHECK_EQ(shim_uart_tx_idle(OUT_UART), 6);
+
+    // new timing from the next frame on
+    dmx.SetTxTiming(120, 40);
+    shim_uart_take_frames(OUT_UART);
+    CHECK(shim_uart_wait_frames(OUT_UART, 3));
+    frames = shim_uart_take_frames(OUT_UART);
+    CHECK_EQ(frames.back().break_bits, 30);
+    CHECK_EQ(frames.back().idle_bits, 10);
+}
+
+static void testFrames()
+{
+    shim_uart_reset(OUT_UART);
+    DMX dmx(outputConfig());
+    dmx.Initialize(DMX_DIR_OUTPUT);
+    dmx.SetTxSlots(32);
+
+    for(uint16_t ch = 1; ch <= 32; ch++) dmx.Write(ch, (uint8_t) (ch * 3));
+    CHECK_EQ(dmx.Read(5), 15);
+
+    shim_uart_take_frames(OUT_UART);
+    CHECK(shim_uart_wait_frames(OUT_UART, 3));
+    std::vector<ShimWireFrame> frames = shim_uart_take_frames(OUT_UART);
+    const ShimWireFrame & last = frames.back();
+    CHECK_EQ(last.data.size(), 33);
+    CHECK_EQ(last.data[0], 0);
+    for(uint16_t ch = 1; ch <= 32; ch++) CHECK_EQ(last.data[ch], (uint8_t) (ch * 3));
+
+    // frames never closer than the 1204us of E1.11, at most the refresh rate asked
+    for(size_t i = 2; i < frames.size(); i++) CHECK(frames[i].start_us - frames[i - 1].start_us >= 1204);
+    dmx.SetTxRefreshRate(100);
+    shim_uart_take_frames(OUT_UART);
+    CHECK(shim_uart_wait_frames(OUT_UART, 30));
+    frames = shim_uart_take_frames(OUT_UART);
+    for(size_t i = 2; i < frames.size(); i++) CHECK(frames[i].start_us - frames[i - 1].start_us >= 9900);
+    CHECK(dmx.GetTxFrameRate() > 80 && dmx.GetTxFrameRate() <= 101);
+}
+
+int main()
+{
+    testTiming();
+    testFrames();
+    TEST_END();
+}
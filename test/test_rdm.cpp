@@ -0,0 +1,138 @@
+// Alternate start code packets interleaved with the frames: RDM
+// packets are delivered as soon as complete, the others at the next break,
+// none of them costs a frame, and in interrupt mode each packet is copied for
+// the task so none is lost while the task keeps up.
+#include <vector>
+
+#include "dmx.h"
+#include "shim.h"
+#include "line_sim.h"
+#include "check.h"
+
+struct Captured
+{
+    uint32_t packets;
+    uint32_t rdm;
+    uint32_t malformed;
+    uint16_t last_size;
+    uint8_t last_start_code;
+};
+
+static void capture(uint8_t start_code, const uint8_t * data, uint16_t size, void * arg)
+{
+    Captured * captured = static_cast<Captured *>(arg);
+    captured->packets++;
+    if(start_code == DMX_SC_RDM) captured->rdm++;
+    captured->last_size = size;
+    captured->last_start_code = start_code;
+    if(start_code == DMX_SC_RDM && (size != 26 || data[0] != DMX_SC_RDM || data[1] != 0x01 || data[2] != 24)) captured->malformed++;
+}
+
+static void pattern512(uint32_t n, uint8_t * slots)
+{
+    LinePattern(n, slots, 512);
+}
+
+static LineConfig rdmLine()
+{
+    LineConfig config;
+    config.alt_rate = 0.3;
+    config.seed = 3;
+    return config;
+}
+
+static void testReceiver()
+{
+    Captured captured = {};
+    DMXReceiver receiver;
+    CHECK(receiver.Begin());
+    receiver.SetAltStartCodeCallback(capture, &captured);
+    ReceiverSink sink(receiver);
+
+    LineSim line(sink, rdmLine());
+    line.Run(500, 512, pattern512);
+
+    // a text packet longer than the capture is truncated, delivered at the next break
+    std::vector<uint8_t> text(599, 'x');
+    line.Send(0x17, text.data(), text.size());
+    CHECK_EQ(captured.packets, captured.rdm);
+    line.Flush();
+    CHECK_EQ(captured.last_start_code, 0x17);
+    CHECK_EQ(captured.last_size, DMX_ALT_MAX_SIZE);
+    CHECK_EQ(receiver.GetCounters().alt_overflows, 1);
+
+    CHECK(line.GetCounters().alt_packets > 100);
+    CHECK_EQ(captured.rdm, line.GetCounters().alt_packets);
+    CHECK_EQ(captured.malformed, 0);
+    CHECK_EQ(receiver.GetCounters().alt_frames, line.GetCounters().alt_packets + 1);
+    CHECK_EQ(receiver.GetCounters().frames, 500);
+    CHECK_EQ(receiver.GetCounters().resyncs, 0);
+    CHECK_EQ(receiver.GetCounters().errors, 0);
+}
+
+static void testNoCallback()
+{
+    DMXReceiver receiver;
+    CHECK(receiver.Begin());
+    ReceiverSink sink(receiver);
+
+    LineSim line(sink, rdmLine());
+    line.Run(500, 512, pattern512);
+    line.Flush();
+
+    CHECK_EQ(receiver.GetCounters().ignored_frames, line.GetCounters().alt_packets);
+    CHECK_EQ(receiver.GetCounters().frames, 500);
+}
+
+static void testInput(bool isr)
+{
+    shim_uart_reset(UART_NUM_1);
+    DMXConfig config;
+    config.uart_num = UART_NUM_1;
+    config.rx_isr = isr;
+
+    Captured captured = {};
+    LineConfig line_config = rdmLine();
+    {
+        DMX dmx(config);
+        dmx.SetAltStartCodeCallback(capture, &captured);
+        dmx.Initialize(DMX_DIR_INPUT);
+        line_config.chunk = dmx.GetConfig().rx_full_threshold;
+
+        // the interrupt runs at wire speed, the receive task gets the time it has on the target
+        uint32_t alt_packets;
+        uint32_t frames = isr ? 60 : 200;
+        if(isr) {
+            CHECK(shim_uart_wait_isr(UART_NUM_1));
+            IsrSink sink(UART_NUM_1, false);
+            LineSim line(sink, line_config);
+            line.Run(frames, 512, pattern512);
+            line.Flush();
+            alt_packets = line.GetCounters().alt_packets;
+        } else {
+            UartSink sink(UART_NUM_1);
+            LineSim line(sink, line_config);
+            line.Run(frames, 512, pattern512);
+            line.Flush();
+            alt_packets = line.GetCounters().alt_packets;
+        }
+
+        // the interrupt mode copies each packet for the task, none is lost while the task keeps up
+        for(int ms = 0; ms < 500 && captured.packets < alt_packets; ms++) vTaskDelay(1);
+        CHECK_EQ(captured.packets, alt_packets);
+        CHECK_EQ(dmx.GetRxCounters().alt_dropped, 0);
+        CHECK_EQ(captured.malformed, 0);
+        CHECK_EQ(dmx.GetFrameSequence(), frames);
+        CHECK_EQ(dmx.GetRxCounters().alt_frames, alt_packets);
+    }
+    shim_real_time();
+}
+
+int main()
+{
+    testReceiver();
+    testNoCallback();
+    testInput(false);
+    testInput(true);
+    TEST_END();
+}
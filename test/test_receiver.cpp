@@ -0,0 +1,247 @@
+// Receive state machine fed by the line simulator: directly, through the
+// receive task of a DMX input (uart driver events) and through the interrupt
+// receive mode, where a task waiting for each frame is woken even when the
+// sequence skips frames.
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "dmx.h"
+#include "shim.h"
+#include "line_sim.h"
+#include "check.h"
+
+static void pattern512(uint32_t n, uint8_t * slots)
+{
+    LinePattern(n, slots, 512);
+}
+
+// the last frame sent is published once the next break arrives
+static void checkLastFrame(const DMXFrameBuffer & frame, uint32_t n, uint16_t nb)
+{
+    std::vector<uint8_t> expected(nb);
+    LinePattern(n, expected.data(), nb);
+
+    std::vector<uint8_t> copy(nb + 1);
+    frame.Snapshot(copy.data(), 0, nb + 1);
+    CHECK_EQ(copy[0], 0);
+    CHECK(memcmp(copy.data() + 1, expected.data(), nb) == 0);
+}
+
+static void testStateMachine()
+{
+    DMXReceiver receiver;
+    CHECK(receiver.Begin());
+    ReceiverSink sink(receiver);
+
+    LineSim line(sink);
+    line.Run(100, 512, pattern512);
+    line.Flush();
+
+    CHECK_EQ(receiver.GetCounters().frames, 100);
+    CHECK_EQ(receiver.GetCounters().errors, 0);
+    CHECK_EQ(receiver.GetFrame().Sequence(), 100);
+    checkLastFrame(receiver.GetFrame(), 99, 512);
+
+    // the line timing is measured on the breaks: 512 slots, break and mab, 100us of mark
+    DMXRxStats stats;
+    CHECK(receiver.GetStats(stats));
+    uint32_t period = 176 + 12 + 513 * SHIM_SLOT_US + 100;
+    CHECK_EQ(stats.period_min_us, period);
+    CHECK_EQ(stats.period_max_us, period);
+    CHECK_EQ(stats.slots_last, 512);
+}
+
+static void testFaults()
+{
+    DMXReceiver receiver;
+    CHECK(receiver.Begin());
+    ReceiverSink sink(receiver);
+
+    LineConfig config;
+    config.error_rate = 0.2;
+    config.short_rate = 0.1;
+    config.alt_rate = 0.1;
+    config.jitter_us = 200;
+    config.seed = 7;
+    LineSim line(sink, config);
+    line.Run(1000, 512, pattern512);
+    line.Flush();
+
+    // every frame without error is published, the errors drop theirs, the RDM packets are not frames
+    const LineCounters & sent = line.GetCounters();
+    CHECK(sent.error_frames > 0 && sent.short_frames > 0 && sent.alt_packets > 0);
+    CHECK_EQ(receiver.GetCounters().frames, sent.good_frames);
+    CHECK_EQ(receiver.GetCounters().errors, sent.error_frames);
+    CHECK_EQ(receiver.GetCounters().resyncs, 0);
+}
+
+static void testWindow()
+{
+    DMXReceiver receiver;
+    CHECK(receiver.Begin(16));
+    CHECK(receiver.SetWindow(101, 16));
+    ReceiverSink sink(receiver);
+
+    LineSim line(sink);
+    line.Run(3, 512, pattern512);
+    line.Flush();
+
+    uint8_t copy[17];
+    receiver.GetFrame().Snapshot(copy, 0, 17);
+    for(uint16_t i = 1; i <= 16; i++) CHECK_EQ(copy[i], (uint8_t) (2 + 100 + i));
+}
+
+// the statistics read while the line runs: each copy is one update, the reads never wait
+static void testStats()
+{
+    DMXReceiver receiver;
+    CHECK(receiver.Begin());
+    ReceiverSink sink(receiver);
+
+    std::atomic<bool> done(false);
+    std::thread writer([&] {
+        LineConfig config;
+        config.jitter_us = 300;
+        config.seed = 11;
+        LineSim line(sink, config);
+        for(uint32_t n = 0; n < 1000; n++)
+        {
+            line.Run(1, 64, [](uint32_t, uint8_t * slots) { LinePattern(0, slots, 64); });
+            std::this_thread::yield();
+        }
+        done = true;
+    });
+
+    uint32_t reads = 0, busy = 0, torn = 0, last = 0;
+    do
+    {
+        DMXRxStats stats;
+        if(!receiver.GetStats(stats)) {
+            busy++;
+            continue;
+        }
+        uint32_t buckets = 0;
+        for(uint8_t i = 0; i < DMX_JITTER_BUCKETS; i++) buckets += stats.jitter[i];
+        if((buckets != stats.frames) || (stats.frames < last)) torn++;
+        if((stats.frames > 0) && (stats.period_min_us > stats.period_max_us)) torn++;
+        last = stats.frames;
+        reads++;
+    } while(!done);
+    writer.join();
+
+    printf("%u statistics copies, %u refused during an update\n", reads, busy);
+    CHECK_EQ(torn, 0);
+    CHECK(reads > 0);
+}
+
+// a DMX input on a simulated uart, the line time is the shim time
+static void testInput(bool isr)
+{
+    shim_uart_reset(UART_NUM_1);
+
+    DMXConfig config;
+    config.uart_num = UART_NUM_1;
+    config.rx_isr = isr;
+
+    LineConfig line_config;
+    uint32_t frames = 0;
+    {
+        DMX dmx(config);
+        dmx.Initialize(DMX_DIR_INPUT);
+        CHECK(shim_uart_installed(UART_NUM_1) != isr);
+
+        // the default threshold of the receive mode, given to the uart
+        line_config.chunk = dmx.GetConfig().rx_full_threshold;
+        CHECK_EQ(line_config.chunk, isr ? 96 : 120);
+        if(!isr) CHECK_EQ(shim_uart_rx_full_threshold(UART_NUM_1), 120);
+
+        if(isr) {
+            CHECK(shim_uart_wait_isr(UART_NUM_1));
+            IsrSink sink(UART_NUM_1);
+            LineSim line(sink, line_config);
+            line.Run(50, 512, pattern512);
+            line.Flush();
+        } else {
+            UartSink sink(UART_NUM_1);
+            LineSim line(sink, line_config);
+            line.Run(50, 512, pattern512);
+            line.Flush();
+            CHECK_EQ(sink.GetLost(), 0);
+        }
+
+        frames = dmx.GetFrameSequence();
+        for(uint16_t ch = 1; ch <= 512; ch++) CHECK_EQ(dmx.Read(ch), (uint8_t) (49 + ch));
+        CHECK(dmx.IsHealthy());
+        CHECK_EQ(dmx.GetRxCounters().errors, 0);
+        DMXRxStats stats = dmx.GetStats();
+        CHECK(stats.frames > 0);
+        CHECK_EQ(stats.slots_last, 512);
+        CHECK_EQ(dmx.GetRxCounters().max_frame_events, isr ? 7 : 6);   // break, full fifos, timeout
+
+        // writes are for outputs, an input has no send buffers and ignores them
+        uint8_t data[4] = { 1, 2, 3, 4 };
+        dmx.Write(1, 0xAA);
+        dmx.WriteAll(data, 1, sizeof(data));
+        dmx.WriteFrame(data, 1, sizeof(data), 0);
+        dmx.BeginFrame();
+        dmx.Commit();
+        CHECK_EQ(dmx.Read(1), 50);
+    }
+    CHECK_EQ(frames, 50);
+    CHECK(!shim_uart_installed(UART_NUM_1));
+    shim_real_time();
+}
+
+// a task waiting for each frame in interrupt mode, the line faster than the receive task:
+// sequences skipped between two signals still wake the waiter, up to the last frame
+static void testWait()
+{
+    shim_uart_reset(UART_NUM_1);
+
+    DMXConfig config;
+    config.uart_num = UART_NUM_1;
+    config.rx_isr = true;
+    DMX dmx(config);
+    dmx.Initialize(DMX_DIR_INPUT);
+    CHECK(shim_uart_wait_isr(UART_NUM_1));
+
+    uint32_t seq = 0;
+    CHECK(!dmx.WaitForFrame(pdMS_TO_TICKS(10), &seq));
+
+    std::atomic<uint32_t> last(0), skipped(0);
+    std::thread waiter([&] {
+        uint32_t seq;
+        while((last != 50) && dmx.WaitForFrame(pdMS_TO_TICKS(1000), &seq))
+        {
+            if(seq - last >= 2) skipped++;
+            last = seq;
+        }
+    });
+
+    LineConfig line_config;
+    line_config.chunk = dmx.GetConfig().rx_full_threshold;
+    {
+        IsrSink sink(UART_NUM_1);
+        LineSim line(sink, line_config);
+        line.Run(50, 512, pattern512);
+        line.Flush();
+    }
+    shim_real_time();
+    waiter.join();
+
+    printf("%u waits woken past skipped frames\n", (unsigned) skipped);
+    CHECK_EQ(last, 50);
+}
+
+int main()
+{
+    testStateMachine();
+    testFaults();
+    testWindow();
+    testStats();
+    testInput(false);
+    testInput(true);
+    testWait();
+    TEST_END();
+}
@@ -0,0 +1,188 @@
+// Recorder and player: records of an input listening to a window
+// hold dmx addresses, also once the window moved, a recording plays back on an
+// output at its addresses (the ones beyond a smaller output left out), and
+// End() stops a player sleeping till its next record.
+#include <chrono>
+#include <vector>
+
+#include "dmx.h"
+#include "dmx_recorder.h"
+#include "shim.h"
+#include "line_sim.h"
+#include "check.h"
+
+#define IN_UART                 UART_NUM_1
+#define OUT_UART                UART_NUM_2
+#define WINDOW_START            101
+#define WINDOW_NB               32
+#define MOVING                  110         // the only channel changing from frame to frame
+#define FRAMES                  20
+#define MOVED_START             201         // window after the move
+#define MOVED_MOVING            210         // changing channel of the moved window
+#define MOVED_FRAMES            3
+
+struct Run
+{
+    uint16_t address;
+    uint16_t len;
+    uint8_t first;
+};
+
+// runs of each record
+static std::vector<std::vector<Run>> parse(const std::vector<uint8_t> & data)
+{
+    std::vector<std::vector<Run>> records;
+    size_t pos = 0;
+    while(pos + DMX_REC_HEADER_SIZE <= data.size())
+    {
+        uint16_t runs;
+        memcpy(&runs, data.data() + pos + 4, 2);
+        pos += DMX_REC_HEADER_SIZE;
+
+        std::vector<Run> record;
+        for(uint16_t r = 0; r < runs; r++)
+        {
+            Run run;
+            memcpy(&run.address, data.data() + pos, 2);
+            memcpy(&run.len, data.data() + pos + 2, 2);
+            run.first = data[pos + DMX_REC_RUN_SIZE];
+            pos += DMX_REC_RUN_SIZE + run.len;
+            record.push_back(run);
+        }
+        records.push_back(record);
+    }
+    return records;
+}
+
+static std::vector<uint8_t> record()
+{
+    shim_uart_reset(IN_UART);
+    DMXConfig config;
+    config.uart_num = IN_UART;
+    DMX input(config);
+    input.Initialize(DMX_DIR_INPUT, WINDOW_START, WINDOW_NB);
+
+    static uint8_t storage[8192];
+    DMXRecorder recorder;
+    CHECK(recorder.Begin(input, storage, sizeof(storage)));
+
+    // in lock step each frame is recorded before the next one comes in
+    {
+        UartSink sink(IN_UART);
+        LineSim line(sink);
+        line.Run(FRAMES, 512, [](uint32_t n, uint8_t * slots) {
+            memset(slots, 7, 512);
+            slots[MOVING - 1] = (uint8_t) (n + 1);
+        });
+
+        // the frames received with the moved window are recorded at its addresses, from the break
+        // committing the last frame of the old window
+        input.SetDmxStartAdress(MOVED_START);
+        line.Run(MOVED_FRAMES, 512, [](uint32_t n, uint8_t * slots) {
+            memset(slots, 7, 512);
+            slots[MOVED_MOVING - 1] = (uint8_t) (100 + n);
+        });
+        line.Flush();
+    }
+    shim_real_time();
+    for(int i = 0; i < 100 && recorder.GetStats().frames < FRAMES + MOVED_FRAMES; i++) vTaskDelay(pdMS_TO_TICKS(10));
+    CHECK_EQ(recorder.GetStats().frames, FRAMES + MOVED_FRAMES);
+    recorder.Stop();
+
+    std::vector<uint8_t> data(recorder.Available());
+    CHECK_EQ(recorder.Read(data.data(), data.size()), data.size());
+    return data;
+}
+
+static void testAddresses(const std::vector<uint8_t> & data)
+{
+    std::vector<std::vector<Run>> records = parse(data);
+    CHECK_EQ(records.size(), FRAMES + MOVED_FRAMES);
+    if(records.size() != FRAMES + MOVED_FRAMES) return;
+
+    // the first record holds the whole window, the next ones the moving channel
+    CHECK_EQ(records[0].size(), 1);
+    CHECK_EQ(records[0][0].address, WINDOW_START);
+    CHECK_EQ(records[0][0].len, WINDOW_NB);
+    CHECK_EQ(records[0][0].first, 7);
+    for(size_t r = 1; r < FRAMES; r++)
+    {
+        CHECK_EQ(records[r].size(), 1);
+        CHECK_EQ(records[r][0].address, MOVING);
+        CHECK_EQ(records[r][0].len, 1);
+        CHECK_EQ(records[r][0].first, r + 1);
+    }
+
+    // every channel changed with the window
+    CHECK_EQ(records[FRAMES].size(), 1);
+    CHECK_EQ(records[FRAMES][0].address, MOVED_START);
+    CHECK_EQ(records[FRAMES][0].len, WINDOW_NB);
+    for(size_t r = FRAMES + 1; r < records.size(); r++)
+    {
+        CHECK_EQ(records[r].size(), 1);
+        CHECK_EQ(records[r][0].address, MOVED_MOVING);
+        CHECK_EQ(records[r][0].first, 100 + r - FRAMES);
+    }
+}
+
+static void testPlayback(const std::vector<uint8_t> & data)
+{
+    shim_uart_reset(OUT_UART);
+    DMXConfig config;
+    config.uart_num = OUT_UART;
+    DMX output(config);
+    output.Initialize(DMX_DIR_OUTPUT);
+
+    // original timing: a frame every 23ms or so
+    DMXPlayer player(output);
+    CHECK(player.Begin(data.data(), data.size()));
+    for(int i = 0; i < 200 && player.IsPlaying(); i++) vTaskDelay(pdMS_TO_TICKS(10));
+    CHECK(!player.IsPlaying());
+    CHECK_EQ(output.Read(MOVING), FRAMES);
+    CHECK_EQ(output.Read(WINDOW_START), 7);
+    CHECK_EQ(output.Read(WINDOW_START + WINDOW_NB - 1), 7);
+    CHECK_EQ(output.Read(WINDOW_START - 1), 0);
+    CHECK_EQ(output.Read(WINDOW_START + WINDOW_NB), 0);
+    CHECK_EQ(output.Read(MOVED_START), 7);
+    CHECK_EQ(output.Read(MOVED_MOVING), 100 + MOVED_FRAMES - 1);
+
+    // an output smaller than the recorded addresses plays the ones it has
+    shim_uart_reset(UART_NUM_0);
+    config.uart_num = UART_NUM_0;
+    static DMXUniverse<DMX_DIR_OUTPUT, WINDOW_START + 4> small(config);
+    small.Initialize();
+    DMXPlayer cut(small);
+    CHECK(cut.Begin(data.data(), data.size()));
+    for(int i = 0; i < 200 && cut.IsPlaying(); i++) vTaskDelay(pdMS_TO_TICKS(10));
+    CHECK_EQ(small.Read(WINDOW_START), 7);
+    CHECK_EQ(small.Read(WINDOW_START + 4), 7);
+
+    // a record 10s after the first one: End wakes the player up
+    std::vector<uint8_t> late(data);
+    uint32_t dt = 10000000;
+    size_t second = DMX_REC_HEADER_SIZE + DMX_REC_RUN_SIZE + WINDOW_NB;
+    memcpy(late.data() + second, &dt, 4);
+    output.Write(MOVING, 0);
+    CHECK(player.Begin(late.data(), late.size(), true));
+    vTaskDelay(pdMS_TO_TICKS(50));
+    CHECK(player.IsPlaying());
+
+    auto start = std::chrono::steady_clock::now();
+    player.End();
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    CHECK(ms <= 2 * DMX_PLAY_POLL_MS);
+    CHECK(!player.IsPlaying());
+    CHECK_EQ(output.Read(MOVING), 1);
+
+    // the output is free for its writers
+    output.Write(MOVING, 200);
+    CHECK_EQ(output.Read(MOVING), 200);
+}
+
+int main()
+{
+    std::vector<uint8_t> data = record();
+    testAddresses(data);
+    testPlayback(data);
+    TEST_END();
+}
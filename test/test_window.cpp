@@ -0,0 +1,205 @@
+// Subscriber windows fed by the line simulator through the receive state
+// machine: filled in the same pass as the main frame and published before its
+// callback, short frames carrying the missing slots over, blackouts clearing
+// them, a window added while a frame is received starting with the next one,
+// and the main window moved with a short frame carrying over only the
+// channels it held.
+#include <vector>
+
+#include "dmx.h"
+#include "shim.h"
+#include "line_sim.h"
+#include "check.h"
+
+static void pattern512(uint32_t n, uint8_t * slots)
+{
+    LinePattern(n, slots, 512);
+}
+
+// channels start to start + nb - 1 of the window hold the ones of frame n
+static void checkWindow(const DMXWindow & window, uint32_t n)
+{
+    uint8_t expected[512];
+    LinePattern(n, expected, 512);
+
+    std::vector<uint8_t> copy(window.GetNbChannels());
+    window.ReadAll(copy.data(), window.GetStart(), copy.size());
+    CHECK(memcmp(copy.data(), expected + window.GetStart() - 1, copy.size()) == 0);
+}
+
+// each window is up to date when the callback of the main frame runs
+struct Published
+{
+    DMXWindow * windows[3];
+    uint32_t frames;
+    uint32_t behind;
+};
+
+static void checkPublished(const uint8_t * frame, uint16_t start, uint16_t, const uint32_t *, uint32_t seq, uint32_t, void * arg)
+{
+    Published * published = static_cast<Published *>(arg);
+    published->frames++;
+    for(DMXWindow * window : published->windows)
+    {
+        uint16_t ch = window->GetStart();
+        if((window->GetFrameSequence() != seq) || (window->Read(ch) != frame[ch - start + 1])) published->behind++;
+    }
+}
+
+static void testFill()
+{
+    DMXReceiver receiver;
+    CHECK(receiver.Begin());
+
+    // at the start, across the chunks of the fifo threshold, at the end
+    static DMXWindow first, across, last;
+    CHECK(first.Begin(1, 16));
+    CHECK(across.Begin(110, 30));
+    CHECK(last.Begin(497, 16));
+    CHECK(receiver.AddWindow(first));
+    CHECK(receiver.AddWindow(across));
+    CHECK(receiver.AddWindow(last));
+
+    Published published = { { &first, &across, &last }, 0, 0 };
+    receiver.SetFrameCallback(checkPublished, &published);
+
+    ReceiverSink sink(receiver);
+    LineSim line(sink);
+    line.Run(20, 512, pattern512);
+    line.Flush();
+
+    CHECK_EQ(published.frames, 20);
+    CHECK_EQ(published.behind, 0);
+    for(DMXWindow * window : published.windows)
+    {
+        CHECK_EQ(window->GetFrameSequence(), 20);
+        checkWindow(*window, 19);
+    }
+    CHECK_EQ(first.Read(17), 0);                            // outside the window
+    receiver.SetFrameCallback(nullptr);
+}
+
+// a frame cut after channel 200: the channels after it keep their value of the last frame
+static void testShort()
+{
+    DMXReceiver receiver;
+    CHECK(receiver.Begin());
+
+    static DMXWindow before, straddling, after;
+    CHECK(before.Begin(101, 16));
+    CHECK(straddling.Begin(191, 20));
+    CHECK(after.Begin(301, 16));
+    CHECK(receiver.AddWindow(before));
+    CHECK(receiver.AddWindow(straddling));
+    CHECK(receiver.AddWindow(after));
+
+    ReceiverSink sink(receiver);
+    LineSim line(sink);
+    line.Run(1, 512, [](uint32_t, uint8_t * slots) { LinePattern(0, slots, 512); });
+    line.Run(1, 200, [](uint32_t, uint8_t * slots) { LinePattern(1, slots, 200); });
+    line.Flush();
+
+    uint8_t whole[512], cut[512];
+    LinePattern(0, whole, 512);
+    LinePattern(1, cut, 512);
+    CHECK_EQ(receiver.GetCounters().frames, 2);
+    checkWindow(before, 1);
+    checkWindow(after, 0);
+    CHECK_EQ(after.GetFrameSequence(), 2);
+    for(uint16_t ch = 191; ch <= 200; ch++) CHECK_EQ(straddling.Read(ch), cut[ch - 1]);
+    for(uint16_t ch = 201; ch <= 210; ch++) CHECK_EQ(straddling.Read(ch), whole[ch - 1]);
+}
+
+// NBZEROFRAME_TRIGGER_BLACKOUT frames of zeros clear every window
+static void testBlackout()
+{
+    DMXReceiver receiver;
+    CHECK(receiver.Begin());
+
+    static DMXWindow window;
+    CHECK(window.Begin(201, 32));
+    CHECK(receiver.AddWindow(window));
+
+    ReceiverSink sink(receiver);
+    LineSim line(sink);
+    line.Run(1, 512, pattern512);
+    line.Run(NBZEROFRAME_TRIGGER_BLACKOUT, 512, [](uint32_t, uint8_t * slots) { memset(slots, 0, 512); });
+    line.Flush();
+
+    CHECK_EQ(receiver.GetCounters().blackouts, 1);
+    CHECK_EQ(window.GetFrameSequence(), 2);
+    for(uint16_t ch = 201; ch < 233; ch++) CHECK_EQ(window.Read(ch), 0);
+    CHECK_EQ(receiver.GetFrame().Get(201), 0);
+}
+
+// adds the window after the first chunks of frame 1 were received
+class AddingSink : public ReceiverSink
+{
+    public:
+        AddingSink(DMXReceiver & receiver, DMXWindow & window) : ReceiverSink(receiver), receiver(receiver), window(window), chunks(0) {}
+
+        void Data(const uint8_t * data, size_t size, int64_t now_us, bool timeout)
+        {
+            ReceiverSink::Data(data, size, now_us, timeout);
+            if(++chunks == 7) CHECK(receiver.AddWindow(window));     // 5 chunks per frame
+        }
+
+    private:
+        DMXReceiver & receiver;
+        DMXWindow & window;
+        uint32_t chunks;
+};
+
+static void testAdded()
+{
+    DMXReceiver receiver;
+    CHECK(receiver.Begin());
+
+    static DMXWindow window;
+    CHECK(window.Begin(1, 512));
+
+    AddingSink sink(receiver, window);
+    LineSim line(sink);
+    line.Run(3, 512, pattern512);
+    line.Flush();
+
+    // frame 1 was half received when the window came: it starts with frame 2, whole
+    CHECK_EQ(receiver.GetCounters().frames, 3);
+    CHECK_EQ(window.GetFrameSequence(), 1);
+    checkWindow(window, 2);
+}
+
+// the main window moved from 101 to 109 before a frame cut after channel 112
+static void testMoved()
+{
+    DMXReceiver receiver;
+    CHECK(receiver.Begin(16));
+    CHECK(receiver.SetWindow(101, 16));
+
+    ReceiverSink sink(receiver);
+    LineSim line(sink);
+    line.Run(1, 512, [](uint32_t, uint8_t * slots) { LinePattern(0, slots, 512); });
+    CHECK(receiver.SetWindow(109, 16));
+    line.Run(1, 112, [](uint32_t, uint8_t * slots) { LinePattern(1, slots, 112); });
+    line.Flush();
+
+    // received up to 112, carried over from the old window up to 116, not held before after it
+    uint8_t whole[512], cut[512];
+    LinePattern(0, whole, 512);
+    LinePattern(1, cut, 512);
+    uint8_t copy[17];
+    receiver.GetFrame().Snapshot(copy, 0, 17);
+    for(uint16_t ch = 109; ch <= 112; ch++) CHECK_EQ(copy[ch - 108], cut[ch - 1]);
+    for(uint16_t ch = 113; ch <= 116; ch++) CHECK_EQ(copy[ch - 108], whole[ch - 1]);
+    for(uint16_t ch = 117; ch <= 124; ch++) CHECK_EQ(copy[ch - 108], 0);
+}
+
+int main()
+{
+    testFill();
+    testShort();
+    testBlackout();
+    testAdded();
+    testMoved();
+    TEST_END();
+}